@@ -0,0 +1,150 @@
+// Рассылка одного сообщения многим соединениям: sendText на каждого
+// получателя (кодирование и копия payload на каждого) против
+// Server::broadcast-пути — фрейм кодируется один раз, очереди держат
+// ссылки. Соединения настоящие, поверх пар сокетов на loopback;
+// считаются время постановки в очереди, время до ухода всего в ядро
+// и выделения памяти за рассылку.
+//
+// Запуск: broadcast_bench [получателей] [сообщений] [байт в сообщении]
+
+#include "../websocket_connection.h"
+#include "../socket_utils.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+std::atomic<size_t> allocated_bytes{0};
+
+} // namespace
+
+// Подсчёт выделений за рассылку. new и delete заменены парой на
+// malloc/free, GCC этого не видит и предупреждает зря
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using websocket::WebSocketConnection;
+
+// Пара соединённых сокетов через loopback: [сервер, клиент]
+bool socketPair(SOCKET listener, const sockaddr_in& address, SOCKET pair[2]) {
+    pair[1] = socket(AF_INET, SOCK_STREAM, 0);
+    if (pair[1] == INVALID_SOCKET ||
+        connect(pair[1], reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        return false;
+    }
+    pair[0] = accept(listener, nullptr, nullptr);
+    return pair[0] != INVALID_SOCKET;
+}
+
+struct Result {
+    double enqueue_ms = 0;
+    double drained_ms = 0;
+    size_t allocations = 0;
+    size_t bytes = 0;
+};
+
+Result run(bool shared, size_t recipients, size_t messages, const std::string& payload) {
+    IOCPCore core;
+    if (!core.setup()) {
+        std::cerr << "core setup failed\n";
+        std::exit(1);
+    }
+    core.runWorkerThreads(1);
+
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0 ||
+        getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        std::cerr << "listener failed: " << SocketUtils::getLastErrorString() << "\n";
+        std::exit(1);
+    }
+
+    std::vector<std::shared_ptr<WebSocketConnection>> connections;
+    std::vector<SOCKET> peers;
+    for (size_t i = 0; i < recipients; ++i) {
+        SOCKET pair[2];
+        if (!socketPair(listener, address, pair)) {
+            std::cerr << "socket pair " << i << " failed: " << SocketUtils::getLastErrorString() << "\n";
+            std::exit(1);
+        }
+        auto connection = std::make_shared<WebSocketConnection>(pair[0], core);
+        connection->start();
+        connections.push_back(std::move(connection));
+        peers.push_back(pair[1]);
+    }
+
+    Result result;
+    const size_t allocations_before = allocations.load();
+    const size_t bytes_before = allocated_bytes.load();
+    auto start = Clock::now();
+    for (size_t m = 0; m < messages; ++m) {
+        if (shared) {
+            const websocket::SharedFrame frame = websocket::Frame::createSharedFrame(websocket::Opcode::Text, payload);
+            for (auto& connection : connections) connection->sendShared(frame);
+        } else {
+            for (auto& connection : connections) connection->sendText(payload);
+        }
+    }
+    result.enqueue_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    result.allocations = allocations.load() - allocations_before;
+    result.bytes = allocated_bytes.load() - bytes_before;
+
+    // Клиенты не читают: всё помещается в буферы ядра
+    for (auto& connection : connections) {
+        while (connection->bufferedAmount() > 0) std::this_thread::yield();
+    }
+    result.drained_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    for (auto& connection : connections) connection->close(1006);
+    connections.clear();
+    core.stop();
+    for (SOCKET peer : peers) SocketUtils::closeSocket(peer);
+    SocketUtils::closeSocket(listener);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t recipients = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000;
+    const size_t messages = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+    const size_t size = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1024;
+    const std::string payload(size, 'x');
+
+    SocketUtils::initialize();
+    std::cout << recipients << " recipients, " << messages << " messages of " << size << " bytes\n";
+    for (bool shared : {false, true}) {
+        const Result r = run(shared, recipients, messages, payload);
+        std::cout << (shared ? "shared frame:    " : "sendText each:   ") << r.enqueue_ms << " ms enqueue, "
+                  << r.drained_ms << " ms drained, " << r.allocations << " allocations, "
+                  << r.bytes / 1024 << " KB allocated\n";
+    }
+    SocketUtils::cleanup();
+    return 0;
+}
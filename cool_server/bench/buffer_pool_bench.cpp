@@ -0,0 +1,99 @@
+// Буферы чтения и записи: std::vector на каждую операцию (как было:
+// resize буфера чтения, vector на каждый исходящий фрейм), голый
+// new[] без обнуления и BufferPool. Каждый поток держит кольцо из 64
+// буферов «в полёте» и гоняет смесь: чтение 8 КБ, фрейм 32–512 байт,
+// изредка фрейм 64 КБ. В конце — статистика пула.
+//
+// Запуск: buffer_pool_bench [операций на поток] [потоков]
+
+#include "../buffer_pool.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr size_t IN_FLIGHT = 64;
+
+std::vector<size_t> makeSizes(size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<size_t> frame(32, 512);
+    std::uniform_int_distribution<int> kind(0, 99);
+    std::vector<size_t> sizes(count);
+    for (size_t& size : sizes) {
+        const int k = kind(gen);
+        size = k < 45 ? 8 * 1024 : k < 98 ? frame(gen) : 64 * 1024;
+    }
+    return sizes;
+}
+
+// Пишем первый и последний байт: буфер должен быть настоящим
+template <typename Buffer, typename Make>
+uint64_t run(const std::vector<size_t>& sizes, Make make) {
+    std::vector<Buffer> ring(IN_FLIGHT);
+    uint64_t sink = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        Buffer& slot = ring[i % IN_FLIGHT];
+        slot = make(sizes[i]);
+        uint8_t* data = &slot[0];
+        data[0] = static_cast<uint8_t>(i);
+        data[sizes[i] - 1] = static_cast<uint8_t>(i);
+        sink += data[0];
+    }
+    return sink;
+}
+
+struct PooledSlot {
+    websocket::PooledBuffer buffer;
+    uint8_t& operator[](size_t i) { return buffer.data()[i]; }
+};
+
+template <typename Body>
+double measure(size_t threads, size_t ops, Body body) {
+    std::vector<std::vector<size_t>> sizes;
+    for (size_t t = 0; t < threads; ++t) sizes.push_back(makeSizes(ops, static_cast<unsigned>(t + 1)));
+
+    std::vector<std::thread> workers;
+    const auto start = Clock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] { body(sizes[t]); });
+    }
+    for (auto& worker : workers) worker.join();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (ops * threads);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t ops = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    const size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+    std::atomic<uint64_t> sink{0};
+
+    const double vector_ns = measure(threads, ops, [&](const std::vector<size_t>& sizes) {
+        sink += run<std::vector<uint8_t>>(sizes, [](size_t size) { return std::vector<uint8_t>(size); });
+    });
+    const double raw_ns = measure(threads, ops, [&](const std::vector<size_t>& sizes) {
+        sink += run<std::unique_ptr<uint8_t[]>>(sizes, [](size_t size) {
+            return std::unique_ptr<uint8_t[]>(new uint8_t[size]);
+        });
+    });
+    const double pool_ns = measure(threads, ops, [&](const std::vector<size_t>& sizes) {
+        sink += run<PooledSlot>(sizes, [](size_t size) { return PooledSlot{websocket::PooledBuffer(size)}; });
+    });
+
+    const auto stats = websocket::BufferPool::instance().stats();
+    std::cout << threads << " thread(s), " << ops << " buffers each, " << IN_FLIGHT << " in flight\n"
+              << "std::vector (zeroed): " << vector_ns << " ns/buffer\n"
+              << "new[]:                " << raw_ns << " ns/buffer\n"
+              << "BufferPool:           " << pool_ns << " ns/buffer\n"
+              << "pool: " << stats.hitRate() * 100 << "% hits (" << stats.thread_hits << " thread cache, "
+              << stats.shared_hits << " shared), " << stats.allocations << " allocations, "
+              << stats.resident_bytes / 1024 << " KB resident, " << stats.in_use_bytes << " B in use\n"
+              << (sink == 0 ? "\n" : "");
+    return 0;
+}
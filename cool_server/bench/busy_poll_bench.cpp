@@ -0,0 +1,232 @@
+// Задержка и цена в процессорном времени опроса без сна (BusyPollConfig).
+// Ядро с одним рабочим потоком держит настоящее WebSocketConnection,
+// которое эхом возвращает сообщения; клиент на loopback гоняет ping-pong
+// 64-байтных сообщений, между ними «думает» think_us микросекунд — за это
+// время поток ядра без опроса успевает уснуть. Для каждой настройки:
+// round trip p50/p99, процессорное время потока ядра на сообщение и доля
+// стенного времени, которую он занимал, и статистика опроса.
+//
+// На машине с одним ядром опрос отнимает процессор у клиента — выигрыша
+// там не будет, только цена.
+//
+// Запуск: busy_poll_bench [сообщений] [think_us]
+
+#include "../websocket_connection.h"
+#include "../socket_utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <ctime>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using websocket::WebSocketConnection;
+
+constexpr size_t PAYLOAD = 64;
+
+struct Setting {
+    const char* name;
+    BusyPollConfig config;
+};
+
+struct Result {
+    double p50_us = 0;
+    double p99_us = 0;
+    double cpu_us_per_message = 0;
+    double cpu_share = 0;
+    double hit_rate = 0;
+    double parks_per_message = 0;
+};
+
+// Процессорное время текущего потока
+double threadCpuSeconds() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+    auto seconds = [](const FILETIME& t) {
+        return ((static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) * 1e-7;
+    };
+    return seconds(kernel) + seconds(user);
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Процессорное время рабочего потока ядра: замер делает он сам
+double loopCpuSeconds(IOCPCore& core) {
+    struct Probe : CompletionHandler {
+        void onCompletion(DWORD, LPOVERLAPPED, DWORD) override {
+            seconds = threadCpuSeconds();
+            done = true;
+        }
+        OVERLAPPED overlapped{};
+        double seconds = 0;
+        std::atomic<bool> done{false};
+    } probe;
+    core.postCompletion(0, &probe, &probe.overlapped);
+    while (!probe.done) std::this_thread::yield();
+    return probe.seconds;
+}
+
+bool sendAll(SOCKET s, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        int n = send(s, reinterpret_cast<const char*>(data), static_cast<int>(len), 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recvAll(SOCKET s, uint8_t* data, size_t len) {
+    while (len > 0) {
+        int n = recv(s, reinterpret_cast<char*>(data), static_cast<int>(len), 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Рукопожатие со стороны клиента; ключ — пример из RFC 6455
+bool upgrade(SOCKET s) {
+    const std::string request = "GET / HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\n"
+                                "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                "Sec-WebSocket-Version: 13\r\n\r\n";
+    if (!sendAll(s, reinterpret_cast<const uint8_t*>(request.data()), request.size())) return false;
+    std::string response;
+    char chunk[512];
+    while (response.find("\r\n\r\n") == std::string::npos) {
+        int n = recv(s, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        response.append(chunk, static_cast<size_t>(n));
+    }
+    return response.compare(0, 12, "HTTP/1.1 101") == 0;
+}
+
+void think(std::chrono::microseconds duration) {
+    const auto until = Clock::now() + duration;
+    while (Clock::now() < until) {
+    }
+}
+
+Result run(const BusyPollConfig& config, size_t messages, std::chrono::microseconds think_time) {
+    IOCPCore core;
+    if (!core.setup()) std::exit(1);
+    core.setBusyPoll(config);
+    core.runWorkerThreads(1);
+
+    SOCKET listener = SocketUtils::createSocket();
+    if (!SocketUtils::bindSocket(listener, 0) || !SocketUtils::startListening(listener)) std::exit(1);
+    sockaddr_in address{};
+    socklen_t length = sizeof(address);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    SOCKET client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) std::exit(1);
+    SocketUtils::setNoDelay(client, true);
+    SOCKET accepted = accept(listener, nullptr, nullptr);
+    SocketUtils::setNoDelay(accepted, true);
+
+    auto connection = std::make_shared<WebSocketConnection>(accepted, core);
+    std::weak_ptr<WebSocketConnection> weak = connection;
+    connection->setMessageCallback([weak](const websocket::MessageView& message) {
+        if (auto self = weak.lock()) self->send(message);
+    });
+    connection->start();
+    if (!upgrade(client)) std::exit(1);
+
+    // Замаскированный текстовый фрейм; маска нулевая — payload как есть
+    std::vector<uint8_t> frame = {0x81, 0x80 | PAYLOAD, 0, 0, 0, 0};
+    frame.resize(frame.size() + PAYLOAD, 'x');
+    uint8_t reply[2 + PAYLOAD];
+
+    // Прогрев: буферы, кэши, бюджет опроса
+    for (int i = 0; i < 1000; ++i) {
+        if (!sendAll(client, frame.data(), frame.size()) || !recvAll(client, reply, sizeof(reply))) std::exit(1);
+    }
+
+    const auto& stats = core.busyPollStats();
+    const uint64_t spins_before = stats.spins.load(), hits_before = stats.hits.load();
+    const uint64_t parks_before = stats.parks.load();
+    const double cpu_before = loopCpuSeconds(core);
+    const auto started = Clock::now();
+
+    std::vector<double> rtt_us;
+    rtt_us.reserve(messages);
+    for (size_t i = 0; i < messages; ++i) {
+        think(think_time);
+        const auto sent = Clock::now();
+        if (!sendAll(client, frame.data(), frame.size()) || !recvAll(client, reply, sizeof(reply))) break;
+        rtt_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+    }
+
+    const double wall = std::chrono::duration<double>(Clock::now() - started).count();
+    const double cpu = loopCpuSeconds(core) - cpu_before;
+    const uint64_t spins = stats.spins.load() - spins_before;
+
+    Result result;
+    std::sort(rtt_us.begin(), rtt_us.end());
+    if (!rtt_us.empty()) {
+        result.p50_us = rtt_us[rtt_us.size() / 2];
+        result.p99_us = rtt_us[std::min(rtt_us.size() - 1, rtt_us.size() * 99 / 100)];
+    }
+    result.cpu_us_per_message = cpu * 1e6 / messages;
+    result.cpu_share = cpu / wall;
+    result.hit_rate = spins ? static_cast<double>(stats.hits.load() - hits_before) / spins : 0.0;
+    result.parks_per_message = static_cast<double>(stats.parks.load() - parks_before) / messages;
+
+    connection->close(1001);
+    connection.reset();
+    core.stop();
+    SocketUtils::closeSocket(client);
+    SocketUtils::closeSocket(listener);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t messages = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    const auto think_time = std::chrono::microseconds(argc > 2 ? std::atoi(argv[2]) : 20);
+    SocketUtils::initialize();
+
+    const std::vector<Setting> settings = {
+        {"off", {0, false}},
+        {"10us", {10, false}},
+        {"50us", {50, false}},
+        {"50us adaptive", {50, true}},
+        {"200us", {200, false}},
+        {"200us adaptive", {200, true}},
+    };
+
+    std::cout << messages << " round trips, client thinks " << think_time.count() << " us between them\n"
+              << std::left << std::setw(16) << "spin budget" << std::right << std::setw(10) << "p50 us"
+              << std::setw(10) << "p99 us" << std::setw(14) << "cpu us/msg" << std::setw(10) << "cpu %"
+              << std::setw(10) << "hit %" << std::setw(12) << "parks/msg" << "\n";
+    for (const Setting& setting : settings) {
+        const Result result = run(setting.config, messages, think_time);
+        std::cout << std::left << std::setw(16) << setting.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << result.p50_us << std::setw(10) << result.p99_us << std::setprecision(2)
+                  << std::setw(14) << result.cpu_us_per_message << std::setprecision(1) << std::setw(10)
+                  << result.cpu_share * 100 << std::setw(10) << result.hit_rate * 100 << std::setprecision(2)
+                  << std::setw(12) << result.parks_per_message << "\n";
+    }
+
+    SocketUtils::cleanup();
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Пропускная способность доставки завершений в зависимости от числа потоков.
+// Каждый обработчик по получении завершения сразу ставит следующее через
+// postCompletion, в полёте держится по одному завершению на обработчик.
+//
+// Запуск: completion_bench [completions] [handlers]
+
+#include "../iocp_core.h"
+#include "../socket_utils.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+class PingHandler : public CompletionHandler {
+public:
+    PingHandler(IOCPCore& core, std::atomic<int64_t>& remaining)
+        : core_(core), remaining_(remaining) {
+        ZeroMemory(&overlapped_, sizeof(overlapped_));
+    }
+
+    void kick() { core_.postCompletion(0, this, &overlapped_); }
+
+    void onCompletion(DWORD, LPOVERLAPPED, DWORD) override {
+        if (remaining_.fetch_sub(1, std::memory_order_relaxed) > 1) {
+            kick();
+        }
+    }
+
+private:
+    IOCPCore& core_;
+    std::atomic<int64_t>& remaining_;
+    OVERLAPPED overlapped_;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int64_t total = argc > 1 ? std::atoll(argv[1]) : 2000000;
+    const int handlers = argc > 2 ? std::atoi(argv[2]) : 64;
+
+    SocketUtils::initialize();
+
+    for (int workers : {1, 2, 4, 8}) {
+        IOCPCore core;
+        if (!core.setup()) return 1;
+
+        std::atomic<int64_t> remaining{total};
+        std::vector<PingHandler> pings;
+        pings.reserve(handlers);
+        for (int i = 0; i < handlers; ++i) pings.emplace_back(core, remaining);
+
+        core.runWorkerThreads(workers);
+        auto started = std::chrono::steady_clock::now();
+        for (auto& ping : pings) ping.kick();
+
+        while (remaining.load(std::memory_order_relaxed) > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        core.stop();
+
+        std::cout << "workers=" << workers
+                  << " completions/s=" << static_cast<uint64_t>(total / elapsed) << "\n";
+    }
+
+    SocketUtils::cleanup();
+    return 0;
+}
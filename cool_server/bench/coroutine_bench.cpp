@@ -0,0 +1,176 @@
+// Цена корутин поверх цикла событий.
+// 1. Кадры: создать live корутин, каждая засыпает на co_await, затем
+//    продолжить все (корутины завершаются). Кадры из арены цикла (в его
+//    потоке) против кадров из кучи (в постороннем потоке). В цену арены
+//    входит и учёт живых корутин для остановки цикла, у кучи его нет.
+// 2. Продолжение через цикл: одна корутина N раз делает co_await на
+//    завершении, поставленном postCompletion, против обработчика, который
+//    ставит следующее завершение из onCompletion.
+//
+// Запуск: coroutine_bench [корутин] [завершений]
+
+#include "../coroutine.h"
+#include "../socket_utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using websocket::Task;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<std::coroutine_handle<>> parked;
+
+// Паркует корутину, продолжит её бенчмарк
+struct Park {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { parked.push_back(handle); }
+    void await_resume() const noexcept {}
+};
+
+Task parkOnce(uint64_t& sum, uint64_t value) {
+    // Немного состояния в кадре, как у настоящего обработчика
+    char scratch[64];
+    scratch[value % sizeof(scratch)] = static_cast<char>(value);
+    co_await Park{};
+    sum += value + static_cast<uint8_t>(scratch[value % sizeof(scratch)]);
+}
+
+// ns на корутину: создание, приостановка, продолжение, освобождение кадра
+double frameCost(size_t live, size_t rounds) {
+    uint64_t sum = 0;
+    parked.reserve(live);
+    const auto started = Clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < live; ++i) parkOnce(sum, i);
+        for (auto handle : parked) handle.resume();
+        parked.clear();
+    }
+    const double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - started).count();
+    if (sum == 1) std::cout << "";
+    return elapsed / static_cast<double>(live * rounds);
+}
+
+// Запускает fn в рабочем потоке цикла и ждёт завершения
+template <typename Fn>
+void runOnLoop(IOCPCore& core, Fn fn) {
+    struct Runner : CompletionHandler {
+        Fn fn;
+        std::atomic<bool> done{false};
+        explicit Runner(Fn f) : fn(std::move(f)) {}
+        void onCompletion(DWORD, LPOVERLAPPED, DWORD) override {
+            fn();
+            done = true;
+        }
+    } runner(std::move(fn));
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(overlapped));
+    core.postCompletion(0, &runner, &overlapped);
+    while (!runner.done) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+// Продолжение корутины завершением из очереди цикла
+class Yield : public CompletionHandler {
+public:
+    explicit Yield(IOCPCore& core) : core_(core) { ZeroMemory(&overlapped_, sizeof(overlapped_)); }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        handle_ = handle;
+        core_.postCompletion(0, this, &overlapped_);
+    }
+    void await_resume() const noexcept {}
+
+    void onCompletion(DWORD, LPOVERLAPPED, DWORD) override { handle_.resume(); }
+
+private:
+    IOCPCore& core_;
+    OVERLAPPED overlapped_;
+    std::coroutine_handle<> handle_;
+};
+
+Task yieldLoop(IOCPCore& core, int64_t count, std::atomic<bool>& done) {
+    Yield yield(core);
+    for (int64_t i = 0; i < count; ++i) co_await yield;
+    done = true;
+}
+
+class Chain : public CompletionHandler {
+public:
+    Chain(IOCPCore& core, int64_t count) : core_(core), remaining_(count) {
+        ZeroMemory(&overlapped_, sizeof(overlapped_));
+    }
+
+    void kick() { core_.postCompletion(0, this, &overlapped_); }
+
+    void onCompletion(DWORD, LPOVERLAPPED, DWORD) override {
+        if (--remaining_ > 0) kick();
+        else done = true;
+    }
+
+    std::atomic<bool> done{false};
+
+private:
+    IOCPCore& core_;
+    OVERLAPPED overlapped_;
+    int64_t remaining_;
+};
+
+template <typename Wait>
+double perCompletion(int64_t count, Clock::time_point started, Wait wait) {
+    while (!wait()) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    return std::chrono::duration<double, std::nano>(Clock::now() - started).count() / static_cast<double>(count);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t coroutines = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000;
+    const int64_t completions = argc > 2 ? std::atoll(argv[2]) : 1000000;
+    const size_t rounds = std::max<size_t>(1, 2000000 / coroutines);
+
+    SocketUtils::initialize();
+    IOCPCore core;
+    if (!core.setup()) return 1;
+    core.runWorkerThreads(1);
+
+    // Прогрев: арена нарезает куски, куча набирает свободные блоки
+    frameCost(coroutines, 1);
+    runOnLoop(core, [&] { frameCost(coroutines, 1); });
+
+    for (size_t live : {size_t{1}, coroutines}) {
+        const size_t n = std::max<size_t>(1, rounds * coroutines / live / 2);
+        double heap = frameCost(live, n);
+        double arena = 0;
+        runOnLoop(core, [&] { arena = frameCost(live, n); });
+        std::cout << "live=" << live << " heap frames " << heap << " ns, arena frames " << arena
+                  << " ns per coroutine\n";
+    }
+
+    std::atomic<bool> done{false};
+    auto started = Clock::now();
+    runOnLoop(core, [&] { yieldLoop(core, completions, done); });
+    const double coroutine_ns = perCompletion(completions, started, [&] { return done.load(); });
+
+    Chain chain(core, completions);
+    started = Clock::now();
+    chain.kick();
+    const double callback_ns = perCompletion(completions, started, [&] { return chain.done.load(); });
+
+    std::cout << "resume via loop: coroutine " << coroutine_ns << " ns, callback " << callback_ns
+              << " ns per completion\n";
+
+    const auto stats = core.coroutineArena().stats();
+    std::cout << "arena: " << stats.frames << " frames, " << stats.heap_frames << " heap, "
+              << stats.reserved_bytes / 1024 << " KB reserved\n";
+
+    core.stop();
+    SocketUtils::cleanup();
+    return 0;
+}
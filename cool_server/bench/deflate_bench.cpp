@@ -0,0 +1,196 @@
+// permessage-deflate на чат-трафике: степень сжатия и скорость на
+// JSON-сообщениях, память zlib на соединение с общим словарём и без,
+// и поведение бюджета памяти. Перед замером поток сверяется: всё сжатое
+// сервером распаковывается «клиентом» в исходные сообщения.
+//
+// Запуск: deflate_bench [соединений] [сообщений]
+
+#include "../deflate.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using websocket::DeflateConfig;
+using websocket::DeflateMemory;
+using websocket::DeflateParams;
+using websocket::PerMessageDeflate;
+
+std::vector<std::string> makeMessages(size_t count) {
+    const char* users[] = {"alice", "bob", "carol", "dave", "erin"};
+    const char* words[] = {"deploy", "is", "done", "lunch", "the", "review", "looks", "good", "ship", "it"};
+    std::mt19937 gen(7);
+    std::vector<std::string> messages;
+    for (size_t i = 0; i < count; ++i) {
+        std::string text;
+        for (int w = 0; w < 8 + static_cast<int>(gen() % 24); ++w) {
+            text += words[gen() % 10];
+            text += ' ';
+        }
+        messages.push_back("{\"type\":\"message\",\"room\":\"general\",\"user\":\"" +
+                           std::string(users[gen() % 5]) + "\",\"id\":" + std::to_string(100000 + i) +
+                           ",\"ts\":" + std::to_string(1700000000000ULL + i * 37) +
+                           ",\"text\":\"" + text + "\"}");
+    }
+    return messages;
+}
+
+// Параметры «клиента»: он распаковывает то, что сжал сервер
+DeflateParams mirror(const DeflateParams& server) {
+    DeflateParams client = server;
+    client.client_max_window_bits = server.server_max_window_bits;
+    client.client_no_context_takeover = server.server_no_context_takeover;
+    return client;
+}
+
+bool negotiation() {
+    struct Case { const char* offer; bool accepted; const char* response; };
+    const Case cases[] = {
+        {"permessage-deflate", true, "permessage-deflate"},
+        {"permessage-deflate; client_max_window_bits", true, "permessage-deflate; client_max_window_bits=12"},
+        {"permessage-deflate; server_max_window_bits=10; server_no_context_takeover", true,
+         "permessage-deflate; server_no_context_takeover; server_max_window_bits=10"},
+        {"permessage-deflate; server_max_window_bits=8, permessage-deflate", true, "permessage-deflate"},
+        {"permessage-deflate; server_max_window_bits=8", false, ""},
+        {"permessage-deflate; foo", false, ""},
+        {"x-webkit-deflate-frame", false, ""},
+    };
+    DeflateConfig config;
+    config.enabled = true;
+    config.client_max_window_bits = 12;
+
+    bool ok = true;
+    for (const Case& c : cases) {
+        DeflateParams params;
+        std::string response;
+        const bool accepted = PerMessageDeflate::negotiate(c.offer, config, nullptr, params, response);
+        if (accepted != c.accepted || (accepted && response != c.response)) {
+            std::cerr << "negotiation mismatch: \"" << c.offer << "\" -> \"" << response << "\"\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool roundTrip(const std::vector<std::string>& messages, const DeflateParams& params,
+               size_t& raw_bytes, size_t& wire_bytes, double& seconds) {
+    PerMessageDeflate server(params, nullptr);
+    PerMessageDeflate client(mirror(params), nullptr);
+    std::string compressed, restored;
+    raw_bytes = wire_bytes = 0;
+
+    auto start = Clock::now();
+    for (const std::string& message : messages) {
+        if (!server.compress(reinterpret_cast<const uint8_t*>(message.data()), message.size(), compressed)) {
+            return false;
+        }
+        raw_bytes += message.size();
+        wire_bytes += compressed.size();
+
+        // Клиент получает сообщение двумя фрагментами
+        restored.clear();
+        const size_t half = compressed.size() / 2;
+        auto* data = reinterpret_cast<const uint8_t*>(compressed.data());
+        if (client.decompress(data, half, false, restored, 1 << 20) != PerMessageDeflate::InflateResult::Ok ||
+            client.decompress(data + half, compressed.size() - half, true, restored, 1 << 20) !=
+                PerMessageDeflate::InflateResult::Ok ||
+            restored != message) {
+            return false;
+        }
+    }
+    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t connections = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000;
+    const size_t count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+    const std::vector<std::string> messages = makeMessages(count);
+
+    if (!negotiation()) return 1;
+    std::cout << "negotiation: ok\n";
+
+    struct Mode { const char* name; bool no_context; int window; };
+    for (const Mode& mode : {Mode{"context takeover, window 15", false, 15},
+                             Mode{"context takeover, window 10", false, 10},
+                             Mode{"no context takeover", true, 15}}) {
+        DeflateParams params;
+        params.server_no_context_takeover = mode.no_context;
+        params.server_max_window_bits = mode.window;
+        size_t raw = 0, wire = 0;
+        double seconds = 0;
+        if (!roundTrip(messages, params, raw, wire, seconds)) {
+            std::cerr << "round trip failed: " << mode.name << "\n";
+            return 1;
+        }
+        std::cout << mode.name << ": " << raw << " -> " << wire << " bytes ("
+                  << 100.0 * wire / raw << "%), " << seconds * 1e6 / messages.size()
+                  << " us/message compress+inflate\n";
+    }
+
+    // Память: каждое соединение отправило и получило по сообщению
+    struct Footprint { const char* name; bool no_context; int window; int mem_level; };
+    for (const Footprint& mode : {Footprint{"context takeover, window 15, mem_level 8", false, 15, 8},
+                                  Footprint{"context takeover, window 10, mem_level 4", false, 10, 4},
+                                  Footprint{"no context takeover", true, 15, 8}}) {
+        DeflateMemory memory;
+        DeflateParams params;
+        params.server_no_context_takeover = params.client_no_context_takeover = mode.no_context;
+        params.server_max_window_bits = params.client_max_window_bits = mode.window;
+        params.mem_level = mode.mem_level;
+        std::vector<std::unique_ptr<PerMessageDeflate>> peers;
+        // Отправитель сжимает каждое сообщение независимо: у каждого пира
+        // своя история, общий словарь отправителя им не подходит
+        DeflateParams independent = mirror(params);
+        independent.server_no_context_takeover = true;
+        PerMessageDeflate sender(independent, nullptr);
+        std::string out, in;
+        for (size_t i = 0; i < connections; ++i) {
+            auto peer = std::make_unique<PerMessageDeflate>(params, &memory);
+            const std::string& message = messages[i % messages.size()];
+            peer->compress(reinterpret_cast<const uint8_t*>(message.data()), message.size(), out);
+            sender.compress(reinterpret_cast<const uint8_t*>(message.data()), message.size(), out);
+            in.clear();
+            if (peer->decompress(reinterpret_cast<const uint8_t*>(out.data()), out.size(), true, in, 1 << 20) !=
+                    PerMessageDeflate::InflateResult::Ok || in != message) {
+                std::cerr << "inflate failed: " << mode.name << "\n";
+                return 1;
+            }
+            peers.push_back(std::move(peer));
+        }
+        const auto stats = memory.stats();
+        std::cout << mode.name << ": " << connections
+                  << " connections hold " << stats.in_use / (1024 * 1024) << " MB zlib ("
+                  << stats.in_use / connections / 1024 << " KB each), peak "
+                  << stats.peak / (1024 * 1024) << " MB\n";
+    }
+
+    // Бюджет: сверх него расширение не согласуется
+    DeflateConfig config;
+    config.enabled = true;
+    config.memory_budget = 64 * 1024 * 1024;
+    DeflateMemory memory(config.memory_budget);
+    std::vector<std::unique_ptr<PerMessageDeflate>> peers;
+    std::string out;
+    for (size_t i = 0; i < connections; ++i) {
+        DeflateParams params;
+        std::string response;
+        if (!PerMessageDeflate::negotiate("permessage-deflate", config, &memory, params, response)) continue;
+        peers.push_back(std::make_unique<PerMessageDeflate>(params, &memory));
+        const std::string& message = messages[i % messages.size()];
+        peers.back()->compress(reinterpret_cast<const uint8_t*>(message.data()), message.size(), out);
+    }
+    const auto stats = memory.stats();
+    std::cout << "budget 64 MB: " << stats.negotiated << " negotiated, " << stats.declined
+              << " declined, " << stats.alloc_failures << " allocation failures, in use "
+              << stats.in_use / (1024 * 1024) << " MB\n";
+    return 0;
+}
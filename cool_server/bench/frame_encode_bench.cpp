@@ -0,0 +1,128 @@
+// Кодирование серверного фрейма: прежний Frame::createFrame (vector,
+// заголовок по байту через push_back, payload через insert) против
+// нынешнего createFrame, createPooledFrame и FrameEncoder, пишущего
+// фреймы подряд в выходной блок 16 КБ, как соединение, пока отправка
+// в полёте. Перед замером результаты сверяются побайтно.
+//
+// Запуск: frame_encode_bench [фреймов на размер]
+
+#include "../frame.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using websocket::Frame;
+using websocket::Opcode;
+using websocket::ServerFrameEncoder;
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t OUTPUT_BLOCK_SIZE = 16 * 1024;
+
+std::vector<uint8_t> createFrameLegacy(Opcode opcode, std::string_view payload) {
+    std::vector<uint8_t> frame;
+    frame.reserve(Frame::MAX_HEADER_SIZE + payload.size());
+    frame.push_back(0x80 | static_cast<uint8_t>(opcode));
+    if (payload.size() <= 125) {
+        frame.push_back(static_cast<uint8_t>(payload.size()));
+    } else if (payload.size() <= 65535) {
+        frame.push_back(126);
+        frame.push_back((payload.size() >> 8) & 0xFF);
+        frame.push_back(payload.size() & 0xFF);
+    } else {
+        frame.push_back(127);
+        for (int i = 7; i >= 0; --i) {
+            frame.push_back((payload.size() >> (8 * i)) & 0xFF);
+        }
+    }
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+bool verify() {
+    for (size_t size : {0, 1, 125, 126, 127, 65535, 65536, 100000}) {
+        std::string payload(size, '\0');
+        for (size_t i = 0; i < size; ++i) payload[i] = static_cast<char>(i * 131 + 7);
+        const auto* data = reinterpret_cast<const uint8_t*>(payload.data());
+
+        const std::vector<uint8_t> expected = createFrameLegacy(Opcode::Binary, payload);
+        const websocket::PooledBuffer pooled = Frame::createPooledFrame(Opcode::Binary, payload);
+        std::vector<uint8_t> encoded(ServerFrameEncoder::frameSize(size));
+        encoded.resize(ServerFrameEncoder::encode(encoded.data(), Opcode::Binary, data, size));
+        if (Frame::createFrame(Opcode::Binary, payload) != expected || encoded != expected ||
+            std::vector<uint8_t>(pooled.data(), pooled.data() + pooled.size()) != expected) {
+            std::cerr << "mismatch: size=" << size << "\n";
+            return false;
+        }
+
+        // Маскированный: разбираем и снимаем маску обратно
+        std::vector<uint8_t> masked = Frame::createFrame(Opcode::Binary, payload, true);
+        websocket::FrameHeader header;
+        if (!Frame::parseHeader(masked.data(), masked.size(), header) || !header.masked ||
+            header.payload_length != size || header.header_size + size != masked.size()) {
+            std::cerr << "masked header mismatch: size=" << size << "\n";
+            return false;
+        }
+        Frame::unmask(header, masked.data() + header.header_size, size);
+        if (std::string(masked.begin() + header.header_size, masked.end()) != payload) {
+            std::cerr << "masked payload mismatch: size=" << size << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Fn>
+double nsPerFrame(size_t frames, Fn&& fn) {
+    const auto start = Clock::now();
+    for (size_t i = 0; i < frames; ++i) fn(i);
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / frames;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t frames = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    if (!verify()) return 1;
+
+    std::cout << std::setw(8) << "payload" << std::setw(14) << "legacy ns" << std::setw(14) << "createFrame"
+              << std::setw(14) << "pooled" << std::setw(14) << "encoder" << std::setw(10) << "speedup" << "\n";
+
+    uint64_t sink = 0;
+    for (size_t size : {16, 64, 125, 126, 512, 4096, 65536}) {
+        const std::string payload(size, 'x');
+        const auto* data = reinterpret_cast<const uint8_t*>(payload.data());
+        const size_t count = std::max<size_t>(1000, frames * 64 / (64 + size));
+
+        const double legacy = nsPerFrame(count, [&](size_t i) {
+            sink += createFrameLegacy(Opcode::Text, payload)[i % 2];
+        });
+        const double vector = nsPerFrame(count, [&](size_t i) {
+            sink += Frame::createFrame(Opcode::Text, payload)[i % 2];
+        });
+        const double pooled = nsPerFrame(count, [&](size_t i) {
+            sink += Frame::createPooledFrame(Opcode::Text, payload).data()[i % 2];
+        });
+
+        // Выходной блок соединения: заполнился — уходит в ядро, берём следующий
+        websocket::PooledBuffer block;
+        const double encoder = nsPerFrame(count, [&](size_t) {
+            const size_t frame_size = ServerFrameEncoder::frameSize(size);
+            if (!block || block.capacity() - block.size() < frame_size) {
+                if (block) sink += block.data()[block.size() - 1];
+                block = websocket::PooledBuffer(std::max(frame_size, OUTPUT_BLOCK_SIZE));
+            }
+            const size_t used = block.size();
+            block.resize(used + ServerFrameEncoder::encode(block.data() + used, Opcode::Text, data, size));
+        });
+
+        std::cout << std::setw(8) << size << std::fixed << std::setprecision(1) << std::setw(14) << legacy
+                  << std::setw(14) << vector << std::setw(14) << pooled << std::setw(14) << encoder
+                  << std::setw(9) << legacy / encoder << "x\n";
+    }
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+// Стоимость рукопожатия: прежний путь (istringstream + getline + find,
+// SHA-1 и base64 через цепочку BIO OpenSSL) против HandshakeParser и
+// Handshake::response. Перед замером проверяются SHA-1 на векторах
+// FIPS 180, ключ из примера RFC 6455 и разбор запроса, пришедшего
+// кусками по одному байту.
+//
+// Сборка: нужен -lcrypto (только ради прежнего пути)
+// Запуск: handshake_bench [рукопожатий]
+
+#include "../handshake.h"
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using websocket::Handshake;
+using websocket::HandshakeParser;
+
+const std::string REQUEST = "GET /chat HTTP/1.1\r\n"
+                            "Host: chat.example.com:8080\r\n"
+                            "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 Chrome/120.0\r\n"
+                            "Accept-Encoding: gzip, deflate, br\r\n"
+                            "Accept-Language: en-US,en;q=0.9\r\n"
+                            "Cache-Control: no-cache\r\n"
+                            "Pragma: no-cache\r\n"
+                            "Origin: https://chat.example.com\r\n"
+                            "Upgrade: websocket\r\n"
+                            "Connection: Upgrade\r\n"
+                            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                            "Sec-WebSocket-Version: 13\r\n"
+                            "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n"
+                            "\r\n";
+
+// Прежний путь из RFC6455Handler: разбор и ответ
+std::string oldBase64(const std::string& input) {
+    BIO* b64 = BIO_new(BIO_f_base64());
+    BIO* mem = BIO_new(BIO_s_mem());
+    BIO_push(b64, mem);
+    BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
+    BIO_write(b64, input.data(), static_cast<int>(input.size()));
+    BIO_flush(b64);
+    char* data;
+    long len = BIO_get_mem_data(mem, &data);
+    std::string result(data, len);
+    BIO_free_all(b64);
+    return result;
+}
+
+bool oldHandshake(const std::string& request, std::string& response) {
+    std::istringstream iss(request);
+    std::string line, key, extensions;
+    std::getline(iss, line);
+    if (line.find("GET") == std::string::npos) return false;
+    bool upgrade = false, connection = false;
+    while (std::getline(iss, line)) {
+        if (line.find("Sec-WebSocket-Key:") != std::string::npos) {
+            size_t start = line.find(':') + 1;
+            while (start < line.size() && (line[start] == ' ' || line[start] == '\t')) start++;
+            key = line.substr(start, line.find('\r', start) - start);
+        } else if (line.find("Sec-WebSocket-Extensions:") != std::string::npos) {
+            size_t start = line.find(':') + 1;
+            if (!extensions.empty()) extensions += ", ";
+            extensions += line.substr(start, line.find('\r', start) - start);
+        } else if (line.find("Upgrade: websocket") != std::string::npos) {
+            upgrade = true;
+        } else if (line.find("Connection: Upgrade") != std::string::npos) {
+            connection = true;
+        }
+    }
+    if (key.empty() || !upgrade || !connection) return false;
+
+    std::string combined = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    unsigned char hash[SHA_DIGEST_LENGTH];
+    SHA1(reinterpret_cast<const unsigned char*>(combined.data()), combined.size(), hash);
+    response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+               "Sec-WebSocket-Accept: " +
+               oldBase64(std::string(reinterpret_cast<char*>(hash), SHA_DIGEST_LENGTH)) + "\r\n\r\n";
+    return true;
+}
+
+std::vector<uint8_t> newHandshake(const std::string& request) {
+    const auto* data = reinterpret_cast<const uint8_t*>(request.data());
+    HandshakeParser parser;
+    if (parser.parse(data, request.size()) != HandshakeParser::Result::Done) return {};
+    return Handshake::response(parser.key(data), std::string());
+}
+
+std::string hex(const uint8_t* data, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < len; ++i) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 0xF];
+    }
+    return out;
+}
+
+bool verify() {
+    struct Vector { std::string input; const char* digest; };
+    const Vector vectors[] = {
+        {"", "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+        {"abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+        {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+        {std::string(1000, 'a'), "291e9a6c66994949b57ba5e650361e98fc36b1ba"},
+    };
+    for (const Vector& v : vectors) {
+        uint8_t digest[20];
+        Handshake::sha1(reinterpret_cast<const uint8_t*>(v.input.data()), v.input.size(), digest);
+        if (hex(digest, 20) != v.digest) {
+            std::cerr << "sha1 mismatch for input of " << v.input.size() << " bytes\n";
+            return false;
+        }
+    }
+
+    char accept[Handshake::ACCEPT_KEY_SIZE];
+    Handshake::acceptKey("dGhlIHNhbXBsZSBub25jZQ==", accept);
+    if (std::string(accept, sizeof(accept)) != "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") {
+        std::cerr << "accept key mismatch\n";
+        return false;
+    }
+
+    // Запрос приходит по байту, за ним сразу фрейм
+    const std::string pipelined = REQUEST + "\x81\x80";
+    const auto* data = reinterpret_cast<const uint8_t*>(pipelined.data());
+    HandshakeParser parser;
+    for (size_t size = 1; size <= pipelined.size(); ++size) {
+        const auto result = parser.parse(data, size);
+        const bool done = size >= REQUEST.size();
+        if (result != (done ? HandshakeParser::Result::Done : HandshakeParser::Result::Incomplete)) {
+            std::cerr << "incremental parse failed at " << size << " bytes\n";
+            return false;
+        }
+    }
+    if (parser.requestSize() != REQUEST.size() || parser.extensionCount() != 1 ||
+        parser.extension(data, 0) != "permessage-deflate; client_max_window_bits") {
+        std::cerr << "parsed fields mismatch\n";
+        return false;
+    }
+
+    std::string old_response;
+    const std::vector<uint8_t> response = newHandshake(REQUEST);
+    if (!oldHandshake(REQUEST, old_response) ||
+        old_response != std::string(response.begin(), response.end())) {
+        std::cerr << "responses differ\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    if (!verify()) return 1;
+    std::cout << "verify: ok\n";
+
+    size_t sink = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        std::string response;
+        oldHandshake(REQUEST, response);
+        sink += response.size();
+    }
+    const double old_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+
+    start = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        sink += newHandshake(REQUEST).size();
+    }
+    const double new_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+
+    // Отдельно разбор: без SHA-1 и ответа
+    start = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        HandshakeParser parser;
+        sink += parser.parse(reinterpret_cast<const uint8_t*>(REQUEST.data()), REQUEST.size()) ==
+                HandshakeParser::Result::Done;
+    }
+    const double parse_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+
+    std::cout << "request " << REQUEST.size() << " bytes, " << count << " handshakes\n"
+              << "istringstream + OpenSSL BIO: " << old_ns << " ns/handshake\n"
+              << "HandshakeParser + SHA-1:     " << new_ns << " ns/handshake (parse alone " << parse_ns
+              << " ns)\n"
+              << (sink == 0 ? "\n" : "");
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Скорость наложения маски WebSocket: побайтовый цикл со сдвигом и
+// остатком (как было в decodePayload) против Frame::applyMask.
+// Перед замером результаты сверяются, в том числе со смещением offset.
+//
+// Запуск: mask_bench [мегабайт на замер]
+
+#include "../frame.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+void maskBytewise(uint32_t key, uint8_t* data, size_t len, size_t offset) {
+    for (size_t i = 0; i < len; ++i) {
+        data[i] ^= ((key >> (8 * (3 - ((i + offset) % 4)))) & 0xFF);
+    }
+}
+
+template <typename Fn>
+double gbPerSecond(std::vector<uint8_t>& buffer, size_t total_bytes, Fn&& fn) {
+    const size_t iterations = std::max<size_t>(3, total_bytes / buffer.size());
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        fn(buffer.data(), buffer.size());
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(iterations * buffer.size()) / elapsed.count() / 1e9;
+}
+
+bool verify(uint32_t key) {
+    for (size_t len : {0, 1, 3, 15, 16, 17, 31, 33, 127, 129, 1000, 4099}) {
+        for (size_t offset = 0; offset < 4; ++offset) {
+            std::vector<uint8_t> a(len), b(len);
+            for (size_t i = 0; i < len; ++i) a[i] = b[i] = static_cast<uint8_t>(i * 131 + 7);
+            maskBytewise(key, a.data(), len, offset);
+            websocket::Frame::applyMask(key, b.data(), len, offset);
+            if (a != b) {
+                std::cerr << "mismatch: len=" << len << " offset=" << offset << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256;
+    const size_t total = megabytes * 1024 * 1024;
+    const uint32_t key = 0x37fa213d;
+
+    if (!verify(key)) return 1;
+
+    std::cout << "kernel: " << websocket::Frame::maskKernel() << "\n";
+    std::cout << std::setw(10) << "size" << std::setw(16) << "bytewise GB/s"
+              << std::setw(16) << "applyMask GB/s" << std::setw(10) << "speedup" << "\n";
+
+    for (size_t size = 16; size <= 16 * 1024 * 1024; size *= 4) {
+        std::vector<uint8_t> buffer(size, 0x5a);
+
+        double bytewise = gbPerSecond(buffer, total, [&](uint8_t* data, size_t len) {
+            maskBytewise(key, data, len, 0);
+        });
+        double simd = gbPerSecond(buffer, total, [&](uint8_t* data, size_t len) {
+            websocket::Frame::applyMask(key, data, len);
+        });
+
+        std::cout << std::setw(10) << size << std::fixed << std::setprecision(2)
+                  << std::setw(16) << bytewise << std::setw(16) << simd
+                  << std::setw(9) << simd / bytewise << "x\n";
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Цена обращения к памяти своего и чужого узла NUMA.
+// Для каждой пары (узел потока, узел памяти) поток закрепляется за
+// первым процессором своего узла, берёт буфер через Numa::allocate на
+// узле памяти и меряет задержку случайного обхода цепочки указателей и
+// скорость последовательного чтения. Заодно проверяет, где на самом
+// деле легли страницы, и показывает счётчики загрузок с чужого узла.
+// На машине с одним узлом остаётся только строка 0 -> 0.
+//
+// Запуск: numa_bench [MB на буфер]
+
+#include "../numa.h"
+#include "../thread_affinity.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    double latency_ns = 0;
+    double bandwidth_gbs = 0;
+    Numa::PagePlacement pages;
+    uint64_t node_loads = 0;
+    uint64_t remote_loads = 0;
+    bool counters = false;
+};
+
+// Строка кэша на звено: обход не попадает в соседние звенья
+struct alignas(64) Link {
+    Link* next;
+};
+
+Result measure(int cpu, int node, size_t bytes) {
+    Result result;
+    ThreadAffinity::pinCurrentThread(cpu);
+
+    const size_t links = bytes / sizeof(Link);
+    Link* memory = static_cast<Link*>(Numa::allocate(links * sizeof(Link), node));
+    if (!memory) return result;
+
+    // Случайная перестановка — один цикл через все звенья, префетчер не угадает
+    std::vector<size_t> order(links);
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::shuffle(order.begin() + 1, order.end(), std::mt19937_64(42));
+    for (size_t i = 0; i < links; ++i) memory[order[i]].next = &memory[order[(i + 1) % links]];
+    Numa::pagePlacement(memory, links * sizeof(Link), node, result.pages);
+
+    Numa::Traffic traffic;
+    result.counters = traffic.start();
+
+    const size_t hops = std::min<size_t>(links, 4 * 1024 * 1024);
+    Link* link = memory;
+    auto started = Clock::now();
+    for (size_t i = 0; i < hops; ++i) link = link->next;
+    result.latency_ns = std::chrono::duration<double, std::nano>(Clock::now() - started).count() / hops;
+
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(memory);
+    const size_t count = links * sizeof(Link) / sizeof(uint64_t);
+    uint64_t sum = reinterpret_cast<uintptr_t>(link);
+    started = Clock::now();
+    for (int pass = 0; pass < 4; ++pass) {
+        for (size_t i = 0; i < count; ++i) sum += words[i];
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    result.bandwidth_gbs = 4.0 * count * sizeof(uint64_t) / seconds / 1e9;
+    if (sum == 1) std::cout << "";
+
+    result.node_loads = traffic.nodeLoads();
+    result.remote_loads = traffic.remoteLoads();
+    Numa::release(memory, links * sizeof(Link));
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256;
+    const int nodes = Numa::nodeCount();
+
+    // Первый доступный процессор каждого узла
+    std::vector<int> node_cpu(nodes, -1);
+    for (int cpu : ThreadAffinity::availableCpus()) {
+        int node = Numa::nodeOfCpu(cpu);
+        if (node < nodes && node_cpu[node] < 0) node_cpu[node] = cpu;
+    }
+
+    std::cout << nodes << " NUMA nodes, " << megabytes << " MB per buffer\n"
+              << "cpu node -> memory node   latency ns   read GB/s   pages local/remote/unknown   remote loads\n";
+    for (int cpu_node = 0; cpu_node < nodes; ++cpu_node) {
+        if (node_cpu[cpu_node] < 0) continue;
+        for (int memory_node = 0; memory_node < nodes; ++memory_node) {
+            Result result;
+            // Свой поток на замер: закрепление не тянется в следующий
+            std::thread([&] { result = measure(node_cpu[cpu_node], memory_node, megabytes << 20); }).join();
+            std::cout << std::setw(8) << cpu_node << " -> " << std::setw(11) << memory_node << std::fixed
+                      << std::setprecision(1) << std::setw(13) << result.latency_ns << std::setw(12)
+                      << std::setprecision(2) << result.bandwidth_gbs << std::setw(13) << result.pages.local << "/"
+                      << result.pages.remote << "/" << result.pages.unknown << "   ";
+            if (result.counters) {
+                std::cout << result.remote_loads << " of " << result.node_loads << "\n";
+            } else {
+                std::cout << "n/a\n";
+            }
+        }
+    }
+    return 0;
+}
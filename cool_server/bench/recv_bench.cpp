@@ -0,0 +1,107 @@
+// Разбор пачки мелких фреймов, пришедших одним чтением: старый путь
+// (дописать в vector, скопировать payload, erase с начала) против
+// ReceiveBuffer с разбором на месте. По умолчанию 64 КБ и 500 фреймов.
+//
+// Запуск: recv_bench [фреймов в чтении] [повторов]
+
+#include "../frame.h"
+#include "../receive_buffer.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Одно «чтение»: frames замаскированных текстовых фреймов разной длины
+std::vector<uint8_t> makeRead(size_t frames) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<size_t> length(16, 240);
+    std::vector<uint8_t> read;
+    for (size_t i = 0; i < frames; ++i) {
+        std::string payload(length(gen), 'x');
+        auto frame = websocket::Frame::createFrame(websocket::Opcode::Text, payload, true);
+        read.insert(read.end(), frame.begin(), frame.end());
+    }
+    return read;
+}
+
+size_t parseOld(std::vector<uint8_t>& buffer, const std::vector<uint8_t>& data) {
+    buffer.insert(buffer.end(), data.begin(), data.end());
+    size_t total = 0;
+    while (true) {
+        websocket::FrameHeader header;
+        if (!websocket::Frame::parseHeader(buffer, header)) break;
+        const size_t frame_size = header.header_size + header.payload_length;
+        if (buffer.size() < frame_size) break;
+        auto begin = buffer.begin() + header.header_size;
+        std::vector<uint8_t> payload(begin, begin + header.payload_length);
+        buffer.erase(buffer.begin(), buffer.begin() + frame_size);
+        websocket::Frame::unmask(header, payload.data(), payload.size());
+        total += payload[0];
+    }
+    return total;
+}
+
+size_t parseInPlace(websocket::ReceiveBuffer& buffer, const std::vector<uint8_t>& data) {
+    // Имитация recv прямо в хвост буфера
+    std::memcpy(buffer.prepare(data.size()), data.data(), data.size());
+    buffer.commit(data.size());
+    size_t total = 0;
+    while (!buffer.empty()) {
+        websocket::FrameHeader header;
+        if (!websocket::Frame::parseHeader(buffer.data(), buffer.size(), header)) break;
+        const size_t frame_size = header.header_size + header.payload_length;
+        if (buffer.size() < frame_size) break;
+        uint8_t* payload = buffer.data() + header.header_size;
+        websocket::Frame::unmask(header, payload, header.payload_length);
+        total += payload[0];
+        // Снятую маску возвращаем, чтобы следующий повтор видел те же данные
+        websocket::Frame::unmask(header, payload, header.payload_length);
+        buffer.consume(frame_size);
+    }
+    return total;
+}
+
+template <typename Fn>
+double usPerRead(size_t repeats, Fn&& fn) {
+    auto start = Clock::now();
+    for (size_t i = 0; i < repeats; ++i) fn();
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count() / static_cast<double>(repeats);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t frames = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 500;
+    const size_t repeats = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000;
+    const std::vector<uint8_t> read = makeRead(frames);
+
+    std::vector<uint8_t> old_buffer;
+    websocket::ReceiveBuffer ring;
+
+    // Пути должны увидеть одни и те же payload
+    std::vector<uint8_t> copy = read;
+    websocket::ReceiveBuffer check;
+    if (parseOld(old_buffer, read) != parseInPlace(check, copy)) {
+        std::cerr << "mismatch\n";
+        return 1;
+    }
+
+    size_t sink = 0;
+    double old_us = usPerRead(repeats, [&] { sink += parseOld(old_buffer, read); });
+    double new_us = usPerRead(repeats, [&] { sink += parseInPlace(ring, read); });
+
+    std::cout << "read: " << read.size() << " bytes, " << frames << " frames\n"
+              << "append+copy+erase: " << old_us << " us/read\n"
+              << "in place:          " << new_us << " us/read\n"
+              << "speedup:           " << old_us / new_us << "x"
+              << (sink == 0 ? " " : "") << "\n";
+    return 0;
+}
@@ -0,0 +1,175 @@
+// Задержка мелких сообщений на loopback при разных профилях SocketOptions.
+// Сервер отвечает на 64-байтный запрос двумя записями по 32 байта (эхо и
+// уведомление — как два фрейма из разных отправок): без TCP_NODELAY
+// вторая ждёт ACK первой, а клиент его откладывает. Для каждого
+// профиля меряются новое соединение (connect + первый ответ) и
+// round trip в открытом соединении, p50/p99.
+//
+// TCP_FASTOPEN на сервере включается sysctl net.ipv4.tcp_fastopen & 2,
+// SO_BUSY_POLL выше net.core.busy_read требует CAP_NET_ADMIN.
+//
+// Запуск: socket_options_bench [round trips] [соединений]
+
+#include "../socket_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t REQUEST_SIZE = 64;
+constexpr size_t REPLY_PART = 32;
+
+struct Profile {
+    const char* name;
+    SocketOptions options;
+};
+
+bool sendAll(SOCKET s, const char* data, size_t len) {
+    while (len > 0) {
+        int n = send(s, data, static_cast<int>(len), 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recvAll(SOCKET s, char* data, size_t len) {
+    while (len > 0) {
+        int n = recv(s, data, static_cast<int>(len), 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Обслуживает connections соединений по очереди и завершается
+void serve(SOCKET listener, const SocketOptions& options, size_t connections, bool& inherited) {
+    char request[REQUEST_SIZE];
+    const char reply[REPLY_PART] = {};
+    for (size_t i = 0; i < connections; ++i) {
+        SOCKET client = accept(listener, nullptr, nullptr);
+        if (client == INVALID_SOCKET) return;
+        SocketUtils::applyAcceptedOptions(client, options);
+        if (i == 0) {
+            // Принятый сокет должен получить профиль listen-сокета
+            int value = 0;
+            socklen_t len = sizeof(value);
+            getsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char*>(&value), &len);
+            inherited = (value != 0) == options.no_delay;
+        }
+        while (recvAll(client, request, sizeof(request))) {
+            if (!sendAll(client, reply, sizeof(reply)) || !sendAll(client, reply, sizeof(reply))) break;
+        }
+        SocketUtils::closeSocket(client);
+    }
+}
+
+SOCKET connectTo(const sockaddr_in& address) {
+    SOCKET s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) return s;
+    if (connect(s, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR) {
+        SocketUtils::closeSocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+bool roundTrip(SOCKET s) {
+    char request[REQUEST_SIZE] = {};
+    char reply[2 * REPLY_PART];
+    return sendAll(s, request, sizeof(request)) && recvAll(s, reply, sizeof(reply));
+}
+
+double percentile(std::vector<double>& samples, double p) {
+    if (samples.empty()) return 0.0;
+    const size_t index = std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+double elapsedUs(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t round_trips = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+    const size_t connections = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200;
+    if (!SocketUtils::initialize()) return 1;
+
+    std::vector<Profile> profiles;
+    profiles.push_back({"system defaults", {}});
+    profiles.back().options.no_delay = false;
+    profiles.push_back({"TCP_NODELAY", {}});
+    profiles.push_back({"+ 256K buffers", {}});
+    profiles.back().options.send_buffer = profiles.back().options.receive_buffer = 256 * 1024;
+    profiles.push_back({"+ defer accept 1s", {}});
+    profiles.back().options.defer_accept_seconds = 1;
+    profiles.push_back({"+ fast open 256", {}});
+    profiles.back().options.fast_open_queue = 256;
+    profiles.push_back({"+ user timeout 5s", {}});
+    profiles.back().options.user_timeout_ms = 5000;
+    profiles.push_back({"+ busy poll 50us", {}});
+    profiles.back().options.busy_poll_us = 50;
+
+    std::cout << round_trips << " round trips, " << connections << " new connections per profile\n"
+              << std::left << std::setw(20) << "profile" << std::right << std::setw(12) << "connect p50"
+              << std::setw(12) << "p99" << std::setw(12) << "rtt p50" << std::setw(12) << "p99"
+              << "  inherited\n";
+
+    for (const Profile& profile : profiles) {
+        SOCKET listener = SocketUtils::createSocket();
+        SocketUtils::setReuseAddr(listener);
+        const bool applied = SocketUtils::applyListenOptions(listener, profile.options);
+        if (!SocketUtils::bindSocket(listener, 0) || !SocketUtils::startListening(listener)) return 1;
+        sockaddr_in address{};
+        socklen_t address_len = sizeof(address);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&address), &address_len);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        bool inherited = false;
+        std::thread server(serve, listener, std::cref(profile.options), connections + 1, std::ref(inherited));
+
+        // Новое соединение: connect и первый ответ
+        std::vector<double> connect_us;
+        for (size_t i = 0; i < connections; ++i) {
+            const auto start = Clock::now();
+            SOCKET s = connectTo(address);
+            if (s == INVALID_SOCKET || !roundTrip(s)) return 1;
+            connect_us.push_back(elapsedUs(start));
+            SocketUtils::closeSocket(s);
+        }
+
+        // Открытое соединение: запрос — ответ из двух записей
+        std::vector<double> rtt_us;
+        SOCKET s = connectTo(address);
+        for (size_t i = 0; s != INVALID_SOCKET && i < round_trips; ++i) {
+            const auto start = Clock::now();
+            if (!roundTrip(s)) break;
+            rtt_us.push_back(elapsedUs(start));
+        }
+        SocketUtils::closeSocket(s);
+        server.join();
+        SocketUtils::closeSocket(listener);
+
+        std::cout << std::left << std::setw(20) << profile.name << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(12) << percentile(connect_us, 0.5) << std::setw(12)
+                  << percentile(connect_us, 0.99) << std::setw(12) << percentile(rtt_us, 0.5) << std::setw(12)
+                  << percentile(rtt_us, 0.99) << "  " << (inherited ? "yes" : "no")
+                  << (applied ? "" : " (option rejected)") << "\n";
+    }
+
+    SocketUtils::cleanup();
+    return 0;
+}
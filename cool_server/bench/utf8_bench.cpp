@@ -0,0 +1,162 @@
+// Проверка UTF-8 вместе со снятием маски: сколько стоит корректность
+// поверх одного только XOR. Перед замером Utf8Validator сверяется с
+// побайтовым эталоном по RFC 3629 на случайных данных, порезанных
+// на куски в случайных местах.
+//
+// Запуск: utf8_bench [мегабайт на замер]
+
+#include "../frame.h"
+#include "../utf8_validator.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using websocket::Frame;
+using websocket::FrameHeader;
+using websocket::Utf8Validator;
+
+// Эталон: прямое чтение таблицы 3 из RFC 3629
+bool referenceValid(const uint8_t* s, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        const uint8_t c = s[i];
+        size_t len;
+        uint8_t lo = 0x80, hi = 0xBF;
+        if (c < 0x80) { ++i; continue; }
+        else if (c >= 0xC2 && c <= 0xDF) len = 2;
+        else if (c == 0xE0) { len = 3; lo = 0xA0; }
+        else if (c >= 0xE1 && c <= 0xEC) len = 3;
+        else if (c == 0xED) { len = 3; hi = 0x9F; }
+        else if (c >= 0xEE && c <= 0xEF) len = 3;
+        else if (c == 0xF0) { len = 4; lo = 0x90; }
+        else if (c >= 0xF1 && c <= 0xF3) len = 4;
+        else if (c == 0xF4) { len = 4; hi = 0x8F; }
+        else return false;
+
+        if (i + len > n) return false;
+        if (s[i + 1] < lo || s[i + 1] > hi) return false;
+        for (size_t k = 2; k < len; ++k) {
+            if (s[i + k] < 0x80 || s[i + k] > 0xBF) return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+bool verify() {
+    std::mt19937 gen(1);
+    // Кирпичики: ASCII, корректные символы разной длины и типичные ошибки
+    const std::vector<std::string> pieces = {
+        "a", "json", "\xD0\xBF", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xED\x9F\xBF", "\xF4\x8F\xBF\xBF",
+        "\xC0\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xE0\x80\xAF", "\x80", "\xFF", "\xC3", "\xE2\x82",
+    };
+    for (int round = 0; round < 200000; ++round) {
+        std::string text;
+        const int count = 1 + static_cast<int>(gen() % 40);
+        for (int k = 0; k < count; ++k) {
+            // Ошибки редки, чтобы хватало и корректных строк
+            const size_t pick = gen() % 100 < 90 ? gen() % 7 : gen() % pieces.size();
+            text += pieces[pick];
+            if (gen() % 4 == 0) text += std::string(gen() % 40, 'x');
+        }
+        const auto* data = reinterpret_cast<const uint8_t*>(text.data());
+        const bool expected = referenceValid(data, text.size());
+
+        // Та же строка, порезанная на куски случайной длины
+        Utf8Validator validator;
+        bool ok = true;
+        for (size_t pos = 0; pos < text.size() && ok;) {
+            const size_t n = std::min<size_t>(1 + gen() % 24, text.size() - pos);
+            ok = validator.feed(data + pos, n);
+            pos += n;
+        }
+        ok = ok && validator.complete();
+
+        if (ok != expected || Utf8Validator::validate(data, text.size()) != expected) {
+            std::cerr << "mismatch on round " << round << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<uint8_t> makeText(size_t size, bool cyrillic) {
+    const std::string ascii = "{\"type\":\"message\",\"user\":\"alice\",\"text\":\"deploy is done, ship it\"},";
+    const std::string mixed = "{\"type\":\"message\",\"text\":\"\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82, "
+                              "\xD0\xBC\xD0\xB8\xD1\x80 \xE2\x82\xAC\"},";
+    const std::string& unit = cyrillic ? mixed : ascii;
+    std::vector<uint8_t> text;
+    while (text.size() + unit.size() <= size) text.insert(text.end(), unit.begin(), unit.end());
+    text.resize(size, ' ');
+    return text;
+}
+
+template <typename Fn>
+double gbPerSecond(std::vector<uint8_t>& buffer, size_t total_bytes, Fn&& fn) {
+    const size_t iterations = std::max<size_t>(3, total_bytes / buffer.size());
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) fn(buffer.data(), buffer.size());
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return static_cast<double>(iterations * buffer.size()) / elapsed.count() / 1e9;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256;
+    const size_t total = megabytes * 1024 * 1024;
+
+    if (!verify()) return 1;
+    std::cout << "verify: ok, mask kernel: " << Frame::maskKernel() << "\n";
+
+    FrameHeader header{};
+    header.masked = true;
+    header.masking_key = 0x37fa213d;
+
+    std::cout << std::setw(10) << "text" << std::setw(10) << "size" << std::setw(14) << "copy+unmask"
+              << std::setw(14) << "+utf8 fused" << std::setw(14) << "+utf8 after" << std::setw(10)
+              << "cost" << "\n";
+    for (bool cyrillic : {false, true}) {
+        for (size_t size : {size_t(256), size_t(4096), size_t(65536), size_t(1) << 20}) {
+            // Каждый прогон начинается с копии замаскированного текста —
+            // как после recv; копия входит во все три замера одинаково
+            std::vector<uint8_t> masked = makeText(size, cyrillic);
+            Frame::applyMask(header.masking_key, masked.data(), masked.size());
+            std::vector<uint8_t> buffer(size);
+            bool valid = true;
+
+            const double unmask = gbPerSecond(buffer, total, [&](uint8_t* data, size_t len) {
+                std::memcpy(data, masked.data(), len);
+                Frame::unmask(header, data, len);
+            });
+            const double fused = gbPerSecond(buffer, total, [&](uint8_t* data, size_t len) {
+                std::memcpy(data, masked.data(), len);
+                Utf8Validator validator;
+                valid &= Frame::unmaskUtf8(header, data, len, validator) && validator.complete();
+            });
+            const double separate = gbPerSecond(buffer, total, [&](uint8_t* data, size_t len) {
+                std::memcpy(data, masked.data(), len);
+                Frame::unmask(header, data, len);
+                valid &= Utf8Validator::validate(data, len);
+            });
+            if (!valid) {
+                std::cerr << "valid text rejected\n";
+                return 1;
+            }
+
+            std::cout << std::setw(10) << (cyrillic ? "cyrillic" : "ascii") << std::setw(10) << size
+                      << std::fixed << std::setprecision(2) << std::setw(14) << unmask
+                      << std::setw(14) << fused << std::setw(14) << separate
+                      << std::setw(9) << 100.0 * (unmask / fused - 1.0) << "%\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Нагрузочный клиент для эхо-обработчика Server::handleClientMessage.
+// Открывает N соединений, в каждом гоняет ping-pong замаскированных
+// текстовых фреймов и печатает пропускную способность и задержки.
+// Каждое соединение сначала проходит HTTP-рукопожатие.
+//
+// Запуск: ws_bench [host] [port] [connections] [messages] [payload]
+
+#include "../platform.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+bool sendAll(SOCKET s, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        int n = send(s, reinterpret_cast<const char*>(data), static_cast<int>(len), 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recvAll(SOCKET s, uint8_t* data, size_t len) {
+    while (len > 0) {
+        int n = recv(s, reinterpret_cast<char*>(data), static_cast<int>(len), 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::vector<uint8_t> maskedTextFrame(const std::string& payload) {
+    std::vector<uint8_t> frame;
+    frame.push_back(0x81);
+    if (payload.size() <= 125) {
+        frame.push_back(0x80 | static_cast<uint8_t>(payload.size()));
+    } else if (payload.size() <= 65535) {
+        frame.push_back(0x80 | 126);
+        frame.push_back(static_cast<uint8_t>(payload.size() >> 8));
+        frame.push_back(static_cast<uint8_t>(payload.size()));
+    } else {
+        frame.push_back(0x80 | 127);
+        for (int i = 7; i >= 0; --i) frame.push_back(static_cast<uint8_t>(payload.size() >> (8 * i)));
+    }
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    frame.insert(frame.end(), mask, mask + 4);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        frame.push_back(static_cast<uint8_t>(payload[i]) ^ mask[i % 4]);
+    }
+    return frame;
+}
+
+// Читает один серверный (немаскированный) фрейм целиком
+bool readFrame(SOCKET s, std::vector<uint8_t>& payload) {
+    uint8_t head[2];
+    if (!recvAll(s, head, 2)) return false;
+    uint64_t len = head[1] & 0x7F;
+    if (len == 126) {
+        uint8_t ext[2];
+        if (!recvAll(s, ext, 2)) return false;
+        len = (ext[0] << 8) | ext[1];
+    } else if (len == 127) {
+        uint8_t ext[8];
+        if (!recvAll(s, ext, 8)) return false;
+        len = 0;
+        for (int i = 0; i < 8; ++i) len = (len << 8) | ext[i];
+    }
+    payload.resize(static_cast<size_t>(len));
+    return len == 0 || recvAll(s, payload.data(), payload.size());
+}
+
+SOCKET connectTo(const std::string& host, int port) {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) return s;
+
+    int yes = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char*>(&yes), sizeof(yes));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<u_short>(port));
+    inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+
+    if (connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+// Запрос на апгрейд и ожидание 101; ключ — пример из RFC 6455
+bool upgrade(SOCKET s, const std::string& host, int port) {
+    const std::string request = "GET /chat HTTP/1.1\r\n"
+                                "Host: " + host + ":" + std::to_string(port) + "\r\n"
+                                "Upgrade: websocket\r\n"
+                                "Connection: Upgrade\r\n"
+                                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                "Sec-WebSocket-Version: 13\r\n\r\n";
+    if (!sendAll(s, reinterpret_cast<const uint8_t*>(request.data()), request.size())) return false;
+
+    // Фреймов до первого сообщения клиента не будет: читаем до конца заголовков
+    std::string response;
+    char chunk[512];
+    while (response.find("\r\n\r\n") == std::string::npos) {
+        int n = recv(s, chunk, sizeof(chunk), 0);
+        if (n <= 0 || response.size() > 8192) return false;
+        response.append(chunk, static_cast<size_t>(n));
+    }
+    return response.compare(0, 12, "HTTP/1.1 101") == 0 &&
+           response.find("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos;
+}
+
+double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t idx = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string host = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? std::atoi(argv[2]) : 8080;
+    int connections = argc > 3 ? std::atoi(argv[3]) : 16;
+    int messages = argc > 4 ? std::atoi(argv[4]) : 10000;
+    size_t payload_size = argc > 5 ? static_cast<size_t>(std::atoi(argv[5])) : 64;
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    const std::string payload(payload_size, 'x');
+    const std::vector<uint8_t> frame = maskedTextFrame(payload);
+
+    std::vector<std::vector<double>> latencies(connections);
+    std::vector<double> handshakes(connections, 0.0);
+    std::atomic<int> failed{0};
+    std::vector<std::thread> threads;
+
+    auto started = Clock::now();
+    for (int c = 0; c < connections; ++c) {
+        threads.emplace_back([&, c]() {
+            auto connected = Clock::now();
+            SOCKET s = connectTo(host, port);
+            if (s == INVALID_SOCKET || !upgrade(s, host, port)) {
+                if (s != INVALID_SOCKET) closesocket(s);
+                ++failed;
+                return;
+            }
+            handshakes[c] = std::chrono::duration<double, std::micro>(Clock::now() - connected).count();
+
+            std::vector<uint8_t> reply;
+            latencies[c].reserve(messages);
+            for (int i = 0; i < messages; ++i) {
+                auto t0 = Clock::now();
+                if (!sendAll(s, frame.data(), frame.size()) || !readFrame(s, reply)) {
+                    ++failed;
+                    break;
+                }
+                auto t1 = Clock::now();
+                latencies[c].push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+            }
+            closesocket(s);
+        });
+    }
+    for (auto& t : threads) t.join();
+    double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+
+    std::vector<double> all;
+    for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    std::sort(handshakes.begin(), handshakes.end());
+
+    std::cout << "connections=" << connections
+              << " payload=" << payload_size
+              << " messages=" << all.size()
+              << " failed=" << failed.load() << "\n"
+              << "throughput=" << static_cast<uint64_t>(all.size() / elapsed) << " msg/s\n"
+              << "latency_us p50=" << percentile(all, 0.50)
+              << " p99=" << percentile(all, 0.99)
+              << " p999=" << percentile(all, 0.999) << "\n"
+              << "connect+handshake_us p50=" << percentile(handshakes, 0.50)
+              << " max=" << (handshakes.empty() ? 0.0 : handshakes.back()) << "\n";
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return 0;
+}
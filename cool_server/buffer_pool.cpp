@@ -0,0 +1,230 @@
+#include "buffer_pool.h"
+#include "numa.h"
+#include <algorithm>
+#include <new>
+
+namespace websocket {
+
+namespace {
+    // Блоки выровнены по строке кэша: SIMD-маскирование и валидатор
+    // UTF-8 читают их целыми векторами
+    constexpr std::align_val_t BLOCK_ALIGNMENT{64};
+
+    uint8_t* allocateBlock(size_t size) {
+        return static_cast<uint8_t*>(::operator new(size, BLOCK_ALIGNMENT));
+    }
+
+    void freeBlock(uint8_t* data) {
+        ::operator delete(data, BLOCK_ALIGNMENT);
+    }
+
+    // Счётчик кэша пишет только его поток: атомарный RMW не нужен
+    void bump(std::atomic<uint64_t>& counter, uint64_t delta = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    uint64_t read(const std::atomic<uint64_t>& counter) {
+        return counter.load(std::memory_order_relaxed);
+    }
+}
+
+struct BufferPool::ThreadCache {
+    uint8_t* blocks[CLASS_COUNT][THREAD_CACHE_BLOCKS];
+    size_t count[CLASS_COUNT] = {};
+    // Рабочие потоки закрепляются до первого буфера: узел не меняется
+    const size_t node = currentNode();
+
+    std::atomic<uint64_t> acquires{0};
+    std::atomic<uint64_t> thread_hits{0};
+    std::atomic<uint64_t> shared_hits{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> oversize{0};
+    // Блок может вернуться из другого потока: занятое — разность сумм
+    std::atomic<uint64_t> acquired_bytes{0};
+    std::atomic<uint64_t> released_bytes{0};
+
+    ThreadCache() { BufferPool::instance().registerCache(this); }
+    ~ThreadCache() {
+        alive = false;
+        BufferPool::instance().retireCache(this);
+    }
+
+    // Деструкторы других thread_local могут вернуть блок уже после
+    // разрушения кэша — тогда идём мимо него
+    static thread_local bool alive;
+};
+
+thread_local bool BufferPool::ThreadCache::alive = true;
+
+BufferPool& BufferPool::instance() {
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+size_t BufferPool::classIndex(size_t size) {
+    size_t index = 0;
+    for (size_t rest = (std::max(size, MIN_CLASS_SIZE) - 1) / MIN_CLASS_SIZE; rest != 0; rest >>= 1) {
+        ++index;
+    }
+    return index;
+}
+
+size_t BufferPool::currentNode() {
+    return static_cast<size_t>(Numa::currentNode()) % MAX_NODES;
+}
+
+size_t BufferPool::cacheLimit(size_t index) {
+    return std::clamp<size_t>(THREAD_CACHE_BYTES / classSize(index), 1, THREAD_CACHE_BLOCKS);
+}
+
+BufferPool::ThreadCache* BufferPool::threadCache() {
+    if (!ThreadCache::alive) return nullptr;
+    thread_local ThreadCache cache;
+    return &cache;
+}
+
+uint8_t* BufferPool::acquire(size_t size, size_t& capacity) {
+    ThreadCache* cache = threadCache();
+    if (size > MAX_CLASS_SIZE) {
+        capacity = size;
+        resident_bytes_.fetch_add(size, std::memory_order_relaxed);
+        record(cache, &ThreadCache::oversize, &Stats::oversize, size);
+        return allocateBlock(size);
+    }
+
+    const size_t index = classIndex(size);
+    capacity = classSize(index);
+    if (cache && cache->count[index] > 0) {
+        record(cache, &ThreadCache::thread_hits, &Stats::thread_hits, capacity);
+        return cache->blocks[index][--cache->count[index]];
+    }
+
+    // Кэш пуст: пачка из общего списка, а нет и там — у системы
+    if (cache && refill(*cache, index) > 0) {
+        record(cache, &ThreadCache::shared_hits, &Stats::shared_hits, capacity);
+        return cache->blocks[index][--cache->count[index]];
+    }
+    if (!cache) {
+        SharedClass& shared = classes_[currentNode()][index];
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        if (!shared.blocks.empty()) {
+            uint8_t* data = shared.blocks.back();
+            shared.blocks.pop_back();
+            shared_free_bytes_.fetch_sub(capacity, std::memory_order_relaxed);
+            record(nullptr, &ThreadCache::shared_hits, &Stats::shared_hits, capacity);
+            return data;
+        }
+    }
+    resident_bytes_.fetch_add(capacity, std::memory_order_relaxed);
+    record(cache, &ThreadCache::allocations, &Stats::allocations, capacity);
+    return allocateBlock(capacity);
+}
+
+void BufferPool::release(uint8_t* data, size_t capacity) {
+    ThreadCache* cache = threadCache();
+    if (cache) {
+        bump(cache->released_bytes, capacity);
+    } else {
+        std::lock_guard<std::mutex> lock(caches_mutex_);
+        retired_.in_use_bytes -= capacity;
+    }
+
+    if (capacity > MAX_CLASS_SIZE) {
+        resident_bytes_.fetch_sub(capacity, std::memory_order_relaxed);
+        freeBlock(data);
+        return;
+    }
+
+    const size_t index = classIndex(capacity);
+    if (!cache) {
+        pushShared(currentNode(), index, &data, 1);
+        return;
+    }
+    if (cache->count[index] == cacheLimit(index)) {
+        // Половину кэша — в общий список одним захватом мьютекса
+        const size_t keep = cache->count[index] / 2;
+        pushShared(cache->node, index, cache->blocks[index] + keep, cache->count[index] - keep);
+        cache->count[index] = keep;
+    }
+    cache->blocks[index][cache->count[index]++] = data;
+}
+
+void BufferPool::record(ThreadCache* cache, std::atomic<uint64_t> ThreadCache::*event,
+                        uint64_t Stats::*retired, size_t bytes) {
+    if (cache) {
+        bump(cache->acquires);
+        bump(cache->*event);
+        bump(cache->acquired_bytes, bytes);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(caches_mutex_);
+    ++retired_.acquires;
+    ++(retired_.*retired);
+    retired_.in_use_bytes += bytes;
+}
+
+size_t BufferPool::refill(ThreadCache& cache, size_t index) {
+    SharedClass& shared = classes_[cache.node][index];
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    const size_t take = std::min(shared.blocks.size(), std::max<size_t>(cacheLimit(index) / 2, 1));
+    for (size_t i = 0; i < take; ++i) {
+        cache.blocks[index][cache.count[index]++] = shared.blocks.back();
+        shared.blocks.pop_back();
+    }
+    shared_free_bytes_.fetch_sub(take * classSize(index), std::memory_order_relaxed);
+    return take;
+}
+
+void BufferPool::pushShared(size_t node, size_t index, uint8_t* const* blocks, size_t count) {
+    const size_t size = classSize(index);
+    SharedClass& shared = classes_[node][index];
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    for (size_t i = 0; i < count; ++i) {
+        // Свободного и так много — отдаём системе
+        if (shared_free_bytes_.load(std::memory_order_relaxed) + size > MAX_SHARED_FREE_BYTES) {
+            resident_bytes_.fetch_sub(size, std::memory_order_relaxed);
+            freeBlock(blocks[i]);
+            continue;
+        }
+        shared.blocks.push_back(blocks[i]);
+        shared_free_bytes_.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+void BufferPool::registerCache(ThreadCache* cache) {
+    std::lock_guard<std::mutex> lock(caches_mutex_);
+    caches_.push_back(cache);
+}
+
+void BufferPool::retireCache(ThreadCache* cache) {
+    for (size_t index = 0; index < CLASS_COUNT; ++index) {
+        pushShared(cache->node, index, cache->blocks[index], cache->count[index]);
+        cache->count[index] = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(caches_mutex_);
+    retired_.acquires += read(cache->acquires);
+    retired_.thread_hits += read(cache->thread_hits);
+    retired_.shared_hits += read(cache->shared_hits);
+    retired_.allocations += read(cache->allocations);
+    retired_.oversize += read(cache->oversize);
+    retired_.in_use_bytes += read(cache->acquired_bytes) - read(cache->released_bytes);
+    caches_.erase(std::remove(caches_.begin(), caches_.end(), cache), caches_.end());
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(caches_mutex_);
+    Stats total = retired_;
+    for (const ThreadCache* cache : caches_) {
+        total.acquires += read(cache->acquires);
+        total.thread_hits += read(cache->thread_hits);
+        total.shared_hits += read(cache->shared_hits);
+        total.allocations += read(cache->allocations);
+        total.oversize += read(cache->oversize);
+        total.in_use_bytes += read(cache->acquired_bytes) - read(cache->released_bytes);
+    }
+    total.resident_bytes = resident_bytes_.load(std::memory_order_relaxed);
+    return total;
+}
+
+} // namespace websocket
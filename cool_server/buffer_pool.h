@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace websocket {
+
+// Общий пул буферов чтения и записи с классами размеров — степенями двойки
+// от 256B до 4MB. У каждого потока свой небольшой кэш блоков на класс:
+// выдача и возврат в обычном случае идут без блокировок. Излишки кэша
+// уходят в общий список класса пачкой под мьютексом, общий список сверх
+// MAX_SHARED_FREE_BYTES отдаёт память системе. Общие списки свои у
+// каждого узла NUMA: блок, освобождённый потоком одного узла, не уйдёт
+// потоку другого. Новые блоки выделяет и первым касается поток, который
+// их берёт, — страницы ложатся на его узел. Блоки крупнее 4MB
+// выделяются и освобождаются напрямую.
+class BufferPool {
+public:
+    static constexpr size_t MIN_CLASS_SIZE = 256;
+    static constexpr size_t MAX_CLASS_SIZE = 4 * 1024 * 1024;
+    static constexpr size_t CLASS_COUNT = 15;
+    // Сколько блоков класса держит кэш потока, но не больше THREAD_CACHE_BYTES
+    static constexpr size_t THREAD_CACHE_BLOCKS = 32;
+    static constexpr size_t THREAD_CACHE_BYTES = 512 * 1024;
+    static constexpr size_t MAX_SHARED_FREE_BYTES = 64 * 1024 * 1024;
+    // Узлы с большими номерами делят списки по модулю
+    static constexpr size_t MAX_NODES = 8;
+
+    struct Stats {
+        uint64_t acquires = 0;
+        uint64_t thread_hits = 0;     // Из кэша потока
+        uint64_t shared_hits = 0;     // Из общего списка класса
+        uint64_t allocations = 0;     // Новый блок у системы
+        uint64_t oversize = 0;        // Крупнее MAX_CLASS_SIZE, мимо пула
+        size_t resident_bytes = 0;    // Выделено пулом и не отдано системе
+        size_t in_use_bytes = 0;      // Из них выдано сейчас
+
+        double hitRate() const {
+            return acquires ? static_cast<double>(thread_hits + shared_hits) / acquires : 0.0;
+        }
+    };
+
+    // Пул процесса; не разрушается, чтобы кэши потоков могли вернуть
+    // блоки в любом порядке завершения
+    static BufferPool& instance();
+
+    // Блок не меньше size байт; в capacity — его настоящий размер
+    uint8_t* acquire(size_t size, size_t& capacity);
+    void release(uint8_t* data, size_t capacity);
+
+    Stats stats() const;
+
+private:
+    struct ThreadCache;
+    struct SharedClass {
+        std::mutex mutex;
+        std::vector<uint8_t*> blocks;
+    };
+
+    BufferPool() = default;
+
+    static size_t classIndex(size_t size);
+    static size_t classSize(size_t index) { return MIN_CLASS_SIZE << index; }
+    static size_t cacheLimit(size_t index);
+    // Общие списки узла, на котором выполняется поток
+    static size_t currentNode();
+    // nullptr — кэш потока уже разрушен (поток завершается)
+    static ThreadCache* threadCache();
+
+    // Учёт выдачи: в кэше потока или, без него, в общих итогах
+    void record(ThreadCache* cache, std::atomic<uint64_t> ThreadCache::*event,
+                uint64_t Stats::*retired, size_t bytes);
+    // Пачка блоков из общего списка узла кэша в кэш потока; 0 — список пуст
+    size_t refill(ThreadCache& cache, size_t index);
+    // Блоки в общий список узла; сверх MAX_SHARED_FREE_BYTES — системе
+    void pushShared(size_t node, size_t index, uint8_t* const* blocks, size_t count);
+    void registerCache(ThreadCache* cache);
+    // Поток завершается: блоки — в общие списки, счётчики — в итоги
+    void retireCache(ThreadCache* cache);
+
+    SharedClass classes_[MAX_NODES][CLASS_COUNT];
+    std::atomic<size_t> shared_free_bytes_{0};
+    std::atomic<size_t> resident_bytes_{0};
+
+    // Счётчики живых потоков читаются из их кэшей, завершившихся — копятся здесь
+    mutable std::mutex caches_mutex_;
+    std::vector<ThreadCache*> caches_;
+    Stats retired_;
+};
+
+// Блок пула во владении: возвращается в пул в деструкторе.
+// size — сколько байт занято, capacity — размер блока
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    explicit PooledBuffer(size_t capacity) {
+        data_ = BufferPool::instance().acquire(capacity, capacity_);
+    }
+    ~PooledBuffer() { reset(); }
+
+    PooledBuffer(PooledBuffer&& other) noexcept
+        : data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+        other.data_ = nullptr;
+        other.size_ = other.capacity_ = 0;
+    }
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept {
+        if (this != &other) {
+            reset();
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.data_ = nullptr;
+            other.size_ = other.capacity_ = 0;
+        }
+        return *this;
+    }
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+    // Отмечает занятые байты; блок не растёт
+    void resize(size_t size) { size_ = size < capacity_ ? size : capacity_; }
+    // Возвращает блок в пул
+    void reset() {
+        if (data_) BufferPool::instance().release(data_, capacity_);
+        data_ = nullptr;
+        size_ = capacity_ = 0;
+    }
+
+private:
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
+
+} // namespace websocket
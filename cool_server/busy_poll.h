@@ -0,0 +1,98 @@
+#pragma once
+
+#include "platform.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Опрос очереди завершений без сна для низких задержек. Прежде чем
+// уснуть в ядре, рабочий поток до spin_us микросекунд опрашивает очередь
+// без блокировки: событие, пришедшее за это время, забирается без
+// пробуждения потока. Платится процессорным временем — поток крутится,
+// даже когда событий нет.
+struct BusyPollConfig {
+    // Бюджет опроса перед сном; 0 — выключено, поток сразу спит в ядре
+    int spin_us = 0;
+    // Бюджет ужимается вдвое после каждого опроса впустую (не ниже
+    // spin_us / 16) и восстанавливается, как только опрос что-то нашёл:
+    // при редком трафике поток почти не крутится зря
+    bool adaptive = true;
+};
+
+struct BusyPollStats {
+    std::atomic<uint64_t> spins{0};     // Раундов опроса
+    std::atomic<uint64_t> hits{0};      // Из них нашли событие
+    std::atomic<uint64_t> spin_ns{0};   // Времени в опросе
+    std::atomic<uint64_t> parks{0};     // Блокирующих ожиданий в ядре
+
+    double hitRate() const {
+        const uint64_t total = spins.load(std::memory_order_relaxed);
+        return total ? static_cast<double>(hits.load(std::memory_order_relaxed)) / total : 0.0;
+    }
+};
+
+// Бюджет опроса одного рабочего потока
+class BusyPoller {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BusyPoller(const BusyPollConfig& config, BusyPollStats& stats)
+        : max_(std::chrono::microseconds(std::max(config.spin_us, 0))),
+          min_(config.adaptive ? std::max<Clock::duration>(max_ / 16, std::chrono::microseconds(1)) : max_),
+          budget_(max_),
+          stats_(stats) {}
+
+    bool enabled() const { return max_.count() > 0; }
+
+    // Вызывает poll (неблокирующий опрос, возвращает число событий),
+    // пока он ничего не нашёл, но не дольше бюджета и не дольше
+    // timeout_ms до ближайшего таймера (-1 — таймеров нет).
+    // Возвращает последний результат poll: 0 — пора спать в ядре
+    template <typename Poll>
+    int spin(Poll poll, int timeout_ms) {
+        if (!enabled() || timeout_ms == 0) return 0;
+
+        const auto started = Clock::now();
+        auto deadline = started + budget_;
+        if (timeout_ms > 0) deadline = std::min(deadline, started + std::chrono::milliseconds(timeout_ms));
+        int found = 0;
+        auto now = started;
+        while ((found = poll()) == 0 && (now = Clock::now()) < deadline) {
+            pause();
+        }
+        if (found) now = Clock::now();
+
+        stats_.spins.fetch_add(1, std::memory_order_relaxed);
+        stats_.spin_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(now - started).count(),
+                                 std::memory_order_relaxed);
+        if (found) {
+            stats_.hits.fetch_add(1, std::memory_order_relaxed);
+            budget_ = max_;
+        } else {
+            budget_ = std::max(budget_ / 2, min_);
+        }
+        return found;
+    }
+
+    // Поток уходит в блокирующее ожидание
+    void park() { stats_.parks.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    // Подсказка процессору: крутимся в ожидании, соседнему
+    // гиперпотоку можно отдать ресурсы ядра
+    static void pause() {
+#ifdef _WIN32
+        YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    const Clock::duration max_;
+    const Clock::duration min_;
+    Clock::duration budget_;
+    BusyPollStats& stats_;
+};
@@ -0,0 +1,120 @@
+#include "connection_pool.h"
+#include <new>
+
+namespace websocket {
+
+ConnectionPool::ConnectionPool(IOCPCore& iocp)
+    : iocp_(iocp) {}
+
+ConnectionPool::~ConnectionPool() {
+    // Разрушаем только свободные объекты. Выданные к этому моменту
+    // удерживаются операциями остановленного ядра и больше не тронуты
+    for (WebSocketConnection* connection : free_) {
+        connection->~WebSocketConnection();
+    }
+}
+
+void ConnectionPool::reserve(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (free_.size() < count) {
+        addSlabLocked();
+    }
+}
+
+std::shared_ptr<WebSocketConnection> ConnectionPool::acquire(SOCKET socket) {
+    WebSocketConnection* connection;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) addSlabLocked();
+        connection = free_.back();
+        free_.pop_back();
+        ++stats_.in_use;
+        ++stats_.acquired;
+    }
+
+    connection->attach(socket);
+    // Управляющий блок выделяется вне мьютекса: allocateBlock берёт его сам
+    return std::shared_ptr<WebSocketConnection>(
+        connection, Recycler{this}, BlockAllocator<WebSocketConnection>(this));
+}
+
+ConnectionPool::Stats ConnectionPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+Numa::PagePlacement ConnectionPool::placement() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Numa::PagePlacement placement;
+    for (const auto& slab : slabs_) {
+        Numa::pagePlacement(slab.get(), slab.get_deleter().size, node_, placement);
+    }
+    for (const auto& chunk : block_chunks_) {
+        Numa::pagePlacement(chunk.get(), chunk.get_deleter().size, node_, placement);
+    }
+    return placement;
+}
+
+void ConnectionPool::addSlabLocked() {
+    const size_t bytes = sizeof(Storage) * SLAB_SIZE;
+    std::unique_ptr<Storage[], NodeMemory> slab(static_cast<Storage*>(Numa::allocate(bytes, node_)),
+                                                NodeMemory{bytes});
+    if (!slab) throw std::bad_alloc();
+    free_.reserve(stats_.objects + SLAB_SIZE);
+    for (size_t i = 0; i < SLAB_SIZE; ++i) {
+        free_.push_back(new (&slab[i]) WebSocketConnection(INVALID_SOCKET, iocp_));
+    }
+    slabs_.push_back(std::move(slab));
+    stats_.objects += SLAB_SIZE;
+    ++stats_.slabs;
+}
+
+void ConnectionPool::release(WebSocketConnection* connection) {
+    connection->recycle();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Ёмкости хватает всегда: free_ зарезервирован под все объекты
+    free_.push_back(connection);
+    --stats_.in_use;
+    ++stats_.released;
+}
+
+void* ConnectionPool::allocateBlock(size_t size) {
+    if (size > BLOCK_SIZE) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.heap_blocks;
+        return ::operator new(size);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_blocks_ == nullptr) {
+        const size_t bytes = sizeof(Block) * BLOCKS_PER_CHUNK;
+        std::unique_ptr<Block[], NodeMemory> chunk(static_cast<Block*>(Numa::allocate(bytes, node_)),
+                                                   NodeMemory{bytes});
+        if (!chunk) throw std::bad_alloc();
+        for (size_t i = 0; i < BLOCKS_PER_CHUNK; ++i) {
+            chunk[i].next = free_blocks_;
+            free_blocks_ = &chunk[i];
+        }
+        block_chunks_.push_back(std::move(chunk));
+        ++stats_.block_chunks;
+    }
+
+    Block* block = free_blocks_;
+    free_blocks_ = block->next;
+    return block;
+}
+
+void ConnectionPool::deallocateBlock(void* block, size_t size) {
+    if (size > BLOCK_SIZE) {
+        ::operator delete(block);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Block* freed = static_cast<Block*>(block);
+    freed->next = free_blocks_;
+    free_blocks_ = freed;
+}
+
+} // namespace websocket
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "numa.h"
+#include "websocket_connection.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace websocket {
+
+// Пул соединений одного цикла событий.
+// Объекты живут в слэбах и при отключении клиента не разрушаются:
+// когда уходит последняя ссылка, соединение сбрасывается (буферы
+// сохраняют ёмкость) и возвращается в список свободных.
+// Управляющие блоки shared_ptr тоже берутся из пула, так что
+// подключение и отключение не трогают общий аллокатор.
+class ConnectionPool {
+public:
+    struct Stats {
+        size_t slabs = 0;          // Выделено слэбов соединений
+        size_t objects = 0;        // Создано объектов соединений
+        size_t in_use = 0;         // Выдано и ещё не вернулось
+        size_t acquired = 0;       // Всего выдач
+        size_t released = 0;       // Всего возвратов
+        size_t block_chunks = 0;   // Выделено пачек управляющих блоков
+        size_t heap_blocks = 0;    // Управляющих блоков, не влезших в пул
+    };
+
+    explicit ConnectionPool(IOCPCore& iocp);
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // Слэбы и пачки управляющих блоков — из памяти узла node
+    // (-1 — где придётся). Задаётся до первого reserve или acquire
+    void bindToNode(int node) { node_ = node; }
+    int node() const { return node_; }
+
+    // Создаёт объекты заранее, чтобы первые подключения не ходили в аллокатор
+    void reserve(size_t count);
+
+    // Выдаёт соединение с привязанным сокетом; start() вызывает владелец
+    std::shared_ptr<WebSocketConnection> acquire(SOCKET socket);
+
+    Stats stats() const;
+    // На каких узлах лежат страницы слэбов и пачек блоков
+    Numa::PagePlacement placement() const;
+
+private:
+    static constexpr size_t SLAB_SIZE = 64;          // Соединений в слэбе
+    static constexpr size_t BLOCK_SIZE = 64;         // Байт на управляющий блок
+    static constexpr size_t BLOCKS_PER_CHUNK = 256;
+
+    using Storage = std::aligned_storage_t<sizeof(WebSocketConnection), alignof(WebSocketConnection)>;
+
+    union Block {
+        Block* next;
+        alignas(std::max_align_t) unsigned char data[BLOCK_SIZE];
+    };
+
+    // Страницы от Numa::allocate возвращаются туда же
+    struct NodeMemory {
+        size_t size;
+        void operator()(void* memory) const { Numa::release(memory, size); }
+    };
+
+    // Аллокатор управляющих блоков shared_ptr
+    template <typename T>
+    struct BlockAllocator {
+        using value_type = T;
+
+        explicit BlockAllocator(ConnectionPool* pool) : pool(pool) {}
+        template <typename U>
+        BlockAllocator(const BlockAllocator<U>& other) : pool(other.pool) {}
+
+        T* allocate(size_t n) { return static_cast<T*>(pool->allocateBlock(n * sizeof(T))); }
+        void deallocate(T* p, size_t n) { pool->deallocateBlock(p, n * sizeof(T)); }
+
+        template <typename U>
+        bool operator==(const BlockAllocator<U>& other) const { return pool == other.pool; }
+        template <typename U>
+        bool operator!=(const BlockAllocator<U>& other) const { return pool != other.pool; }
+
+        ConnectionPool* pool;
+    };
+
+    // Делитер: вместо delete возвращает соединение в пул
+    struct Recycler {
+        void operator()(WebSocketConnection* connection) const { pool->release(connection); }
+
+        ConnectionPool* pool;
+    };
+
+    void addSlabLocked();
+    void release(WebSocketConnection* connection);
+    void* allocateBlock(size_t size);
+    void deallocateBlock(void* block, size_t size);
+
+    IOCPCore& iocp_;
+    int node_ = -1;
+    mutable std::mutex mutex_;  // Вернуть соединение может любой поток цикла
+    std::vector<std::unique_ptr<Storage[], NodeMemory>> slabs_;
+    std::vector<WebSocketConnection*> free_;
+    std::vector<std::unique_ptr<Block[], NodeMemory>> block_chunks_;
+    Block* free_blocks_ = nullptr;
+    Stats stats_;
+};
+
+} // namespace websocket
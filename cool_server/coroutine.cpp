@@ -0,0 +1,51 @@
+#include "coroutine.h"
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+namespace websocket {
+
+Task::promise_type::promise_type() noexcept {
+    // С кольца живых кадр снимает арена, когда его освобождают
+    CoroutineArena::adopt(std::coroutine_handle<promise_type>::from_promise(*this));
+}
+
+void Task::promise_type::unhandled_exception() noexcept {
+    try {
+        throw;
+    } catch (const std::exception& e) {
+        std::cerr << "Coroutine failed: " << e.what() << "\n";
+    } catch (...) {
+        std::cerr << "Coroutine failed: unknown exception\n";
+    }
+}
+
+SleepAwaiter::SleepAwaiter(std::chrono::milliseconds delay)
+    : loop_(IOCPCore::current()), delay_(delay) {}
+
+SleepAwaiter::~SleepAwaiter() {
+    // Корутину уничтожили во сне (остановка цикла) — таймер больше не нужен
+    if (armed_.load(std::memory_order_acquire)) loop_->cancelTimer(&timer_);
+}
+
+bool SleepAwaiter::await_ready() {
+    if (!loop_) throw std::logic_error("sleep() outside of an event loop thread");
+    return delay_.count() <= 0;
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    timer_.handler = this;
+    timer_.owner = loop_->coroutineArena().token();
+    armed_.store(true, std::memory_order_relaxed);
+    // Таймер может сработать в другом потоке цикла раньше, чем мы отсюда
+    // выйдем: после setTimer полей не трогаем
+    loop_->setTimer(&timer_, delay_);
+}
+
+void SleepAwaiter::onCompletion(DWORD, LPOVERLAPPED, DWORD) {
+    armed_.store(false, std::memory_order_release);
+    handle_.resume();
+}
+
+} // namespace websocket
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "iocp_core.h"
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+
+namespace websocket {
+
+// Корутина-обработчик, запускаемая и забываемая: выполняется сразу до
+// первого co_await, кадр освобождается по завершении. Кадр берётся из
+// арены цикла, в потоке которого корутина создана. Исключение, вылетевшее
+// из тела, пишется в лог и завершает корутину.
+//
+//     Task echo(std::shared_ptr<WebSocketConnection> connection) {
+//         while (auto message = co_await connection->read()) {
+//             if (!co_await connection->write(*message)) break;
+//         }
+//     }
+class Task {
+public:
+    struct promise_type {
+        promise_type() noexcept;
+
+        Task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept;
+
+        static void* operator new(size_t size) { return CoroutineArena::allocate(size); }
+        static void operator delete(void* frame) noexcept { CoroutineArena::deallocate(frame); }
+    };
+};
+
+// Пауза на таймере цикла текущего потока. Продолжается в рабочем потоке
+// того же цикла. Вне потоков цикла ждать не на чем, а усыплять чужой
+// поток нельзя: co_await бросает std::logic_error
+class SleepAwaiter : public CompletionHandler {
+public:
+    explicit SleepAwaiter(std::chrono::milliseconds delay);
+    ~SleepAwaiter() override;
+
+    SleepAwaiter(const SleepAwaiter&) = delete;
+    SleepAwaiter& operator=(const SleepAwaiter&) = delete;
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const noexcept {}
+
+    void onCompletion(DWORD bytes, LPOVERLAPPED overlapped, DWORD error) override;
+
+private:
+    IOCPCore* loop_;
+    std::chrono::milliseconds delay_;
+    IOCPCore::Timer timer_;
+    std::coroutine_handle<> handle_;
+    // Снимает onCompletion в потоке таймера, читает деструктор
+    std::atomic<bool> armed_{false};
+};
+
+inline SleepAwaiter sleep(std::chrono::milliseconds delay) {
+    return SleepAwaiter(delay);
+}
+
+} // namespace websocket
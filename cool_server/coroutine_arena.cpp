@@ -0,0 +1,239 @@
+#include "coroutine_arena.h"
+#include "iocp_core.h"
+#include <new>
+
+// Перед кадром — чья это память и узел кольца живых корутин. Размер
+// сохраняет выравнивание кадра, которое гарантирует operator new
+struct CoroutineArena::Header {
+    Node node;                      // Первым полем: по узлу находим заголовок
+    Header* link = nullptr;         // Список свободных, стек чужих освобождений или ждущих adopt
+    ThreadCache* cache = nullptr;   // Владелец; nullptr — кадр из кучи вне цикла
+    size_t index = 0;               // Класс; CLASS_COUNT — кадр из кучи
+    std::coroutine_handle<> handle;
+};
+
+// Всё, кроме remote, трогает только поток-владелец, а после остановки
+// цикла — destroyAll
+struct CoroutineArena::ThreadCache {
+    CoroutineArena* arena = nullptr;
+    Header* free[CLASS_COUNT] = {};
+    uint8_t* chunk_pos = nullptr;
+    size_t chunk_left = 0;
+    Node live;                                 // Кольцо живых корутин потока
+    std::atomic<Header*> remote{nullptr};      // Освобождённые чужими потоками
+
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> heap_frames{0};
+    std::atomic<size_t> live_count{0};
+};
+
+thread_local CoroutineArena::ThreadCache* CoroutineArena::thread_cache_ = nullptr;
+thread_local CoroutineArena::Header* CoroutineArena::adopting_ = nullptr;
+
+namespace {
+    constexpr size_t HEADER_SIZE = 48;
+
+    // Счётчик кэша пишет только его поток: атомарный RMW не нужен
+    template <typename T>
+    void bump(std::atomic<T>& counter, T delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+}
+
+CoroutineArena::CoroutineArena() : token_(std::make_shared<char>()) {
+    static_assert(sizeof(Header) <= HEADER_SIZE && HEADER_SIZE % alignof(std::max_align_t) == 0,
+                  "frame header must keep new-alignment");
+}
+
+CoroutineArena::~CoroutineArena() {
+    // Кадры живут в кусках арены: уничтожаем корутины, пока куски целы
+    destroyAll();
+}
+
+CoroutineArena* CoroutineArena::current() {
+    IOCPCore* loop = IOCPCore::current();
+    return loop ? &loop->coroutineArena() : nullptr;
+}
+
+size_t CoroutineArena::classIndex(size_t size) {
+    size_t index = 0;
+    while (classSize(index) < size) ++index;
+    return index;
+}
+
+CoroutineArena::ThreadCache* CoroutineArena::registerThread() {
+    // Поток цикла не переходит в другой цикл, так что кэш привязывается
+    // к потоку один раз. Живёт он в арене: его кадры переживают поток
+    std::lock_guard<std::mutex> lock(mutex_);
+    caches_.push_back(std::make_unique<ThreadCache>());
+    caches_.back()->arena = this;
+    caches_.back()->live.prev = caches_.back()->live.next = &caches_.back()->live;
+    return caches_.back().get();
+}
+
+void* CoroutineArena::allocate(size_t size) {
+    const size_t total = size + HEADER_SIZE;
+    ThreadCache* cache = thread_cache_;
+    if (!cache) {
+        CoroutineArena* arena = current();
+        if (!arena) {
+            Header* header = new (::operator new(total)) Header;
+            return reinterpret_cast<uint8_t*>(header) + HEADER_SIZE;
+        }
+        cache = thread_cache_ = arena->registerThread();
+    }
+    if (cache->remote.load(std::memory_order_relaxed)) drainRemote(*cache);
+
+    Header* header;
+    size_t index = CLASS_COUNT;
+    if (total <= MAX_CLASS_SIZE) {
+        index = classIndex(total);
+        header = cache->arena->take(*cache, index);
+        bump<uint64_t>(cache->frames, 1);
+    } else {
+        header = new (::operator new(total)) Header;
+        bump<uint64_t>(cache->heap_frames, 1);
+    }
+    header->cache = cache;
+    header->index = index;
+    header->handle = {};
+
+    Node& live = cache->live;
+    header->node.prev = &live;
+    header->node.next = live.next;
+    live.next->prev = &header->node;
+    live.next = &header->node;
+    bump<size_t>(cache->live_count, 1);
+
+    // Между выделением и promise копируются параметры, и это может
+    // создать другую корутину: ждущие adopt образуют стек
+    header->link = adopting_;
+    adopting_ = header;
+    return reinterpret_cast<uint8_t*>(header) + HEADER_SIZE;
+}
+
+void CoroutineArena::adopt(std::coroutine_handle<> handle) noexcept {
+    Header* header = adopting_;
+    if (!header) return;  // Кадр вне цикла: не учитывается
+    adopting_ = header->link;
+    header->link = nullptr;
+    header->handle = handle;
+}
+
+void CoroutineArena::deallocate(void* frame) noexcept {
+    Header* header = reinterpret_cast<Header*>(static_cast<uint8_t*>(frame) - HEADER_SIZE);
+    ThreadCache* owner = header->cache;
+    if (!owner) {
+        ::operator delete(header);
+        return;
+    }
+    // Исключение при копировании параметров: promise так и не появился
+    if (header == adopting_) adopting_ = header->link;
+
+    if (owner == thread_cache_) {
+        release(*owner, header);
+        return;
+    }
+    Header* head = owner->remote.load(std::memory_order_relaxed);
+    do {
+        header->link = head;
+    } while (!owner->remote.compare_exchange_weak(head, header, std::memory_order_release,
+                                                  std::memory_order_relaxed));
+}
+
+void CoroutineArena::release(ThreadCache& cache, Header* header) {
+    header->node.prev->next = header->node.next;
+    header->node.next->prev = header->node.prev;
+    header->node.prev = header->node.next = nullptr;
+    bump<size_t>(cache.live_count, static_cast<size_t>(-1));
+
+    if (header->index == CLASS_COUNT) {
+        ::operator delete(header);
+        return;
+    }
+    header->link = cache.free[header->index];
+    cache.free[header->index] = header;
+}
+
+void CoroutineArena::drainRemote(ThreadCache& cache) {
+    Header* header = cache.remote.exchange(nullptr, std::memory_order_acquire);
+    while (header) {
+        Header* next = header->link;
+        release(cache, header);
+        header = next;
+    }
+}
+
+CoroutineArena::Header* CoroutineArena::take(ThreadCache& cache, size_t index) {
+    if (Header* header = cache.free[index]) {
+        cache.free[index] = header->link;
+        return header;
+    }
+
+    // Свободных нет — отрезаем от куска потока; остаток старого куска
+    // уходит в списки свободных, чтобы не пропадать
+    const size_t size = classSize(index);
+    if (cache.chunk_left < size) {
+        for (size_t i = CLASS_COUNT; i-- > 0;) {
+            while (cache.chunk_left >= classSize(i)) {
+                Header* header = new (cache.chunk_pos) Header;
+                header->link = cache.free[i];
+                cache.free[i] = header;
+                cache.chunk_pos += classSize(i);
+                cache.chunk_left -= classSize(i);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunks_.push_back(std::make_unique<uint8_t[]>(CHUNK_SIZE));
+        cache.chunk_pos = chunks_.back().get();
+        cache.chunk_left = CHUNK_SIZE;
+        reserved_bytes_ += CHUNK_SIZE;
+    }
+    Header* header = new (cache.chunk_pos) Header;
+    cache.chunk_pos += size;
+    cache.chunk_left -= size;
+    return header;
+}
+
+size_t CoroutineArena::destroyAll() {
+    std::vector<ThreadCache*> caches;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& cache : caches_) caches.push_back(cache.get());
+    }
+
+    // Потоки цикла стоят: их кэши можно разбирать отсюда. Кадр
+    // уничтоженной корутины приходит через стек чужих освобождений
+    size_t destroyed = 0;
+    for (ThreadCache* cache : caches) {
+        drainRemote(*cache);
+        while (cache->live.next != &cache->live) {
+            Header* header = reinterpret_cast<Header*>(cache->live.next);
+            if (header->handle) {
+                header->handle.destroy();
+                ++destroyed;
+            } else {
+                // Корутина так и не построена — остался только блок
+                release(*cache, header);
+            }
+            drainRemote(*cache);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    destroyed_ += destroyed;
+    return destroyed;
+}
+
+CoroutineArena::Stats CoroutineArena::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats total;
+    for (const auto& cache : caches_) {
+        total.frames += cache->frames.load(std::memory_order_relaxed);
+        total.heap_frames += cache->heap_frames.load(std::memory_order_relaxed);
+        total.live += cache->live_count.load(std::memory_order_relaxed);
+    }
+    total.destroyed = destroyed_;
+    total.reserved_bytes = reserved_bytes_;
+    return total;
+}
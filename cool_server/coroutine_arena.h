@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Арена кадров корутин одного цикла событий. У каждого потока цикла свой
+// кэш: списки свободных блоков по классам (степени двойки от 128B до 4KB)
+// и свой кусок по 64KB, из которого они нарезаются, — кадр берётся и
+// возвращается без блокировок. Кадр, освобождённый чужим потоком, уходит
+// владельцу через lock-free стек и разбирается пачкой при его следующем
+// выделении. Куски системе возвращаются только вместе с ареной. Кадры
+// крупнее 4KB берутся из кучи, корутины, созданные вне потоков цикла, —
+// из кучи без учёта. Живые корутины арена помнит: при остановке цикла
+// она уничтожает те, что так и не дождались продолжения.
+class CoroutineArena {
+public:
+    static constexpr size_t MIN_CLASS_SIZE = 128;
+    static constexpr size_t MAX_CLASS_SIZE = 4096;
+    static constexpr size_t CLASS_COUNT = 6;
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    struct Stats {
+        uint64_t frames = 0;         // Кадров из арены
+        uint64_t heap_frames = 0;    // Кадров крупнее MAX_CLASS_SIZE, из кучи
+        uint64_t destroyed = 0;      // Корутин, уничтоженных destroyAll
+        size_t live = 0;             // Живых корутин сейчас
+        size_t reserved_bytes = 0;   // Нарезано кусков
+    };
+
+    CoroutineArena();
+    ~CoroutineArena();
+
+    CoroutineArena(const CoroutineArena&) = delete;
+    CoroutineArena& operator=(const CoroutineArena&) = delete;
+
+    // Арена цикла, которому принадлежит текущий поток; nullptr — поток не из цикла
+    static CoroutineArena* current();
+    // Кадр из кэша текущего потока цикла, вне цикла — из кучи. Освобождать можно из любого потока
+    static void* allocate(size_t size);
+    static void deallocate(void* frame) noexcept;
+    // Зовётся из конструктора promise: связывает только что выделенный
+    // кадр с его корутиной, чтобы destroyAll могла её уничтожить
+    static void adopt(std::coroutine_handle<> handle) noexcept;
+
+    // Уничтожает оставшиеся корутины; зовётся, когда потоки цикла уже остановлены
+    size_t destroyAll();
+
+    // Жив, пока жива арена: владелец таймеров, на которых спят корутины
+    const std::shared_ptr<void>& token() const { return token_; }
+
+    // Счётчики потоков читаются без остановки: сумма может отставать
+    Stats stats() const;
+
+private:
+    struct Node {
+        Node* prev = nullptr;
+        Node* next = nullptr;
+    };
+    struct Header;
+    struct ThreadCache;
+
+    static size_t classIndex(size_t size);
+    static size_t classSize(size_t index) { return MIN_CLASS_SIZE << index; }
+
+    ThreadCache* registerThread();
+    Header* take(ThreadCache& cache, size_t index);
+    // В потоке-владельце: снимает кадр с кольца живых и освобождает блок
+    static void release(ThreadCache& cache, Header* header);
+    // Забирает кадры, освобождённые чужими потоками
+    static void drainRemote(ThreadCache& cache);
+
+    static thread_local ThreadCache* thread_cache_;  // nullptr — поток не из цикла или ещё без кадров
+    static thread_local Header* adopting_;           // Выделенные кадры, ещё без корутины
+
+    mutable std::mutex mutex_;  // Реестр кэшей, куски и итоги; на горячем пути не нужен
+    std::vector<std::unique_ptr<ThreadCache>> caches_;
+    std::vector<std::unique_ptr<uint8_t[]>> chunks_;
+    size_t reserved_bytes_ = 0;
+    uint64_t destroyed_ = 0;
+    std::shared_ptr<void> token_;
+};
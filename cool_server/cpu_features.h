@@ -0,0 +1,21 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define COOL_SERVER_X86 1
+#endif
+
+// Функция с расширенным набором инструкций; вызывать только после
+// проверки CpuFeatures. MSVC разрешает интринсики и без атрибута
+#if defined(__GNUC__) || defined(__clang__)
+#define COOL_SERVER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define COOL_SERVER_TARGET(isa)
+#endif
+
+// Возможности процессора для выбора SIMD-ядер во время выполнения
+class CpuFeatures {
+public:
+    static bool hasSsse3();
+    // AVX2 и сохранение YMM-регистров операционной системой
+    static bool hasAvx2();
+};
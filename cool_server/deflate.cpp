@@ -0,0 +1,302 @@
+#include "deflate.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+namespace websocket {
+
+namespace {
+    // Хвост, который RFC 7692 срезает с каждого сжатого сообщения
+    const uint8_t DEFLATE_TAIL[4] = {0x00, 0x00, 0xFF, 0xFF};
+
+    // Порция, на которую растёт выходной буфер при распаковке
+    constexpr size_t INFLATE_CHUNK = 16 * 1024;
+
+    std::string trim(const std::string& s) {
+        size_t begin = s.find_first_not_of(" \t");
+        if (begin == std::string::npos) return "";
+        size_t end = s.find_last_not_of(" \t");
+        return s.substr(begin, end - begin + 1);
+    }
+
+    std::vector<std::string> split(const std::string& s, char delimiter) {
+        std::vector<std::string> parts;
+        std::istringstream iss(s);
+        std::string part;
+        while (std::getline(iss, part, delimiter)) parts.push_back(trim(part));
+        return parts;
+    }
+
+    // Значение параметра окна: 8..15, можно в кавычках. -1 — некорректно
+    int parseWindowBits(const std::string& value) {
+        std::string v = value;
+        if (v.size() >= 2 && v.front() == '"' && v.back() == '"') v = v.substr(1, v.size() - 2);
+        if (v.empty() || v.size() > 2 || !std::all_of(v.begin(), v.end(), ::isdigit)) return -1;
+        int bits = std::atoi(v.c_str());
+        return bits >= 8 && bits <= 15 ? bits : -1;
+    }
+
+    // Разбирает одно предложение; false — предложение не подходит
+    bool acceptOffer(const std::vector<std::string>& params, const DeflateConfig& config,
+                     DeflateParams& result, std::string& response) {
+        bool server_no_context = false, client_no_context = false;
+        bool has_server_bits = false, has_client_bits = false;
+        int server_bits = 15, client_bits = 15;
+
+        for (size_t i = 1; i < params.size(); ++i) {
+            const std::string& param = params[i];
+            const size_t eq = param.find('=');
+            const std::string name = trim(param.substr(0, eq));
+            const std::string value = eq == std::string::npos ? "" : trim(param.substr(eq + 1));
+
+            // Повтор параметра делает предложение недействительным
+            if (name == "server_no_context_takeover") {
+                if (server_no_context || eq != std::string::npos) return false;
+                server_no_context = true;
+            } else if (name == "client_no_context_takeover") {
+                if (client_no_context || eq != std::string::npos) return false;
+                client_no_context = true;
+            } else if (name == "server_max_window_bits") {
+                if (has_server_bits || (server_bits = parseWindowBits(value)) < 0) return false;
+                has_server_bits = true;
+            } else if (name == "client_max_window_bits") {
+                if (has_client_bits) return false;
+                if (eq != std::string::npos && (client_bits = parseWindowBits(value)) < 0) return false;
+                has_client_bits = true;
+            } else {
+                return false;
+            }
+        }
+
+        // zlib не умеет окно в 256 байт: клиенту, который его требует, отказываем
+        result.server_max_window_bits = std::min(std::clamp(config.server_max_window_bits, 9, 15), server_bits);
+        if (result.server_max_window_bits < 9) return false;
+        result.server_no_context_takeover = server_no_context || config.server_no_context_takeover;
+
+        // Окно клиента можно сузить, только если он поддерживает параметр
+        result.client_max_window_bits = has_client_bits
+            ? std::min(std::clamp(config.client_max_window_bits, 9, 15), client_bits)
+            : 15;
+        // Распаковщик zlib с окном 9 читает и поток с окном 8
+        result.client_max_window_bits = std::max(result.client_max_window_bits, 9);
+        result.client_no_context_takeover = client_no_context || config.client_no_context_takeover;
+
+        result.level = config.level;
+        result.mem_level = std::clamp(config.mem_level, 1, 9);
+        result.min_size = config.min_size;
+
+        response = "permessage-deflate";
+        if (result.server_no_context_takeover) response += "; server_no_context_takeover";
+        if (result.client_no_context_takeover) response += "; client_no_context_takeover";
+        if (has_server_bits || result.server_max_window_bits < 15) {
+            response += "; server_max_window_bits=" + std::to_string(result.server_max_window_bits);
+        }
+        if (has_client_bits && result.client_max_window_bits < 15) {
+            response += "; client_max_window_bits=" + std::to_string(result.client_max_window_bits);
+        }
+        return true;
+    }
+}
+
+DeflateMemory::DeflateMemory(size_t budget) : budget_(budget) {}
+
+bool DeflateMemory::acquire(size_t bytes) {
+    size_t current = in_use_.load(std::memory_order_relaxed);
+    do {
+        if (budget_ != 0 && current + bytes > budget_) {
+            alloc_failures_++;
+            return false;
+        }
+    } while (!in_use_.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+
+    size_t peak = peak_.load(std::memory_order_relaxed);
+    while (current + bytes > peak &&
+           !peak_.compare_exchange_weak(peak, current + bytes, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+void DeflateMemory::release(size_t bytes) {
+    in_use_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool DeflateMemory::canAfford(size_t bytes) const {
+    return budget_ == 0 || in_use_.load(std::memory_order_relaxed) + bytes <= budget_;
+}
+
+DeflateMemory::Stats DeflateMemory::stats() const {
+    return {in_use_.load(), peak_.load(), negotiated_.load(), declined_.load(), alloc_failures_.load()};
+}
+
+bool PerMessageDeflate::negotiate(const std::string& offers, const DeflateConfig& config,
+                                  DeflateMemory* memory, DeflateParams& params, std::string& response) {
+    if (!config.enabled) return false;
+
+    for (const std::string& offer : split(offers, ',')) {
+        const std::vector<std::string> parts = split(offer, ';');
+        if (parts.empty() || parts[0] != "permessage-deflate") continue;
+        if (!acceptOffer(parts, config, params, response)) continue;
+
+        // Бюджет проверяем по худшему случаю — оба потока живы одновременно
+        if (memory && !memory->canAfford(estimateMemory(params))) {
+            memory->countDeclined();
+            return false;
+        }
+        if (memory) memory->countNegotiated();
+        return true;
+    }
+    return false;
+}
+
+size_t PerMessageDeflate::estimateMemory(const DeflateParams& params) {
+    const size_t deflate_bytes = (size_t(1) << (params.server_max_window_bits + 2)) +
+                                 (size_t(1) << (params.mem_level + 9));
+    const size_t inflate_bytes = (size_t(1) << params.client_max_window_bits) + 7 * 1024;
+    return deflate_bytes + inflate_bytes;
+}
+
+PerMessageDeflate::PerMessageDeflate(const DeflateParams& params, DeflateMemory* memory)
+    : params_(params), memory_(memory) {}
+
+PerMessageDeflate::~PerMessageDeflate() {
+    releaseDeflate();
+    releaseInflate();
+}
+
+void* PerMessageDeflate::zalloc(void* opaque, unsigned items, unsigned size) {
+    auto* self = static_cast<PerMessageDeflate*>(opaque);
+    // Размер кладём перед блоком: zfree его не получает
+    const size_t bytes = static_cast<size_t>(items) * size + sizeof(std::max_align_t);
+    if (self->memory_ && !self->memory_->acquire(bytes)) return Z_NULL;
+
+    void* block = std::malloc(bytes);
+    if (!block) {
+        if (self->memory_) self->memory_->release(bytes);
+        return Z_NULL;
+    }
+    *static_cast<size_t*>(block) = bytes;
+    self->allocated_ += bytes;
+    return static_cast<char*>(block) + sizeof(std::max_align_t);
+}
+
+void PerMessageDeflate::zfree(void* opaque, void* address) {
+    if (!address) return;
+    auto* self = static_cast<PerMessageDeflate*>(opaque);
+    void* block = static_cast<char*>(address) - sizeof(std::max_align_t);
+    const size_t bytes = *static_cast<size_t*>(block);
+    self->allocated_ -= bytes;
+    if (self->memory_) self->memory_->release(bytes);
+    std::free(block);
+}
+
+bool PerMessageDeflate::ensureDeflate() {
+    if (deflate_ready_) return true;
+    if (!deflate_) deflate_ = std::make_unique<z_stream_s>();
+    *deflate_ = z_stream_s{};
+    deflate_->zalloc = zalloc;
+    deflate_->zfree = zfree;
+    deflate_->opaque = this;
+    // Отрицательное окно — «сырой» deflate без заголовка zlib
+    deflate_ready_ = deflateInit2(deflate_.get(), params_.level, Z_DEFLATED,
+                                  -params_.server_max_window_bits, params_.mem_level,
+                                  Z_DEFAULT_STRATEGY) == Z_OK;
+    return deflate_ready_;
+}
+
+bool PerMessageDeflate::ensureInflate() {
+    if (inflate_ready_) return true;
+    if (!inflate_) inflate_ = std::make_unique<z_stream_s>();
+    *inflate_ = z_stream_s{};
+    inflate_->zalloc = zalloc;
+    inflate_->zfree = zfree;
+    inflate_->opaque = this;
+    inflate_ready_ = inflateInit2(inflate_.get(), -params_.client_max_window_bits) == Z_OK;
+    return inflate_ready_;
+}
+
+void PerMessageDeflate::releaseDeflate() {
+    if (deflate_ready_) deflateEnd(deflate_.get());
+    deflate_ready_ = false;
+}
+
+void PerMessageDeflate::releaseInflate() {
+    if (inflate_ready_) inflateEnd(inflate_.get());
+    inflate_ready_ = false;
+}
+
+bool PerMessageDeflate::compress(const uint8_t* data, size_t size, std::string& out) {
+    if (!ensureDeflate()) return false;
+
+    z_stream_s& z = *deflate_;
+    out.resize(deflateBound(&z, static_cast<uLong>(size)) + 16);
+    z.next_in = const_cast<Bytef*>(data);
+    z.avail_in = static_cast<uInt>(size);
+    z.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    z.avail_out = static_cast<uInt>(out.size());
+
+    // Z_SYNC_FLUSH выравнивает поток по байту и заканчивает его 00 00 FF FF
+    int rc = deflate(&z, Z_SYNC_FLUSH);
+    while (rc == Z_OK && z.avail_out == 0) {
+        const size_t used = out.size();
+        out.resize(used * 2);
+        z.next_out = reinterpret_cast<Bytef*>(&out[used]);
+        z.avail_out = static_cast<uInt>(out.size() - used);
+        rc = deflate(&z, Z_SYNC_FLUSH);
+    }
+    const size_t produced = out.size() - z.avail_out;
+    if ((rc != Z_OK && rc != Z_BUF_ERROR) || produced < 4) {
+        releaseDeflate();
+        return false;
+    }
+    out.resize(produced - 4);
+
+    if (params_.server_no_context_takeover) releaseDeflate();
+    return true;
+}
+
+PerMessageDeflate::InflateResult PerMessageDeflate::decompress(
+    const uint8_t* data, size_t size, bool final, std::string& out, size_t max_size) {
+    if (!ensureInflate()) return InflateResult::NoMemory;
+
+    z_stream_s& z = *inflate_;
+    auto feed = [&](const uint8_t* input, size_t length) -> InflateResult {
+        z.next_in = const_cast<Bytef*>(input);
+        z.avail_in = static_cast<uInt>(length);
+        // Крутимся, пока есть вход или zlib упирается в конец выхода
+        do {
+            const size_t used = out.size();
+            if (used >= max_size) return InflateResult::TooBig;
+            out.resize(std::min(used + std::max(INFLATE_CHUNK, length), max_size));
+            z.next_out = reinterpret_cast<Bytef*>(&out[used]);
+            z.avail_out = static_cast<uInt>(out.size() - used);
+
+            const int rc = inflate(&z, Z_SYNC_FLUSH);
+            out.resize(out.size() - z.avail_out);
+            if (rc == Z_STREAM_END) {
+                // Финальный блок: следующее сообщение начинается с чистого потока
+                inflateReset(&z);
+                if (z.avail_in > 0) return InflateResult::Error;
+                break;
+            }
+            if (rc == Z_MEM_ERROR) return InflateResult::NoMemory;
+            if (rc != Z_OK && rc != Z_BUF_ERROR) return InflateResult::Error;
+        } while (z.avail_in > 0 || z.avail_out == 0);
+        return InflateResult::Ok;
+    };
+
+    InflateResult result = feed(data, size);
+    if (result == InflateResult::Ok && final) result = feed(DEFLATE_TAIL, sizeof(DEFLATE_TAIL));
+
+    if (result != InflateResult::Ok) {
+        releaseInflate();
+    } else if (final && params_.client_no_context_takeover) {
+        releaseInflate();
+    }
+    return result;
+}
+
+} // namespace websocket
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct z_stream_s;
+
+namespace websocket {
+
+// Настройки permessage-deflate (RFC 7692) на стороне сервера
+struct DeflateConfig {
+    bool enabled = false;
+    int server_max_window_bits = 15;          // 9..15: окно сжатия исходящих сообщений
+    int client_max_window_bits = 15;          // Просим у клиента, если он поддерживает параметр
+    bool server_no_context_takeover = false;  // Не хранить словарь между исходящими сообщениями
+    bool client_no_context_takeover = false;  // Просить клиента о том же
+    size_t min_size = 256;                    // Сообщения короче уходят без сжатия
+    int level = 6;                            // Уровень сжатия zlib
+    int mem_level = 8;                        // 1..9: память deflate против степени сжатия
+    size_t memory_budget = 0;                 // Предел памяти zlib на все соединения; 0 — без предела
+};
+
+// Параметры, согласованные для одного соединения
+struct DeflateParams {
+    int server_max_window_bits = 15;
+    int client_max_window_bits = 15;
+    bool server_no_context_takeover = false;
+    bool client_no_context_takeover = false;
+    int level = 6;
+    int mem_level = 8;
+    size_t min_size = 256;
+};
+
+// Учёт памяти zlib. Все выделения всех соединений проходят через один
+// счётчик; за пределом бюджета выделение отказывает, а новые соединения
+// получают отказ в расширении ещё при рукопожатии
+class DeflateMemory {
+public:
+    struct Stats {
+        size_t in_use;
+        size_t peak;
+        uint64_t negotiated;
+        uint64_t declined;       // Отказано в расширении из-за бюджета
+        uint64_t alloc_failures;
+    };
+
+    explicit DeflateMemory(size_t budget = 0);
+
+    // false — выделение не укладывается в бюджет
+    bool acquire(size_t bytes);
+    void release(size_t bytes);
+    // Хватит ли бюджета ещё на bytes
+    bool canAfford(size_t bytes) const;
+
+    void countNegotiated() { negotiated_++; }
+    void countDeclined() { declined_++; }
+    Stats stats() const;
+
+private:
+    const size_t budget_;
+    std::atomic<size_t> in_use_{0};
+    std::atomic<size_t> peak_{0};
+    std::atomic<uint64_t> negotiated_{0};
+    std::atomic<uint64_t> declined_{0};
+    std::atomic<uint64_t> alloc_failures_{0};
+};
+
+// Сжатие одного соединения. Потоки zlib создаются при первом сообщении,
+// а без context takeover освобождаются после каждого: простаивающее
+// соединение памяти zlib не держит. Сжатие и распаковка независимы,
+// но каждое из них вызывающий сериализует сам
+class PerMessageDeflate {
+public:
+    enum class InflateResult { Ok, TooBig, NoMemory, Error };
+
+    // Выбирает первое приемлемое предложение из Sec-WebSocket-Extensions.
+    // false — расширение не принимаем. response — значение заголовка для ответа
+    static bool negotiate(const std::string& offers, const DeflateConfig& config,
+                          DeflateMemory* memory, DeflateParams& params, std::string& response);
+    // Оценка памяти zlib соединения по формулам из zconf.h
+    static size_t estimateMemory(const DeflateParams& params);
+
+    PerMessageDeflate(const DeflateParams& params, DeflateMemory* memory);
+    ~PerMessageDeflate();
+
+    PerMessageDeflate(const PerMessageDeflate&) = delete;
+    PerMessageDeflate& operator=(const PerMessageDeflate&) = delete;
+
+    // Сжимает сообщение целиком в out (без хвоста 00 00 FF FF).
+    // false — не хватило памяти, сообщение можно отправить несжатым
+    bool compress(const uint8_t* data, size_t size, std::string& out);
+    // Распаковывает очередной фрейм сжатого сообщения, дописывая в out;
+    // final — последний фрейм. out не вырастет больше max_size
+    InflateResult decompress(const uint8_t* data, size_t size, bool final,
+                             std::string& out, size_t max_size);
+
+    size_t minSize() const { return params_.min_size; }
+    // Исходящие сообщения зависят друг от друга через общий словарь
+    bool contextTakeover() const { return !params_.server_no_context_takeover; }
+    // Память zlib, занятая этим соединением сейчас
+    size_t memoryInUse() const { return allocated_; }
+
+private:
+    static void* zalloc(void* opaque, unsigned items, unsigned size);
+    static void zfree(void* opaque, void* address);
+
+    bool ensureDeflate();
+    bool ensureInflate();
+    void releaseDeflate();
+    void releaseInflate();
+
+    DeflateParams params_;
+    DeflateMemory* memory_;
+    std::unique_ptr<z_stream_s> deflate_;
+    std::unique_ptr<z_stream_s> inflate_;
+    bool deflate_ready_ = false;
+    bool inflate_ready_ = false;
+    std::atomic<size_t> allocated_{0};
+};
+
+} // namespace websocket
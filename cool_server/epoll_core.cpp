@@ -0,0 +1,453 @@
+#include "iocp_core.h"
+
+#if !defined(_WIN32) && !defined(COOL_SERVER_IO_URING)
+
+#include "socket_utils.h"
+#include "thread_affinity.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <climits>
+#include <iostream>
+
+// Linux-бэкенд IOCPCore: реактор на edge-triggered epoll.
+// Каждая операция сначала пробуется сразу; если сокет не готов, она
+// ставится в очередь сокета и доделывается по событию epoll.
+// Завершения, полученные вне рабочего потока, идут через очередь + eventfd,
+// поэтому коллбэк никогда не вызывается внутри asyncRecv/asyncSend.
+
+namespace {
+    constexpr int MAX_EVENTS = 64;
+    constexpr size_t MAX_IOV = 64;
+}
+
+thread_local IOCPCore* IOCPCore::local_owner_ = nullptr;
+thread_local std::vector<IOCPCore::Completion>* IOCPCore::local_completions_ = nullptr;
+
+IOCPCore::IOCPCore()
+    : epoll_fd_(-1),
+      event_fd_(-1),
+      is_running_(false) {}
+
+IOCPCore::~IOCPCore() {
+    stop();
+}
+
+bool IOCPCore::setup() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        std::cerr << "Failed to create epoll: " << SocketUtils::getLastErrorString() << "\n";
+        return false;
+    }
+
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd_ < 0) {
+        std::cerr << "Failed to create eventfd: " << SocketUtils::getLastErrorString() << "\n";
+        return false;
+    }
+
+    // eventfd слушаем в level-triggered режиме: пока очередь завершений
+    // не разобрана, его увидит любой свободный поток
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = event_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev) < 0) {
+        std::cerr << "Failed to register eventfd: " << SocketUtils::getLastErrorString() << "\n";
+        return false;
+    }
+    return true;
+}
+
+void IOCPCore::associateSocket(SOCKET socket, CompletionHandler* handler) {
+    ULONG_PTR key = reinterpret_cast<ULONG_PTR>(handler);
+    auto state = std::make_shared<SocketState>();
+    state->socket = socket;
+    state->key = key;
+
+    {
+        std::unique_lock<std::shared_mutex> lock(sockets_mutex_);
+        auto it = sockets_.find(socket);
+        if (it != sockets_.end()) {
+            // Повторная привязка только меняет ключ
+            std::lock_guard<std::mutex> state_lock(it->second->mutex);
+            it->second->key = key;
+            return;
+        }
+        sockets_[socket] = state;
+    }
+
+    // Edge-triggered требует неблокирующего сокета
+    SocketUtils::setNonBlocking(socket);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = socket;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket, &ev) < 0) {
+        std::cerr << "Failed to associate socket: " << SocketUtils::getLastErrorString() << "\n";
+        std::unique_lock<std::shared_mutex> lock(sockets_mutex_);
+        sockets_.erase(socket);
+    }
+}
+
+void IOCPCore::runWorkerThreads(int count, const std::vector<int>& cpus) {
+    is_running_ = true;
+    workers_.reserve(count);
+
+    for (int i = 0; i < count; ++i) {
+        const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        workers_.emplace_back([this, cpu]() {
+            if (cpu >= 0) ThreadAffinity::pinCurrentThread(cpu);
+            current_ = this;
+            epoll_event events[MAX_EVENTS];
+            std::vector<Completion> local;
+            local_owner_ = this;
+            local_completions_ = &local;
+            BusyPoller poller(busy_poll_, busy_poll_stats_);
+
+            while (is_running_) {
+                int n;
+                if (!local.empty()) {
+                    // Завершения, поставленные прошлым разбором, ждут — не спим
+                    n = epoll_wait(epoll_fd_, events, MAX_EVENTS, 0);
+                    syscalls_.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    const int timeout = timerTimeout();
+                    // Сначала опрос с нулевым таймаутом, пустой — сон в ядре
+                    n = poller.spin([&] {
+                        syscalls_.fetch_add(1, std::memory_order_relaxed);
+                        return epoll_wait(epoll_fd_, events, MAX_EVENTS, 0);
+                    }, timeout);
+                    if (n == 0) {
+                        poller.park();
+                        n = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout);
+                        syscalls_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                if (!is_running_) break;
+
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    std::cerr << "epoll_wait failed: " << SocketUtils::getLastErrorString() << "\n";
+                    break;
+                }
+
+                for (int j = 0; j < n; ++j) {
+                    if (events[j].data.fd == event_fd_) {
+                        drainCompletions();
+                    } else {
+                        handleEvents(events[j].data.fd, events[j].events);
+                    }
+                }
+                drainLocalCompletions();
+
+                runTimers();
+                drainLocalCompletions();
+            }
+        });
+    }
+}
+
+void IOCPCore::stop() {
+    if (is_running_) {
+        is_running_ = false;
+
+        // Счётчик eventfd не сбрасываем — он будит все потоки сразу
+        uint64_t one = 1;
+        ssize_t written = ::write(event_fd_, &one, sizeof(one));
+        (void)written;
+
+        for (auto& thread : workers_) {
+            if (thread.joinable()) thread.join();
+        }
+        workers_.clear();
+    }
+
+    if (event_fd_ >= 0) {
+        ::close(event_fd_);
+        event_fd_ = -1;
+    }
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+}
+
+void IOCPCore::postCompletion(DWORD bytes, CompletionHandler* handler, LPOVERLAPPED overlapped) {
+    ULONG_PTR key = reinterpret_cast<ULONG_PTR>(handler);
+    enqueueCompletion({true, bytes, key, overlapped, 0});
+}
+
+bool IOCPCore::zeroByteReads() {
+    return true;
+}
+
+bool IOCPCore::asyncRecv(SOCKET socket, WSABUF* buffers, DWORD count, LPOVERLAPPED overlapped) {
+    auto state = findSocket(socket);
+    if (!state) return false;
+
+    PendingOp op{OpType::Recv, overlapped, std::vector<WSABUF>(buffers, buffers + count)};
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->reads.empty()) {
+        DWORD error = 0;
+        switch (tryOperation(*state, op, error)) {
+            case OpStatus::Done:
+                enqueueCompletion({true, static_cast<DWORD>(op.transferred), state->key, overlapped, 0});
+                return true;
+            case OpStatus::Failed:
+                enqueueCompletion({false, 0, state->key, overlapped, error});
+                return true;
+            case OpStatus::WouldBlock:
+                break;
+        }
+    }
+    state->reads.push_back(std::move(op));
+    return true;
+}
+
+bool IOCPCore::asyncSend(SOCKET socket, WSABUF* buffers, DWORD count, LPOVERLAPPED overlapped) {
+    auto state = findSocket(socket);
+    if (!state) return false;
+
+    PendingOp op{OpType::Send, overlapped, std::vector<WSABUF>(buffers, buffers + count)};
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    // Порядок отправки сохраняем: если очередь не пуста, просто встаём в конец
+    if (state->writes.empty()) {
+        DWORD error = 0;
+        switch (tryOperation(*state, op, error)) {
+            case OpStatus::Done:
+                enqueueCompletion({true, static_cast<DWORD>(op.transferred), state->key, overlapped, 0});
+                return true;
+            case OpStatus::Failed:
+                enqueueCompletion({false, 0, state->key, overlapped, error});
+                return true;
+            case OpStatus::WouldBlock:
+                break;
+        }
+    }
+    state->writes.push_back(std::move(op));
+    return true;
+}
+
+bool IOCPCore::asyncAccept(SOCKET listen_socket, AcceptOperation* op) {
+    auto state = findSocket(listen_socket);
+    if (!state) return false;
+
+    ZeroMemory(&op->overlapped, sizeof(OVERLAPPED));
+    op->socket = INVALID_SOCKET;
+
+    PendingOp pending{OpType::Accept, &op->overlapped, {}, 0, op};
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->reads.empty()) {
+        DWORD error = 0;
+        switch (tryOperation(*state, pending, error)) {
+            case OpStatus::Done:
+                enqueueCompletion({true, 0, state->key, &op->overlapped, 0});
+                return true;
+            case OpStatus::Failed:
+                enqueueCompletion({false, 0, state->key, &op->overlapped, error});
+                return true;
+            case OpStatus::WouldBlock:
+                break;
+        }
+    }
+    state->reads.push_back(std::move(pending));
+    return true;
+}
+
+void IOCPCore::closeSocket(SOCKET socket) {
+    std::shared_ptr<SocketState> state;
+    {
+        std::unique_lock<std::shared_mutex> lock(sockets_mutex_);
+        auto it = sockets_.find(socket);
+        if (it != sockets_.end()) {
+            state = it->second;
+            sockets_.erase(it);
+        }
+    }
+
+    if (state) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket, nullptr);
+
+        // Как и IOCP, отменённые операции завершаются с ошибкой
+        for (auto& op : state->reads) {
+            enqueueCompletion({false, 0, state->key, op.overlapped, ECANCELED});
+        }
+        for (auto& op : state->writes) {
+            enqueueCompletion({false, 0, state->key, op.overlapped, ECANCELED});
+        }
+        state->reads.clear();
+        state->writes.clear();
+    }
+
+    SocketUtils::closeSocket(socket);
+}
+
+std::shared_ptr<IOCPCore::SocketState> IOCPCore::findSocket(SOCKET socket) {
+    std::shared_lock<std::shared_mutex> lock(sockets_mutex_);
+    auto it = sockets_.find(socket);
+    return it != sockets_.end() ? it->second : nullptr;
+}
+
+IOCPCore::OpStatus IOCPCore::tryOperation(SocketState& state, PendingOp& op, DWORD& error) {
+    syscalls_.fetch_add(1, std::memory_order_relaxed);
+
+    if (op.type == OpType::Accept) {
+        SOCKET client = accept4(state.socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client >= 0) {
+            op.accept->socket = client;
+            return OpStatus::Done;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return OpStatus::WouldBlock;
+        error = errno;
+        return OpStatus::Failed;
+    }
+
+    // Собираем iovec из ещё не переданной части буферов
+    iovec iov[MAX_IOV];
+    size_t iov_count = 0;
+    size_t skip = op.transferred;
+    for (const WSABUF& buf : op.buffers) {
+        if (iov_count == MAX_IOV) break;
+        if (skip >= buf.len) {
+            skip -= buf.len;
+            continue;
+        }
+        iov[iov_count].iov_base = buf.buf + skip;
+        iov[iov_count].iov_len = buf.len - skip;
+        ++iov_count;
+        skip = 0;
+    }
+
+    // Чтение нулевой длины, как у IOCP, ждёт данных и ничего не забирает
+    if (op.type == OpType::Recv && iov_count == 0) {
+        char probe;
+        while (true) {
+            if (::recv(state.socket, &probe, 1, MSG_PEEK) >= 0) return OpStatus::Done;
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return OpStatus::WouldBlock;
+            error = errno;
+            return OpStatus::Failed;
+        }
+    }
+
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+
+    while (true) {
+        ssize_t n = (op.type == OpType::Recv)
+            ? ::recvmsg(state.socket, &msg, 0)
+            : ::sendmsg(state.socket, &msg, MSG_NOSIGNAL);
+
+        if (n >= 0) {
+            op.transferred += static_cast<size_t>(n);
+
+            if (op.type == OpType::Recv) return OpStatus::Done;
+
+            // Отправка завершается только когда ушли все буферы
+            size_t total = 0;
+            for (const WSABUF& buf : op.buffers) total += buf.len;
+            if (op.transferred >= total) return OpStatus::Done;
+            return tryOperation(state, op, error);
+        }
+
+        if (errno == EINTR) {
+            syscalls_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return OpStatus::WouldBlock;
+        error = errno;
+        return OpStatus::Failed;
+    }
+}
+
+void IOCPCore::handleEvents(SOCKET socket, uint32_t events) {
+    auto state = findSocket(socket);
+    if (!state) return;
+
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+
+        auto process = [&](std::deque<PendingOp>& queue) {
+            while (!queue.empty()) {
+                PendingOp& op = queue.front();
+                DWORD error = 0;
+                OpStatus status = tryOperation(*state, op, error);
+                if (status == OpStatus::WouldBlock) break;
+
+                done.push_back({status == OpStatus::Done,
+                                static_cast<DWORD>(op.transferred),
+                                state->key, op.overlapped, error});
+                queue.pop_front();
+            }
+        };
+
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) process(state->reads);
+        if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) process(state->writes);
+    }
+
+    // Коллбэки зовём уже без блокировки сокета
+    for (const Completion& c : done) {
+        dispatch(c.ok, c.bytes, c.key, c.overlapped, c.error);
+    }
+}
+
+void IOCPCore::enqueueCompletion(const Completion& completion) {
+    if (local_owner_ == this) {
+        local_completions_->push_back(completion);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex_);
+        completions_.push_back(completion);
+    }
+    syscalls_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t one = 1;
+    ssize_t written = ::write(event_fd_, &one, sizeof(one));
+    (void)written;
+}
+
+void IOCPCore::drainLocalCompletions() {
+    // Разбираем только то, что накопилось к входу: коллбэк, снова ставящий
+    // операцию, которая тут же завершается, иначе не отпустит поток в
+    // epoll_wait. Поставленное сейчас заберёт следующий проход цикла
+    std::vector<Completion> batch;
+    batch.swap(*local_completions_);
+    for (const Completion& c : batch) {
+        if (!is_running_) return;
+        dispatch(c.ok, c.bytes, c.key, c.overlapped, c.error);
+    }
+}
+
+void IOCPCore::drainCompletions() {
+    std::deque<Completion> batch;
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex_);
+        uint64_t counter = 0;
+        ssize_t got = ::read(event_fd_, &counter, sizeof(counter));
+        (void)got;
+        batch.swap(completions_);
+    }
+    syscalls_.fetch_add(1, std::memory_order_relaxed);
+
+    if (!is_running_) {
+        // Сигнал остановки мог быть съеден вместе со счётчиком — возвращаем его
+        uint64_t one = 1;
+        ssize_t written = ::write(event_fd_, &one, sizeof(one));
+        (void)written;
+        return;
+    }
+
+    for (const Completion& c : batch) {
+        if (!is_running_) return;
+        dispatch(c.ok, c.bytes, c.key, c.overlapped, c.error);
+    }
+}
+
+#endif
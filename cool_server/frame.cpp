@@ -1,16 +1,116 @@
 #include "frame.h"
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <random>
+#include "cpu_features.h"
+
+#ifdef COOL_SERVER_X86
+#include <immintrin.h>
+#endif
 
 namespace websocket {
 
-bool Frame::parseHeader(const std::vector<uint8_t>& data, FrameHeader& header) {
-    if (data.size() < 2) {
+namespace {
+    // pattern — 4 байта маски в порядке их наложения на data[0..3]
+    using MaskKernel = void (*)(uint8_t* data, size_t len, const uint8_t* pattern);
+
+    void maskScalar(uint8_t* data, size_t len, const uint8_t* pattern) {
+        // По 8 байт за шаг; фаза маски не сбивается, так как шаг кратен 4
+        uint8_t wide[8];
+        for (size_t j = 0; j < 8; ++j) wide[j] = pattern[j & 3];
+        uint64_t mask;
+        std::memcpy(&mask, wide, sizeof(mask));
+
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t chunk;
+            std::memcpy(&chunk, data + i, sizeof(chunk));
+            chunk ^= mask;
+            std::memcpy(data + i, &chunk, sizeof(chunk));
+        }
+        for (; i < len; ++i) {
+            data[i] ^= pattern[i & 3];
+        }
+    }
+
+#ifdef COOL_SERVER_X86
+    void maskSse2(uint8_t* data, size_t len, const uint8_t* pattern) {
+        int32_t word;
+        std::memcpy(&word, pattern, sizeof(word));
+        const __m128i mask = _mm_set1_epi32(word);
+
+        size_t i = 0;
+        for (; i + 64 <= len; i += 64) {
+            __m128i* p = reinterpret_cast<__m128i*>(data + i);
+            _mm_storeu_si128(p + 0, _mm_xor_si128(_mm_loadu_si128(p + 0), mask));
+            _mm_storeu_si128(p + 1, _mm_xor_si128(_mm_loadu_si128(p + 1), mask));
+            _mm_storeu_si128(p + 2, _mm_xor_si128(_mm_loadu_si128(p + 2), mask));
+            _mm_storeu_si128(p + 3, _mm_xor_si128(_mm_loadu_si128(p + 3), mask));
+        }
+        for (; i + 16 <= len; i += 16) {
+            __m128i* p = reinterpret_cast<__m128i*>(data + i);
+            _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), mask));
+        }
+        maskScalar(data + i, len - i, pattern);
+    }
+
+    COOL_SERVER_TARGET("avx2")
+    void maskAvx2(uint8_t* data, size_t len, const uint8_t* pattern) {
+        int32_t word;
+        std::memcpy(&word, pattern, sizeof(word));
+        const __m256i mask = _mm256_set1_epi32(word);
+
+        size_t i = 0;
+        for (; i + 128 <= len; i += 128) {
+            __m256i* p = reinterpret_cast<__m256i*>(data + i);
+            _mm256_storeu_si256(p + 0, _mm256_xor_si256(_mm256_loadu_si256(p + 0), mask));
+            _mm256_storeu_si256(p + 1, _mm256_xor_si256(_mm256_loadu_si256(p + 1), mask));
+            _mm256_storeu_si256(p + 2, _mm256_xor_si256(_mm256_loadu_si256(p + 2), mask));
+            _mm256_storeu_si256(p + 3, _mm256_xor_si256(_mm256_loadu_si256(p + 3), mask));
+        }
+        for (; i + 32 <= len; i += 32) {
+            __m256i* p = reinterpret_cast<__m256i*>(data + i);
+            _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), mask));
+        }
+        // Хвост отдаём не-VEX коду: без vzeroupper переход стоит сотни тактов
+        _mm256_zeroupper();
+        maskSse2(data + i, len - i, pattern);
+    }
+#endif
+
+    struct MaskDispatch {
+        MaskKernel kernel;
+        const char* name;
+    };
+
+    const MaskDispatch& maskDispatch() {
+        static const MaskDispatch dispatch = []() -> MaskDispatch {
+#ifdef COOL_SERVER_X86
+            if (CpuFeatures::hasAvx2()) return {maskAvx2, "avx2"};
+            return {maskSse2, "sse2"};
+#else
+            return {maskScalar, "scalar"};
+#endif
+        }();
+        return dispatch;
+    }
+
+    // Короче этого векторное ядро не окупает косвенный вызов
+    constexpr size_t SMALL_MASK_SIZE = 16;
+
+    // Кусок совместного снятия маски и проверки UTF-8: с запасом влезает в L1
+    constexpr size_t UTF8_CHUNK_SIZE = 4096;
+}
+
+bool Frame::parseHeader(const uint8_t* data, size_t size, FrameHeader& header, uint64_t max_payload) {
+    if (size < 2) {
         return false;
     }
 
     // Базовый заголовок (2 байта)
     header.fin = (data[0] & 0x80) != 0;
+    header.rsv = data[0] & 0x70;
     header.opcode = static_cast<Opcode>(data[0] & 0x0F);
     header.masked = (data[1] & 0x80) != 0;
 
@@ -19,21 +119,16 @@ bool Frame::parseHeader(const std::vector<uint8_t>& data, FrameHeader& header) {
 
     // Длина payload
     if (len_byte == 126) {
-        if (data.size() < 4) return false;
-        header.payload_length = (data[2] << 8) | data[3];
+        if (size < 4) return false;
+        header.payload_length = (static_cast<uint64_t>(data[2]) << 8) | data[3];
         header_size += 2;
     } 
     else if (len_byte == 127) {
-        if (data.size() < 10) return false;
-        header.payload_length = 
-            (static_cast<uint64_t>(data[2]) << 56) |
-            (static_cast<uint64_t>(data[3]) << 48) |
-            (static_cast<uint64_t>(data[4]) << 40) |
-            (static_cast<uint64_t>(data[5]) << 32) |
-            (static_cast<uint64_t>(data[6]) << 24) |
-            (static_cast<uint64_t>(data[7]) << 16) |
-            (static_cast<uint64_t>(data[8]) << 8)  |
-            data[9];
+        if (size < 10) return false;
+        header.payload_length = 0;
+        for (size_t i = 2; i < 10; ++i) {
+            header.payload_length = (header.payload_length << 8) | data[i];
+        }
         header_size += 8;
     } 
     else {
@@ -41,24 +136,31 @@ bool Frame::parseHeader(const std::vector<uint8_t>& data, FrameHeader& header) {
     }
 
     // Проверка максимального размера
-    if (header.payload_length > MAX_FRAME_SIZE) {
+    if (header.payload_length > max_payload) {
         throw std::runtime_error("Frame size exceeds maximum limit");
     }
 
     // Маскировка
     if (header.masked) {
-        if (data.size() < header_size + 4) return false;
-        header.masking_key = 
-            (data[header_size] << 24) |
-            (data[header_size+1] << 16) |
-            (data[header_size+2] << 8) |
-            data[header_size+3];
+        if (size < header_size + 4) return false;
+        header.masking_key =
+            (static_cast<uint32_t>(data[header_size]) << 24) |
+            (static_cast<uint32_t>(data[header_size + 1]) << 16) |
+            (static_cast<uint32_t>(data[header_size + 2]) << 8) |
+            static_cast<uint32_t>(data[header_size + 3]);
         header_size += 4;
+    } else {
+        header.masking_key = 0;
     }
 
+    header.header_size = header_size;
     return true;
 }
 
+bool Frame::parseHeader(const std::vector<uint8_t>& data, FrameHeader& header) {
+    return parseHeader(data.data(), data.size(), header);
+}
+
 size_t Frame::headerSize(const FrameHeader& header) {
     size_t size = 2; // Базовый заголовок
     
@@ -73,76 +175,69 @@ size_t Frame::headerSize(const FrameHeader& header) {
     return size;
 }
 
-std::vector<uint8_t> Frame::createFrame(Opcode opcode, const std::string& payload, bool masked) {
+std::vector<uint8_t> Frame::createFrame(Opcode opcode, std::string_view payload, bool masked,
+                                        bool compressed) {
     validateOpcode(opcode);
-    
+
+    const auto* data = reinterpret_cast<const uint8_t*>(payload.data());
     std::vector<uint8_t> frame;
-    frame.reserve(MAX_HEADER_SIZE + payload.size());
-    
-    // Byte 1: FIN + opcode
-    frame.push_back(0x80 | static_cast<uint8_t>(opcode));
-    
-    // Byte 2: MASK + длина
-    if (payload.size() <= 125) {
-        frame.push_back((masked ? 0x80 : 0x00) | static_cast<uint8_t>(payload.size()));
-    } 
-    else if (payload.size() <= 65535) {
-        frame.push_back((masked ? 0x80 : 0x00) | 126);
-        frame.push_back((payload.size() >> 8) & 0xFF);
-        frame.push_back(payload.size() & 0xFF);
-    } 
-    else {
-        frame.push_back((masked ? 0x80 : 0x00) | 127);
-        for (int i = 7; i >= 0; --i) {
-            frame.push_back((payload.size() >> (8 * i)) & 0xFF);
-        }
-    }
-    
-    // Маскировка
     if (masked) {
         static thread_local std::mt19937 gen(std::random_device{}());
         std::uniform_int_distribution<uint32_t> dist;
-        uint32_t mask = dist(gen);
-        
-        frame.push_back((mask >> 24) & 0xFF);
-        frame.push_back((mask >> 16) & 0xFF);
-        frame.push_back((mask >> 8) & 0xFF);
-        frame.push_back(mask & 0xFF);
-        
-        // Применяем маску
-        std::string masked_payload = payload;
-        for (size_t i = 0; i < masked_payload.size(); ++i) {
-            masked_payload[i] ^= ((mask >> (8 * (3 - (i % 4)))) & 0xFF);
-        }
-        frame.insert(frame.end(), masked_payload.begin(), masked_payload.end());
-    } 
-    else {
-        frame.insert(frame.end(), payload.begin(), payload.end());
+        frame.resize(FrameEncoder<true>::frameSize(payload.size()));
+        FrameEncoder<true>::encode(frame.data(), opcode, data, payload.size(), compressed, dist(gen));
+    } else {
+        frame.resize(ServerFrameEncoder::frameSize(payload.size()));
+        ServerFrameEncoder::encode(frame.data(), opcode, data, payload.size(), compressed);
     }
-    
     return frame;
 }
 
-std::string Frame::decodePayload(const FrameHeader& header, const std::vector<uint8_t>& payload) {
-    if (payload.size() != header.payload_length) {
-        throw std::runtime_error("Payload length mismatch");
+SharedFrame Frame::createSharedFrame(Opcode opcode, std::string_view payload) {
+    return std::make_shared<const std::vector<uint8_t>>(createFrame(opcode, payload));
+}
+
+PooledBuffer Frame::createPooledFrame(Opcode opcode, std::string_view payload, bool compressed) {
+    validateOpcode(opcode);
+
+    PooledBuffer frame(ServerFrameEncoder::frameSize(payload.size()));
+    frame.resize(ServerFrameEncoder::encode(frame.data(), opcode, reinterpret_cast<const uint8_t*>(payload.data()),
+                                            payload.size(), compressed));
+    return frame;
+}
+
+void Frame::applyMask(uint32_t masking_key, uint8_t* data, size_t len, size_t offset) {
+    if (len == 0) return;
+
+    // Ключ хранится старшим байтом вперёд; поворачиваем под offset
+    uint8_t pattern[4];
+    for (size_t j = 0; j < 4; ++j) {
+        pattern[j] = static_cast<uint8_t>(masking_key >> (8 * (3 - ((j + offset) & 3))));
     }
 
-    std::vector<uint8_t> decoded(payload.begin(), payload.end());
-    
-    if (header.masked) {
-        for (size_t i = 0; i < decoded.size(); ++i) {
-            decoded[i] ^= ((header.masking_key >> (8 * (3 - (i % 4)))) & 0xFF);
-        }
+    if (len < SMALL_MASK_SIZE) {
+        maskScalar(data, len, pattern);
+    } else {
+        maskDispatch().kernel(data, len, pattern);
     }
-    
-    return std::string(decoded.begin(), decoded.end());
 }
 
-void Frame::applyMask(uint32_t masking_key, uint8_t* data, size_t len) {
-    for (size_t i = 0; i < len; ++i) {
-        data[i] ^= ((masking_key >> (8 * (3 - (i % 4)))) & 0xFF);
+void Frame::unmask(const FrameHeader& header, uint8_t* data, size_t len, size_t offset) {
+    if (header.masked) applyMask(header.masking_key, data, len, offset);
+}
+
+bool Frame::unmaskUtf8(const FrameHeader& header, uint8_t* data, size_t len,
+                       Utf8Validator& validator, size_t offset) {
+    for (size_t done = 0; done < len; done += UTF8_CHUNK_SIZE) {
+        const size_t chunk = std::min(UTF8_CHUNK_SIZE, len - done);
+        unmask(header, data + done, chunk, offset + done);
+        if (!validator.feed(data + done, chunk)) return false;
     }
+    return true;
+}
+
+const char* Frame::maskKernel() {
+    return maskDispatch().name;
 }
 
 void Frame::validateOpcode(Opcode opcode) {
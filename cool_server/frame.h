@@ -2,8 +2,13 @@
 
 #include <vector>
 #include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include "buffer_pool.h"
+#include "utf8_validator.h"
 
 namespace websocket {
 
@@ -18,25 +23,119 @@ enum class Opcode : uint8_t {
 
 struct FrameHeader {
     bool fin;
+    uint8_t rsv;         // Биты RSV1-RSV3 как есть (маска 0x70)
     Opcode opcode;
     bool masked;
     uint64_t payload_length;
     uint32_t masking_key;
+    size_t header_size;  // Сколько байт заголовок занял в потоке
 };
 
+// Готовый к отправке фрейм, общий для многих соединений: кодируется
+// один раз и освобождается, когда его отправит последний получатель
+using SharedFrame = std::shared_ptr<const std::vector<uint8_t>>;
+
 class Frame {
 public:
     static constexpr uint64_t MAX_FRAME_SIZE = 16 * 1024 * 1024; // 16MB
     static constexpr size_t MAX_HEADER_SIZE = 14;
+    // RSV1 первого фрейма — сообщение сжато permessage-deflate
+    static constexpr uint8_t RSV1 = 0x40;
 
+    // Разбирает заголовок прямо из приёмного буфера; false — данных пока мало.
+    // Payload длиннее max_payload — исключение
+    static bool parseHeader(const uint8_t* data, size_t size, FrameHeader& header,
+                            uint64_t max_payload = MAX_FRAME_SIZE);
     static bool parseHeader(const std::vector<uint8_t>& data, FrameHeader& header);
     static size_t headerSize(const FrameHeader& header);
-    static std::vector<uint8_t> createFrame(Opcode opcode, const std::string& payload, bool masked = false);
-    static std::string decodePayload(const FrameHeader& header, const std::vector<uint8_t>& payload);
-    
-private:
-    static void applyMask(uint32_t masking_key, uint8_t* data, size_t len);
+    static std::vector<uint8_t> createFrame(Opcode opcode, std::string_view payload, bool masked = false,
+                                            bool compressed = false);
+    static std::vector<uint8_t> createFrame(Opcode opcode, const uint8_t* payload, size_t size,
+                                            bool masked = false, bool compressed = false) {
+        return createFrame(opcode, {reinterpret_cast<const char*>(payload), size}, masked, compressed);
+    }
+    // Серверный (немаскированный) фрейм для рассылки
+    static SharedFrame createSharedFrame(Opcode opcode, std::string_view payload);
+    // Серверный фрейм в блоке BufferPool: без своего выделения памяти.
+    // Соединение пишет фреймы сразу в свой выходной блок (FrameEncoder)
+    static PooledBuffer createPooledFrame(Opcode opcode, std::string_view payload, bool compressed = false);
+
+    // XOR с маской на месте. offset — позиция data[0] внутри payload,
+    // чтобы снимать маску по частям. Ядро (AVX2/SSE2/скалярное)
+    // выбирается один раз по возможностям процессора
+    static void applyMask(uint32_t masking_key, uint8_t* data, size_t len, size_t offset = 0);
+    // Снимает маску, если фрейм замаскирован
+    static void unmask(const FrameHeader& header, uint8_t* data, size_t len, size_t offset = 0);
+    // Снимает маску и проверяет UTF-8 за один проход по памяти: кусками,
+    // которые валидатор читает из L1 сразу после XOR. offset — как в applyMask
+    static bool unmaskUtf8(const FrameHeader& header, uint8_t* data, size_t len,
+                           Utf8Validator& validator, size_t offset = 0);
+    // Имя выбранного ядра маскирования (для бенчмарков)
+    static const char* maskKernel();
+
+    // Неизвестный опкод — исключение
     static void validateOpcode(Opcode opcode);
 };
 
+// Кодирует фрейм прямо в чужой буфер (выходной блок соединения, vector,
+// блок пула) без промежуточных копий. Маска — параметр шаблона, длина
+// payload выбирает одну из двух ветвей: для серверного фрейма короче
+// 126 байт заголовок — одна 16-битная запись, дальше memcpy
+template <bool Masked = false>
+class FrameEncoder {
+public:
+    static constexpr size_t headerSize(size_t payload) {
+        return (payload < 126 ? 2 : payload <= 65535 ? 4 : 10) + (Masked ? 4 : 0);
+    }
+    static constexpr size_t frameSize(size_t payload) { return headerSize(payload) + payload; }
+
+    // Пишет фрейм в out (не меньше frameSize(size) байт), возвращает его длину.
+    // masking_key нужен только маскированному фрейму
+    static size_t encode(uint8_t* out, Opcode opcode, const uint8_t* payload, size_t size,
+                         bool compressed = false, uint32_t masking_key = 0) {
+        return size < 126 ? encodeAs<true>(out, opcode, payload, size, compressed, masking_key)
+                          : encodeAs<false>(out, opcode, payload, size, compressed, masking_key);
+    }
+
+private:
+    template <bool Small>
+    static size_t encodeAs(uint8_t* out, Opcode opcode, const uint8_t* payload, size_t size,
+                           bool compressed, uint32_t masking_key) {
+        const uint8_t mask_bit = Masked ? 0x80 : 0x00;
+        size_t n;
+        if constexpr (Small) {
+            const uint8_t header[2] = {
+                static_cast<uint8_t>(0x80 | (compressed ? Frame::RSV1 : 0) | static_cast<uint8_t>(opcode)),
+                static_cast<uint8_t>(mask_bit | size)
+            };
+            std::memcpy(out, header, 2);
+            n = 2;
+        } else {
+            out[0] = 0x80 | (compressed ? Frame::RSV1 : 0) | static_cast<uint8_t>(opcode);
+            if (size <= 65535) {
+                out[1] = mask_bit | 126;
+                out[2] = static_cast<uint8_t>(size >> 8);
+                out[3] = static_cast<uint8_t>(size);
+                n = 4;
+            } else {
+                out[1] = mask_bit | 127;
+                for (int i = 0; i < 8; ++i) {
+                    out[2 + i] = static_cast<uint8_t>(static_cast<uint64_t>(size) >> (8 * (7 - i)));
+                }
+                n = 10;
+            }
+        }
+        if constexpr (Masked) {
+            for (int i = 0; i < 4; ++i) out[n + i] = static_cast<uint8_t>(masking_key >> (8 * (3 - i)));
+            n += 4;
+        }
+        if (size > 0) std::memcpy(out + n, payload, size);
+        if constexpr (Masked) Frame::applyMask(masking_key, out + n, size);
+        return n + size;
+    }
+};
+
+// Фреймы сервера клиенту не маскируются (RFC 6455, 5.1)
+using ServerFrameEncoder = FrameEncoder<false>;
+
 } // namespace websocket
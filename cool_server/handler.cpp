@@ -1,99 +1,53 @@
 #include "handler.h"
 #include "frame.h"
-#include <openssl/sha.h>
-#include <openssl/bio.h>
-#include <openssl/evp.h>
-#include <sstream>
+#include "handshake.h"
 #include <stdexcept>
 #include <algorithm>
 
 namespace websocket {
 
-namespace {
-    const std::string MAGIC_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
-    const std::string HANDSHAKE_HEADER = "HTTP/1.1 101 Switching Protocols\r\n"
-                                         "Upgrade: websocket\r\n"
-                                         "Connection: Upgrade\r\n"
-                                         "Sec-WebSocket-Accept: ";
-    
-    std::string base64_encode(const std::string& input) {
-        BIO* b64 = BIO_new(BIO_f_base64());
-        BIO* mem = BIO_new(BIO_s_mem());
-        BIO_push(b64, mem);
-        BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-        BIO_write(b64, input.data(), static_cast<int>(input.size()));
-        BIO_flush(b64);
-        
-        char* data;
-        long len = BIO_get_mem_data(mem, &data);
-        std::string result(data, len);
-        
-        BIO_free_all(b64);
-        return result;
-    }
-}
-
-RFC6455Handler::RFC6455Handler(size_t max_frame_size)
-    : max_frame_size_(std::min(max_frame_size, Frame::MAX_FRAME_SIZE)) {}
+RFC6455Handler::RFC6455Handler(size_t max_frame_size, const DeflateConfig& deflate,
+                               DeflateMemory* deflate_memory)
+    : max_frame_size_(std::min(max_frame_size, Frame::MAX_FRAME_SIZE)),
+      deflate_config_(deflate),
+      deflate_memory_(deflate_memory) {}
 
 std::unique_ptr<Connection> RFC6455Handler::handleHandshake(
     const std::string& request, 
     std::string& response) {
     
-    std::string client_key;
-    if (!parseHandshake(request, client_key)) {
+    const auto* data = reinterpret_cast<const uint8_t*>(request.data());
+    HandshakeParser parser;
+    if (parser.parse(data, request.size()) != HandshakeParser::Result::Done) {
+        std::vector<uint8_t> rejection = Handshake::rejection(parser.status() ? parser.status() : 400);
+        response.assign(rejection.begin(), rejection.end());
         return nullptr;
     }
-    
-    // Вычисляем accept-key
-    std::string combined = client_key + MAGIC_GUID;
-    unsigned char hash[SHA_DIGEST_LENGTH];
-    SHA1(reinterpret_cast<const unsigned char*>(combined.data()), combined.size(), hash);
-    
-    std::string accept = base64_encode(std::string(reinterpret_cast<char*>(hash), SHA_DIGEST_LENGTH));
-    
-    response = HANDSHAKE_HEADER + accept + "\r\n\r\n";
-    return std::unique_ptr<Connection>(); // Заменить на реальную реализацию
-}
 
-bool RFC6455Handler::parseHandshake(const std::string& request, std::string& key) const {
-    std::istringstream iss(request);
-    std::string line;
-    
-    // Проверяем первую строку
-    std::getline(iss, line);
-    if (line.find("GET") == std::string::npos) {
-        return false;
+    // permessage-deflate: принимаем первое подходящее предложение клиента
+    std::string offers;
+    for (size_t i = 0; i < parser.extensionCount(); ++i) {
+        if (i > 0) offers += ", ";
+        offers += parser.extension(data, i);
     }
-    
-    // Ищем необходимые заголовки
-    bool upgrade_websocket = false;
-    bool connection_upgrade = false;
-    
-    while (std::getline(iss, line)) {
-        if (line.find("Sec-WebSocket-Key:") != std::string::npos) {
-            size_t start = line.find(':') + 1;
-            while (start < line.size() && (line[start] == ' ' || line[start] == '\t')) start++;
-            size_t end = line.find('\r', start);
-            key = line.substr(start, end - start);
-        }
-        else if (line.find("Upgrade: websocket") != std::string::npos) {
-            upgrade_websocket = true;
-        }
-        else if (line.find("Connection: Upgrade") != std::string::npos) {
-            connection_upgrade = true;
-        }
+    DeflateParams deflate_params;
+    std::string accepted;
+    if (!offers.empty() &&
+        !PerMessageDeflate::negotiate(offers, deflate_config_, deflate_memory_, deflate_params, accepted)) {
+        accepted.clear();
     }
-    
-    return !key.empty() && upgrade_websocket && connection_upgrade;
+
+    std::vector<uint8_t> upgrade = Handshake::response(parser.key(data), accepted);
+    response.assign(upgrade.begin(), upgrade.end());
+    return std::unique_ptr<Connection>(); // Заменить на реальную реализацию
 }
 
-void RFC6455Handler::handleData(Connection* connection, const std::vector<uint8_t>& data) {
+void RFC6455Handler::handleData(Connection* connection, uint8_t* data, size_t size) {
     if (!connection) return;
     
     try {
         FrameHeader header;
-        if (!Frame::parseHeader(data, header)) {
+        if (!Frame::parseHeader(data, size, header)) {
             throw std::runtime_error("Invalid frame header");
         }
         
@@ -102,30 +56,21 @@ void RFC6455Handler::handleData(Connection* connection, const std::vector<uint8_
             return;
         }
         
-        const size_t header_size = Frame::headerSize(header);
-        if (data.size() < header_size + header.payload_length) {
+        const size_t header_size = header.header_size;
+        if (size < header_size + header.payload_length) {
             throw std::runtime_error("Incomplete frame");
         }
         
-        std::vector<uint8_t> payload(
-            data.begin() + header_size,
-            data.begin() + header_size + header.payload_length
-        );
-        
-        std::string message = Frame::decodePayload(header, payload);
+        // Маска снимается на месте, payload дальше идёт без копий
+        uint8_t* payload = data + header_size;
+        const size_t length = static_cast<size_t>(header.payload_length);
+        Frame::unmask(header, payload, length);
+        const MessageView message{header.opcode, payload, length};
         
         switch (header.opcode) {
             case Opcode::Text:
-                // Используем публичный метод setMessageCallback для доступа к коллбэку
-                connection->setMessageCallback([this, connection](const std::string& msg) {
-                    if (connection) {
-                        // Обработка сообщения
-                    }
-                });
-                break;
-                
             case Opcode::Binary:
-                // Обработка бинарных данных
+                connection->dispatch(message);
                 break;
                 
             case Opcode::Close:
@@ -133,7 +78,7 @@ void RFC6455Handler::handleData(Connection* connection, const std::vector<uint8_
                 break;
                 
             case Opcode::Ping:
-                connection->sendPong(message);  // Прямой вызов публичного метода
+                connection->sendPong(message.text());
                 break;
                 
             case Opcode::Pong:
@@ -1,29 +1,39 @@
 #pragma once
 
 #include "frame.h"
+#include "deflate.h"
+#include "message.h"
 #include <memory>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace websocket {
 
 class Connection {
 public:
-    using MessageCallback = std::function<void(const std::string&)>;
+    // view валиден только на время вызова; сохранить — MessageView::own()
+    using MessageCallback = std::function<void(const MessageView&)>;
     using CloseCallback = std::function<void()>;
     using ErrorCallback = std::function<void(const std::string&)>;
 
     virtual ~Connection() = default;
     
-    virtual void sendText(const std::string& message) = 0;
-    virtual void sendPong(const std::string& message) = 0;
+    virtual void sendText(std::string_view message) = 0;
+    virtual void sendBinary(const uint8_t* data, size_t size) = 0;
+    virtual void sendPong(std::string_view message) = 0;
     virtual void close(uint16_t code = 1000, const std::string& reason = "") = 0;
     
     void setMessageCallback(MessageCallback cb) { on_message_ = std::move(cb); }
     void setCloseCallback(CloseCallback cb) { on_close_ = std::move(cb); }
     void setErrorCallback(ErrorCallback cb) { on_error_ = std::move(cb); }
 
+    // Передаёт принятое сообщение приложению
+    void dispatch(const MessageView& message) {
+        if (on_message_) on_message_(message);
+    }
+
 protected:
     MessageCallback on_message_;
     CloseCallback on_close_;
@@ -38,14 +48,18 @@ public:
         const std::string& request,
         std::string& response) = 0;
     
+    // data — один фрейм; маска снимается на месте
     virtual void handleData(
         Connection* connection,
-        const std::vector<uint8_t>& data) = 0;
+        uint8_t* data,
+        size_t size) = 0;
 };
 
 class RFC6455Handler : public Handler {
 public:
-    explicit RFC6455Handler(size_t max_frame_size = Frame::MAX_FRAME_SIZE);
+    explicit RFC6455Handler(size_t max_frame_size = Frame::MAX_FRAME_SIZE,
+                            const DeflateConfig& deflate = DeflateConfig{},
+                            DeflateMemory* deflate_memory = nullptr);
     
     std::unique_ptr<Connection> handleHandshake(
         const std::string& request,
@@ -53,13 +67,13 @@ public:
     
     void handleData(
         Connection* connection,
-        const std::vector<uint8_t>& data) override;
+        uint8_t* data,
+        size_t size) override;
 
 private:
-    bool parseHandshake(const std::string& request, std::string& key) const;
-    std::string generateResponse(const std::string& key) const;
-    
     const size_t max_frame_size_;
+    const DeflateConfig deflate_config_;
+    DeflateMemory* deflate_memory_;
 };
 
 } // namespace websocket
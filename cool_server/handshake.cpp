@@ -0,0 +1,276 @@
+#include "handshake.h"
+#include <algorithm>
+#include <cstring>
+
+namespace websocket {
+
+namespace {
+    constexpr std::string_view MAGIC_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    constexpr std::string_view RESPONSE_HEAD = "HTTP/1.1 101 Switching Protocols\r\n"
+                                               "Upgrade: websocket\r\n"
+                                               "Connection: Upgrade\r\n"
+                                               "Sec-WebSocket-Accept: ";
+    constexpr std::string_view EXTENSIONS_HEADER = "Sec-WebSocket-Extensions: ";
+    constexpr char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    // Ключ — base64 от 16 байт
+    constexpr size_t KEY_SIZE = 24;
+
+    char lower(char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    bool iequals(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (lower(a[i]) != lower(b[i])) return false;
+        }
+        return true;
+    }
+
+    std::string_view trim(std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+        return s;
+    }
+
+    // Есть ли token в списке через запятую ("keep-alive, Upgrade")
+    bool hasToken(std::string_view list, std::string_view token) {
+        while (!list.empty()) {
+            const size_t comma = list.find(',');
+            if (iequals(trim(list.substr(0, comma)), token)) return true;
+            if (comma == std::string_view::npos) break;
+            list.remove_prefix(comma + 1);
+        }
+        return false;
+    }
+
+    bool isBase64(char c) {
+        return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/';
+    }
+
+    bool validKey(std::string_view key) {
+        if (key.size() != KEY_SIZE || key[22] != '=' || key[23] != '=') return false;
+        return std::all_of(key.begin(), key.begin() + 22, isBase64);
+    }
+
+    size_t base64Encode(const uint8_t* data, size_t len, char* out) {
+        size_t n = 0;
+        size_t i = 0;
+        for (; i + 3 <= len; i += 3) {
+            const uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+            out[n++] = BASE64[v >> 18];
+            out[n++] = BASE64[(v >> 12) & 0x3F];
+            out[n++] = BASE64[(v >> 6) & 0x3F];
+            out[n++] = BASE64[v & 0x3F];
+        }
+        if (i < len) {
+            const uint32_t v = (data[i] << 16) | (i + 1 < len ? data[i + 1] << 8 : 0);
+            out[n++] = BASE64[v >> 18];
+            out[n++] = BASE64[(v >> 12) & 0x3F];
+            out[n++] = i + 1 < len ? BASE64[(v >> 6) & 0x3F] : '=';
+            out[n++] = '=';
+        }
+        return n;
+    }
+
+    uint32_t rotl(uint32_t x, int n) {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    void sha1Block(uint32_t state[5], const uint8_t* block) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t(block[4 * i]) << 24) | (uint32_t(block[4 * i + 1]) << 16) |
+                   (uint32_t(block[4 * i + 2]) << 8) | uint32_t(block[4 * i + 3]);
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        // Четыре группы по 20 раундов: функция и константа в каждой своя
+        auto round = [&](uint32_t f, uint32_t k, uint32_t word) {
+            const uint32_t temp = rotl(a, 5) + f + e + k + word;
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        };
+        for (int i = 0; i < 20; ++i) round((b & c) | (~b & d), 0x5A827999, w[i]);
+        for (int i = 20; i < 40; ++i) round(b ^ c ^ d, 0x6ED9EBA1, w[i]);
+        for (int i = 40; i < 60; ++i) round((b & c) | (b & d) | (c & d), 0x8F1BBCDC, w[i]);
+        for (int i = 60; i < 80; ++i) round(b ^ c ^ d, 0xCA62C1D6, w[i]);
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+
+    void append(std::vector<uint8_t>& out, std::string_view s) {
+        out.insert(out.end(), s.begin(), s.end());
+    }
+}
+
+HandshakeParser::Result HandshakeParser::parse(const uint8_t* data, size_t size) {
+    if (status_) return Result::Error;
+    if (request_size_) return Result::Done;
+
+    const char* text = reinterpret_cast<const char*>(data);
+    const size_t limit = std::min(size, MAX_REQUEST_SIZE);
+    while (true) {
+        // Хвост без перевода строки уже просмотрен в прошлый раз
+        const size_t from = std::max(line_start_, searched_);
+        const void* found = from < limit ? std::memchr(text + from, '\n', limit - from) : nullptr;
+        if (!found) {
+            searched_ = limit;
+            return size >= MAX_REQUEST_SIZE ? fail(431) : Result::Incomplete;
+        }
+
+        const size_t end = static_cast<size_t>(static_cast<const char*>(found) - text);
+        const size_t offset = line_start_;
+        size_t length = end - offset;
+        if (length > 0 && text[end - 1] == '\r') --length;
+        const std::string_view line(text + offset, length);
+        line_start_ = end + 1;
+
+        if (!request_line_) {
+            // Пустые строки перед запросом допускаются (RFC 7230, 3.5)
+            if (line.empty()) continue;
+            if (!parseRequestLine(line)) return fail(400);
+            request_line_ = true;
+            continue;
+        }
+        if (!line.empty()) {
+            if (!parseHeader(line, offset)) return fail(400);
+            continue;
+        }
+
+        // Пустая строка — заголовки закончились
+        if (version_mismatch_) return fail(426);
+        if (!host_ || !upgrade_ || !connection_ || !version_ || !has_key_) return fail(400);
+        request_size_ = line_start_;
+        return Result::Done;
+    }
+}
+
+bool HandshakeParser::parseRequestLine(std::string_view line) {
+    // GET <цель> HTTP/1.1 и новее
+    if (line.substr(0, 4) != "GET ") return false;
+    const size_t space = line.find(' ', 4);
+    if (space == std::string_view::npos || space == 4) return false;
+    const std::string_view version = line.substr(space + 1);
+    return version.size() == 8 && version.substr(0, 7) == "HTTP/1." && version[7] >= '1' && version[7] <= '9';
+}
+
+bool HandshakeParser::parseHeader(std::string_view line, size_t offset) {
+    // Продолжение заголовка на следующей строке (obs-fold) не поддерживаем
+    if (line.front() == ' ' || line.front() == '\t') return false;
+    const size_t colon = line.find(':');
+    if (colon == std::string_view::npos || colon == 0) return false;
+    const std::string_view name = line.substr(0, colon);
+    if (name.find_first_of(" \t") != std::string_view::npos) return false;
+    const std::string_view value = trim(line.substr(colon + 1));
+    const Field field{offset + static_cast<size_t>(value.data() - line.data()), value.size()};
+
+    if (iequals(name, "Host")) {
+        host_ = true;
+    } else if (iequals(name, "Upgrade")) {
+        upgrade_ = upgrade_ || hasToken(value, "websocket");
+    } else if (iequals(name, "Connection")) {
+        connection_ = connection_ || hasToken(value, "upgrade");
+    } else if (iequals(name, "Sec-WebSocket-Version")) {
+        version_ = true;
+        version_mismatch_ = version_mismatch_ || value != "13";
+    } else if (iequals(name, "Sec-WebSocket-Key")) {
+        if (has_key_ || !validKey(value)) return false;
+        key_ = field;
+        has_key_ = true;
+    } else if (iequals(name, "Sec-WebSocket-Extensions")) {
+        if (extension_count_ < MAX_EXTENSION_HEADERS && !value.empty()) {
+            extensions_[extension_count_++] = field;
+        }
+    }
+    return true;
+}
+
+HandshakeParser::Result HandshakeParser::fail(int status) {
+    status_ = status;
+    return Result::Error;
+}
+
+void Handshake::sha1(const uint8_t* data, size_t len, uint8_t out[20]) {
+    uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) sha1Block(state, data + i);
+
+    // Хвост, 0x80 и длина в битах: один или два блока
+    uint8_t tail[128] = {};
+    const size_t rest = len - i;
+    std::memcpy(tail, data + i, rest);
+    tail[rest] = 0x80;
+    const size_t tail_size = rest + 9 <= 64 ? 64 : 128;
+    const uint64_t bits = static_cast<uint64_t>(len) * 8;
+    for (int k = 0; k < 8; ++k) {
+        tail[tail_size - 1 - k] = static_cast<uint8_t>(bits >> (8 * k));
+    }
+    sha1Block(state, tail);
+    if (tail_size == 128) sha1Block(state, tail + 64);
+
+    for (int k = 0; k < 5; ++k) {
+        out[4 * k] = static_cast<uint8_t>(state[k] >> 24);
+        out[4 * k + 1] = static_cast<uint8_t>(state[k] >> 16);
+        out[4 * k + 2] = static_cast<uint8_t>(state[k] >> 8);
+        out[4 * k + 3] = static_cast<uint8_t>(state[k]);
+    }
+}
+
+void Handshake::acceptKey(std::string_view key, char out[ACCEPT_KEY_SIZE]) {
+    // Ключ из разобранного запроса всегда 24 символа; длиннее не бывает
+    uint8_t input[KEY_SIZE + MAGIC_GUID.size()];
+    const size_t key_size = std::min(key.size(), KEY_SIZE);
+    std::memcpy(input, key.data(), key_size);
+    std::memcpy(input + key_size, MAGIC_GUID.data(), MAGIC_GUID.size());
+
+    uint8_t hash[20];
+    sha1(input, key_size + MAGIC_GUID.size(), hash);
+    base64Encode(hash, sizeof(hash), out);
+}
+
+std::vector<uint8_t> Handshake::response(std::string_view key, const std::string& extensions) {
+    char accept[ACCEPT_KEY_SIZE];
+    acceptKey(key, accept);
+
+    std::vector<uint8_t> out;
+    out.reserve(RESPONSE_HEAD.size() + ACCEPT_KEY_SIZE + EXTENSIONS_HEADER.size() + extensions.size() + 6);
+    append(out, RESPONSE_HEAD);
+    append(out, std::string_view(accept, ACCEPT_KEY_SIZE));
+    append(out, "\r\n");
+    if (!extensions.empty()) {
+        append(out, EXTENSIONS_HEADER);
+        append(out, extensions);
+        append(out, "\r\n");
+    }
+    append(out, "\r\n");
+    return out;
+}
+
+std::vector<uint8_t> Handshake::rejection(int status) {
+    std::vector<uint8_t> out;
+    switch (status) {
+        case 426:
+            append(out, "HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: 13\r\n");
+            break;
+        case 431:
+            append(out, "HTTP/1.1 431 Request Header Fields Too Large\r\n");
+            break;
+        default:
+            append(out, "HTTP/1.1 400 Bad Request\r\n");
+            break;
+    }
+    append(out, "Connection: close\r\nContent-Length: 0\r\n\r\n");
+    return out;
+}
+
+} // namespace websocket
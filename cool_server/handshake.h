@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace websocket {
+
+// Разбор запроса на апгрейд (RFC 6455, 4.2.1) прямо в приёмном буфере.
+// Запрос копится у вызывающего, parse зовётся после каждого чтения
+// со всем, что пришло с начала запроса. Каждая полная строка разбирается
+// один раз, значения заголовков хранятся смещениями от начала запроса —
+// парсер ничего не выделяет. Имена заголовков и токены Upgrade/Connection
+// сравниваются без учёта регистра
+class HandshakeParser {
+public:
+    enum class Result { Incomplete, Done, Error };
+
+    // Запрос длиннее этого не разбирается: ответ 431
+    static constexpr size_t MAX_REQUEST_SIZE = 8 * 1024;
+    // Сколько заголовков Sec-WebSocket-Extensions запоминается; остальные пропускаются
+    static constexpr size_t MAX_EXTENSION_HEADERS = 4;
+
+    Result parse(const uint8_t* data, size_t size);
+    void reset() { *this = HandshakeParser(); }
+
+    // После Done: длина запроса вместе с пустой строкой.
+    // Всё, что за ней, — уже фреймы
+    size_t requestSize() const { return request_size_; }
+    // Значения из того же буфера, что передавался в parse
+    std::string_view key(const uint8_t* data) const { return view(data, key_); }
+    size_t extensionCount() const { return extension_count_; }
+    std::string_view extension(const uint8_t* data, size_t i) const { return view(data, extensions_[i]); }
+
+    // После Error: код ответа (400, 426 или 431)
+    int status() const { return status_; }
+
+private:
+    struct Field {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    static std::string_view view(const uint8_t* data, const Field& field) {
+        return {reinterpret_cast<const char*>(data) + field.offset, field.length};
+    }
+
+    bool parseRequestLine(std::string_view line);
+    bool parseHeader(std::string_view line, size_t offset);
+    Result fail(int status);
+
+    size_t line_start_ = 0;   // Начало первой неразобранной строки
+    size_t searched_ = 0;     // До сюда перевода строки точно нет
+    size_t request_size_ = 0;
+    int status_ = 0;
+    bool request_line_ = false;
+    bool host_ = false;
+    bool upgrade_ = false;
+    bool connection_ = false;
+    bool version_ = false;
+    bool version_mismatch_ = false;
+    bool has_key_ = false;
+    Field key_;
+    Field extensions_[MAX_EXTENSION_HEADERS];
+    size_t extension_count_ = 0;
+};
+
+// Ответы на рукопожатие
+class Handshake {
+public:
+    static constexpr size_t ACCEPT_KEY_SIZE = 28;
+
+    // Sec-WebSocket-Accept: base64(SHA-1(ключ + GUID)) без промежуточных строк
+    static void acceptKey(std::string_view key, char out[ACCEPT_KEY_SIZE]);
+    // 101 Switching Protocols; extensions — согласованные расширения или пусто
+    static std::vector<uint8_t> response(std::string_view key, const std::string& extensions);
+    // Отказ с Connection: close; на 426 добавляется поддерживаемая версия
+    static std::vector<uint8_t> rejection(int status);
+
+    static void sha1(const uint8_t* data, size_t len, uint8_t out[20]);
+};
+
+} // namespace websocket
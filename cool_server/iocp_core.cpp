@@ -1,12 +1,78 @@
 #include "iocp_core.h"
+#include "socket_utils.h"
+#include "thread_affinity.h"
 #include <iostream>
 
-IOCPCore::IOCPCore() 
-    : iocp_handle_(INVALID_HANDLE_VALUE), 
+thread_local IOCPCore* IOCPCore::current_ = nullptr;
+
+void IOCPCore::dispatch(bool ok, DWORD bytes, ULONG_PTR key, LPOVERLAPPED overlapped, DWORD error) {
+    // Пустой ключ или overlapped — служебное пробуждение (stop) или таймаут
+    if (key == 0 || overlapped == nullptr) return;
+
+    reinterpret_cast<CompletionHandler*>(key)->onCompletion(bytes, overlapped, ok ? 0 : error);
+}
+
+void IOCPCore::setTimer(Timer* timer, std::chrono::milliseconds delay) {
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(timers_mutex_);
+        was_empty = timers_.empty();
+        timers_.schedule(timer, delay);
+        armed_timers_ = timers_.size();
+    }
+
+    // Потоки ядра могли уснуть без таймаута — будим один, он пересчитает ожидание
+    if (was_empty && is_running_) postCompletion(0, nullptr, nullptr);
+}
+
+void IOCPCore::cancelTimer(Timer* timer) {
+    std::lock_guard<std::mutex> lock(timers_mutex_);
+    timers_.cancel(timer);
+    armed_timers_ = timers_.size();
+}
+
+int IOCPCore::timerTimeout() {
+    if (armed_timers_.load(std::memory_order_relaxed) == 0) return -1;
+    std::lock_guard<std::mutex> lock(timers_mutex_);
+    return timers_.timeoutMs(TimerWheel::Clock::now());
+}
+
+void IOCPCore::runTimers() {
+    if (armed_timers_.load(std::memory_order_relaxed) == 0) return;
+
+    static thread_local std::vector<TimerNode*> expired;
+    static thread_local std::vector<std::pair<Timer*, std::shared_ptr<void>>> fired;
+    {
+        // Колесо уже крутит другой поток — ему и вызывать владельцев
+        std::unique_lock<std::mutex> lock(timers_mutex_, std::try_to_lock);
+        if (!lock.owns_lock()) return;
+
+        expired.clear();
+        timers_.advance(TimerWheel::Clock::now(), expired);
+        armed_timers_ = timers_.size();
+
+        // Владельца захватываем под мьютексом колеса: пока он жив,
+        // снять таймер и переиспользовать память никто не успеет
+        for (TimerNode* node : expired) {
+            auto* timer = static_cast<Timer*>(node);
+            if (auto owner = timer->owner.lock()) fired.emplace_back(timer, std::move(owner));
+        }
+    }
+
+    for (auto& entry : fired) {
+        entry.first->handler->onCompletion(0, &entry.first->overlapped, 0);
+    }
+    fired.clear();
+}
+
+#ifdef _WIN32
+
+IOCPCore::IOCPCore()
+    : iocp_handle_(INVALID_HANDLE_VALUE),
       is_running_(false) {}
 
-IOCPCore::~IOCPCore() { 
-    stop(); 
+IOCPCore::~IOCPCore() {
+    stop();
 }
 
 bool IOCPCore::setup() {
@@ -18,56 +84,54 @@ bool IOCPCore::setup() {
     return true;
 }
 
-void IOCPCore::associateSocket(SOCKET socket, ULONG_PTR key) {
+void IOCPCore::associateSocket(SOCKET socket, CompletionHandler* handler) {
+    ULONG_PTR key = reinterpret_cast<ULONG_PTR>(handler);
     if (CreateIoCompletionPort((HANDLE)socket, iocp_handle_, key, 0) == NULL) {
         std::cerr << "Failed to associate socket: " << GetLastError() << "\n";
     }
 }
 
-void IOCPCore::runWorkerThreads(int count) {
+void IOCPCore::runWorkerThreads(int count, const std::vector<int>& cpus) {
     is_running_ = true;
     workers_.reserve(count);
-    
+
     for (int i = 0; i < count; ++i) {
-        workers_.emplace_back([this]() {
+        const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        workers_.emplace_back([this, cpu]() {
+            if (cpu >= 0) ThreadAffinity::pinCurrentThread(cpu);
+            current_ = this;
+            BusyPoller poller(busy_poll_, busy_poll_stats_);
             while (is_running_) {
                 DWORD bytes = 0;
                 ULONG_PTR key = 0;
                 LPOVERLAPPED overlapped = nullptr;
+                BOOL ok = FALSE;
+                DWORD error = 0;
 
-                BOOL ok = GetQueuedCompletionStatus(
-                    iocp_handle_, &bytes, &key, &overlapped, INFINITE);
+                // Ждём не дольше, чем до ближайшего таймера. Сначала опрос с
+                // нулевым таймаутом: пустой порт отвечает WAIT_TIMEOUT без overlapped
+                int timeout = timerTimeout();
+                const int found = poller.spin([&] {
+                    ok = GetQueuedCompletionStatus(iocp_handle_, &bytes, &key, &overlapped, 0);
+                    syscalls_.fetch_add(1, std::memory_order_relaxed);
+                    error = ok ? 0 : GetLastError();
+                    return ok || overlapped != nullptr || error != WAIT_TIMEOUT ? 1 : 0;
+                }, timeout);
+                if (!found) {
+                    poller.park();
+                    ok = GetQueuedCompletionStatus(
+                        iocp_handle_, &bytes, &key, &overlapped,
+                        timeout < 0 ? INFINITE : static_cast<DWORD>(timeout));
+                    syscalls_.fetch_add(1, std::memory_order_relaxed);
+                    error = ok ? 0 : GetLastError();
+                }
 
                 if (!is_running_) break;
 
-                if (!ok) {
-                    DWORD error = GetLastError();
-                    std::lock_guard<std::mutex> lock(callbacks_mutex_);
-                    if (overlapped) {
-                        // Определяем тип операции по ключу
-                        if (key == static_cast<ULONG_PTR>(CompletionKeyType::READ) && read_cb_) {
-                            read_cb_(error, key, overlapped);
-                        } else if (key == static_cast<ULONG_PTR>(CompletionKeyType::WRITE) && write_cb_) {
-                            write_cb_(error, key, overlapped);
-                        }
-                    }
-                    continue;
-                }
-
-                if (!overlapped) continue;
-
-                std::lock_guard<std::mutex> lock(callbacks_mutex_);
-                switch (static_cast<CompletionKeyType>(key)) {
-                    case CompletionKeyType::CONNECTION:
-                        if (connection_cb_) connection_cb_(bytes, key, overlapped);
-                        break;
-                    case CompletionKeyType::READ:
-                        if (read_cb_) read_cb_(bytes, key, overlapped);
-                        break;
-                    case CompletionKeyType::WRITE:
-                        if (write_cb_) write_cb_(bytes, key, overlapped);
-                        break;
-                }
+                // WAIT_TIMEOUT приходит с пустым overlapped и отсеивается в dispatch
+                if (!ok && error == 0) error = ERROR_OPERATION_ABORTED;
+                dispatch(ok != FALSE, bytes, key, overlapped, error);
+                runTimers();
             }
         });
     }
@@ -75,22 +139,66 @@ void IOCPCore::runWorkerThreads(int count) {
 
 void IOCPCore::stop() {
     if (!is_running_) return;
-    
+
     is_running_ = false;
     for (size_t i = 0; i < workers_.size(); ++i) {
         PostQueuedCompletionStatus(iocp_handle_, 0, 0, nullptr);
     }
-    
+
     for (auto& thread : workers_) {
         if (thread.joinable()) thread.join();
     }
-    
+
     if (iocp_handle_ != INVALID_HANDLE_VALUE) {
         CloseHandle(iocp_handle_);
         iocp_handle_ = INVALID_HANDLE_VALUE;
     }
 }
 
-void IOCPCore::postCompletion(DWORD bytes, ULONG_PTR key, LPOVERLAPPED overlapped) {
-    PostQueuedCompletionStatus(iocp_handle_, bytes, key, overlapped);
-}
\ No newline at end of file
+void IOCPCore::postCompletion(DWORD bytes, CompletionHandler* handler, LPOVERLAPPED overlapped) {
+    syscalls_.fetch_add(1, std::memory_order_relaxed);
+    PostQueuedCompletionStatus(iocp_handle_, bytes, reinterpret_cast<ULONG_PTR>(handler), overlapped);
+}
+
+bool IOCPCore::zeroByteReads() {
+    return true;
+}
+
+bool IOCPCore::asyncRecv(SOCKET socket, WSABUF* buffers, DWORD count, LPOVERLAPPED overlapped) {
+    syscalls_.fetch_add(1, std::memory_order_relaxed);
+    DWORD flags = 0;
+    if (WSARecv(socket, buffers, count, nullptr, &flags, overlapped, nullptr) == SOCKET_ERROR) {
+        return WSAGetLastError() == WSA_IO_PENDING;
+    }
+    return true;
+}
+
+bool IOCPCore::asyncSend(SOCKET socket, WSABUF* buffers, DWORD count, LPOVERLAPPED overlapped) {
+    syscalls_.fetch_add(1, std::memory_order_relaxed);
+    if (WSASend(socket, buffers, count, nullptr, 0, overlapped, nullptr) == SOCKET_ERROR) {
+        return WSAGetLastError() == WSA_IO_PENDING;
+    }
+    return true;
+}
+
+bool IOCPCore::asyncAccept(SOCKET listen_socket, AcceptOperation* op) {
+    ZeroMemory(&op->overlapped, sizeof(OVERLAPPED));
+    op->socket = SocketUtils::createSocket();
+    if (op->socket == INVALID_SOCKET) return false;
+
+    syscalls_.fetch_add(1, std::memory_order_relaxed);
+    if (!SocketUtils::acceptEx(listen_socket, op->socket, op->address_buffer,
+                               sizeof(op->address_buffer), &op->overlapped)) {
+        SocketUtils::closeSocket(op->socket);
+        op->socket = INVALID_SOCKET;
+        return false;
+    }
+    return true;
+}
+
+void IOCPCore::closeSocket(SOCKET socket) {
+    // Ядро само завершит висящие операции с ERROR_OPERATION_ABORTED
+    SocketUtils::closeSocket(socket);
+}
+
+#endif
@@ -1,55 +1,189 @@
 #pragma once
 
-#include <winsock2.h>
-#include <windows.h>
+#include "platform.h"
+#include "busy_poll.h"
+#include "coroutine_arena.h"
+#include "timer_wheel.h"
+#include <chrono>
 #include <memory>
-#include <functional>
 #include <atomic>
 #include <vector>
 #include <thread>
 #include <mutex>
 
+#ifndef _WIN32
+#include <deque>
+#include <shared_mutex>
+#include <unordered_map>
+#endif
+
+// Ядро ввода-вывода. На Windows — порт завершения (IOCP),
+// на Linux — edge-triggered epoll, который эмулирует модель завершений:
+// операция ставится через asyncRecv/asyncSend/asyncAccept,
+// а результат приходит в те же коллбэки, что и у IOCP.
+// С -DCOOL_SERVER_IO_URING на Linux вместо epoll собирается io_uring.
+//
+// Ключ завершения сокета — указатель на его CompletionHandler, поэтому
+// рабочий поток вызывает владельца напрямую, без общих коллбэков и мьютекса.
+
+// Буферы приёма io_uring (provided buffer ring), общие для сокетов цикла.
+// epoll и IOCP читают прямо в буферы операций и этих настроек не используют
+struct RecvRingConfig {
+    unsigned count = 4096;       // Округляется вверх до степени двойки, не больше 32768
+    unsigned size = 16 * 1024;   // Байт в буфере: не больше стольких за один CQE
+};
+
+// Владелец сокета, получающий завершения его операций
+class CompletionHandler {
+public:
+    virtual ~CompletionHandler() = default;
+
+    // error == 0 — операция успешна; overlapped указывает, какая именно
+    virtual void onCompletion(DWORD bytes, LPOVERLAPPED overlapped, DWORD error) = 0;
+};
+
 class IOCPCore {
 public:
-    enum class CompletionKeyType {
-        CONNECTION = 0xAAAA,  // Changed from 0xDEADBEEF for better readability
-        READ,
-        WRITE
+    // Контекст асинхронного accept. overlapped должен быть первым полем:
+    // по указателю на него коллбэк получает всю операцию
+    struct AcceptOperation {
+        OVERLAPPED overlapped;
+        SOCKET socket = INVALID_SOCKET;                // Принятый сокет
+        char address_buffer[2 * (sizeof(sockaddr_in) + 16)];
     };
 
-    using CompletionCallback = std::function<void(DWORD, ULONG_PTR, LPOVERLAPPED)>;
+    // Таймер цикла событий. По истечении владелец получает
+    // onCompletion(0, &timer->overlapped, 0) в рабочем потоке ядра
+    struct Timer : TimerNode {
+        OVERLAPPED overlapped{};
+        CompletionHandler* handler = nullptr;
+        std::weak_ptr<void> owner;  // Таймер срабатывает, только пока владелец жив
+    };
 
     IOCPCore();
     ~IOCPCore();
 
+    // Буферы приёма io_uring и узел NUMA их памяти (-1 — без привязки); до setup()
+    void setRecvRing(const RecvRingConfig& config, int node = -1) {
+        recv_ring_ = config;
+        memory_node_ = node;
+    }
     bool setup();
-    void associateSocket(SOCKET socket, ULONG_PTR key);
-    void runWorkerThreads(int count);
+    void associateSocket(SOCKET socket, CompletionHandler* handler);
+    // Опрос очереди без сна перед блокирующим ожиданием; задаётся до runWorkerThreads
+    void setBusyPoll(const BusyPollConfig& config) { busy_poll_ = config; }
+    const BusyPollStats& busyPollStats() const { return busy_poll_stats_; }
+    // Поток i закрепляется за процессором cpus[i % cpus.size()];
+    // пустой список — потоки не закрепляются
+    void runWorkerThreads(int count, const std::vector<int>& cpus = {});
     void stop();
-    void postCompletion(DWORD bytes, ULONG_PTR key, LPOVERLAPPED overlapped);
+    void postCompletion(DWORD bytes, CompletionHandler* handler, LPOVERLAPPED overlapped);
 
-    void setConnectionCallback(CompletionCallback cb) { 
-        std::lock_guard<std::mutex> lock(callbacks_mutex_);
-        connection_cb_ = cb; 
-    }
-    
-    void setReadCallback(CompletionCallback cb) { 
-        std::lock_guard<std::mutex> lock(callbacks_mutex_);
-        read_cb_ = cb; 
-    }
+    // Асинхронные операции над сокетом, привязанным через associateSocket.
+    // asyncRecv с буферами нулевой длины только ждёт данных (или FIN) и
+    // завершается с 0 байт, ничего не забрав из сокета
+    bool asyncRecv(SOCKET socket, WSABUF* buffers, DWORD count, LPOVERLAPPED overlapped);
+    // Стоит ли простаивающим соединениям ждать данных чтением нулевой
+    // длины: у IOCP и epoll это освобождает буфер операции, у io_uring — нет
+    static bool zeroByteReads();
+    bool asyncSend(SOCKET socket, WSABUF* buffers, DWORD count, LPOVERLAPPED overlapped);
+    bool asyncAccept(SOCKET listen_socket, AcceptOperation* op);
 
-    void setWriteCallback(CompletionCallback cb) { 
-        std::lock_guard<std::mutex> lock(callbacks_mutex_);
-        write_cb_ = cb; 
-    }
+    // Закрывает сокет; незавершённые операции приходят с ошибкой
+    void closeSocket(SOCKET socket);
+
+    // Взводит таймер (взведённый — перевзводит); handler и owner заполняет вызывающий.
+    // Колесо общее на ядро, постановка и снятие — O(1)
+    void setTimer(Timer* timer, std::chrono::milliseconds delay);
+    void cancelTimer(Timer* timer);
+
+    // Число системных вызовов ввода-вывода, сделанных ядром (для бенчмарков)
+    uint64_t syscallCount() const { return syscalls_.load(std::memory_order_relaxed); }
+
+    // Ядро, чей рабочий поток сейчас выполняется; nullptr — поток чужой
+    static IOCPCore* current() { return current_; }
+    // Кадры корутин, запущенных в потоках этого ядра
+    CoroutineArena& coroutineArena() { return coroutines_; }
 
 private:
+    // Общая для всех бэкендов доставка завершения владельцу по ключу
+    void dispatch(bool ok, DWORD bytes, ULONG_PTR key, LPOVERLAPPED overlapped, DWORD error);
+
+    // Сколько рабочий поток может ждать событий, не пропустив таймер; -1 — без ограничения
+    int timerTimeout();
+    // Прокручивает колесо и вызывает владельцев сработавших таймеров
+    void runTimers();
+
+#ifndef _WIN32
+    struct Completion {
+        bool ok;
+        DWORD bytes;
+        ULONG_PTR key;
+        LPOVERLAPPED overlapped;
+        DWORD error;
+    };
+#endif
+
+#ifdef _WIN32
     HANDLE iocp_handle_;
+#elif defined(COOL_SERVER_IO_URING)
+    // Состояние io_uring-бэкенда целиком живёт в uring_core.cpp
+    struct UringState;
+    std::unique_ptr<UringState> uring_;
+#else
+    enum class OpType { Recv, Send, Accept };
+
+    struct PendingOp {
+        OpType type;
+        LPOVERLAPPED overlapped;
+        std::vector<WSABUF> buffers;
+        size_t transferred = 0;
+        AcceptOperation* accept = nullptr;
+    };
+
+    struct SocketState {
+        SOCKET socket;
+        ULONG_PTR key;
+        std::mutex mutex;
+        std::deque<PendingOp> reads;   // recv и accept
+        std::deque<PendingOp> writes;
+    };
+
+    enum class OpStatus { Done, WouldBlock, Failed };
+
+    std::shared_ptr<SocketState> findSocket(SOCKET socket);
+    OpStatus tryOperation(SocketState& state, PendingOp& op, DWORD& error);
+    void handleEvents(SOCKET socket, uint32_t events);
+    void enqueueCompletion(const Completion& completion);
+    void drainCompletions();
+    void drainLocalCompletions();
+
+    // Операции, завершившиеся сразу внутри коллбэка рабочего потока,
+    // разбираются этим же потоком без прохода через eventfd
+    static thread_local IOCPCore* local_owner_;
+    static thread_local std::vector<Completion>* local_completions_;
+
+    int epoll_fd_;
+    int event_fd_;
+    std::shared_mutex sockets_mutex_;
+    std::unordered_map<SOCKET, std::shared_ptr<SocketState>> sockets_;
+    std::mutex completions_mutex_;
+    std::deque<Completion> completions_;
+#endif
+
+    std::mutex timers_mutex_;
+    TimerWheel timers_;
+    std::atomic<size_t> armed_timers_{0};
+
     std::atomic<bool> is_running_;
+    std::atomic<uint64_t> syscalls_{0};
+    BusyPollConfig busy_poll_;
+    RecvRingConfig recv_ring_;
+    int memory_node_ = -1;
+    BusyPollStats busy_poll_stats_;
     std::vector<std::thread> workers_;
-    std::mutex callbacks_mutex_;
-    
-    CompletionCallback connection_cb_;
-    CompletionCallback read_cb_;
-    CompletionCallback write_cb_;  // Новый коллбэк
-};
\ No newline at end of file
+
+    static thread_local IOCPCore* current_;
+    // Последним полем: разрушается первой, пока колесо таймеров живо
+    CoroutineArena coroutines_;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "frame.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace websocket {
+
+class Message;
+
+// Принятое сообщение без копирования: указывает прямо в приёмный буфер
+// или в буфер сборки фрагментов. Валидно только на время коллбэка;
+// чтобы сохранить данные, нужна владеющая копия own()
+struct MessageView {
+    Opcode opcode = Opcode::Text;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    bool isText() const { return opcode == Opcode::Text; }
+    bool isBinary() const { return opcode == Opcode::Binary; }
+    std::string_view text() const { return {reinterpret_cast<const char*>(data), size}; }
+
+    Message own() const;
+};
+
+// Владеющая копия сообщения — по явному запросу приложения
+class Message {
+public:
+    Message() = default;
+    explicit Message(const MessageView& view)
+        : opcode_(view.opcode), data_(view.text()) {}
+
+    Opcode opcode() const { return opcode_; }
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(data_.data()); }
+    size_t size() const { return data_.size(); }
+    std::string_view text() const { return data_; }
+    MessageView view() const { return {opcode_, data(), size()}; }
+
+private:
+    Opcode opcode_ = Opcode::Text;
+    std::string data_;
+};
+
+inline Message MessageView::own() const {
+    return Message(*this);
+}
+
+} // namespace websocket
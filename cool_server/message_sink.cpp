@@ -0,0 +1,63 @@
+#include "message_sink.h"
+#include <iostream>
+
+namespace websocket {
+
+FileSink::FileSink(std::string path, DoneCallback on_done)
+    : path_(std::move(path)), on_done_(std::move(on_done)) {}
+
+FileSink::~FileSink() {
+    if (!done_) abort();
+}
+
+bool FileSink::open() {
+    if (file_) return true;
+    file_ = std::fopen(path_.c_str(), "wb");
+    if (!file_) {
+        std::cerr << "FileSink: cannot create " << path_ << "\n";
+        return false;
+    }
+    // Куски и так крупные: пишем без промежуточного буфера stdio
+    std::setvbuf(file_, nullptr, _IONBF, 0);
+    return true;
+}
+
+bool FileSink::write(const uint8_t* data, size_t size) {
+    if (done_ || !open()) return false;
+    if (std::fwrite(data, 1, size, file_) != size) {
+        std::cerr << "FileSink: write to " << path_ << " failed\n";
+        return false;
+    }
+    written_ += size;
+    return true;
+}
+
+void FileSink::finish() {
+    if (done_) return;
+    // Пустое сообщение — пустой файл
+    if (!open()) {
+        done_ = true;
+        return;
+    }
+    done_ = true;
+    const bool ok = std::fclose(file_) == 0;
+    file_ = nullptr;
+    if (!ok) {
+        std::cerr << "FileSink: close of " << path_ << " failed\n";
+        std::remove(path_.c_str());
+        return;
+    }
+    if (on_done_) on_done_(path_, written_);
+}
+
+void FileSink::abort() {
+    if (done_) return;
+    done_ = true;
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+        std::remove(path_.c_str());
+    }
+}
+
+} // namespace websocket
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "frame.h"
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace websocket {
+
+// Приёмник крупного входящего сообщения: данные приходят кусками по мере
+// чтения из сокета и в памяти соединения целиком не копятся.
+// Вызовы идут из цикла событий соединения, по одному за раз
+class MessageSink {
+public:
+    virtual ~MessageSink() = default;
+
+    // Очередной кусок сообщения (маска снята, сжатие распаковано).
+    // false — приёмник отказал, соединение закрывается с 1011
+    virtual bool write(const uint8_t* data, size_t size) = 0;
+    // Сообщение принято целиком
+    virtual void finish() = 0;
+    // Сообщение оборвано: ошибка протокола, отказ или закрытие соединения
+    virtual void abort() = 0;
+};
+
+// Создаёт приёмник для сообщения, которое пойдёт потоком. size — длина
+// первого фрейма, если он же последний, иначе 0 (длина заранее неизвестна).
+// nullptr — сообщение не принимаем, соединение закрывается с 1009
+using SinkFactory = std::function<std::unique_ptr<MessageSink>(Opcode opcode, uint64_t size)>;
+
+// Когда сообщение уходит в приёмник вместо сборки в памяти
+struct StreamingConfig {
+    // Фрейм длиннее этого принимается по частям, сборка длиннее — сбрасывается в приёмник
+    size_t threshold = 1024 * 1024;
+    // По сколько байт payload отдавать приёмнику; столько же и читается из сокета
+    size_t chunk_size = 64 * 1024;
+    // Предел сообщения, идущего потоком; больше — закрытие с 1009
+    uint64_t max_message_size = 4ull * 1024 * 1024 * 1024;
+};
+
+// Пишет сообщение в файл. Файл создаётся на первом куске; при обрыве
+// недописанный файл удаляется. on_done получает путь и длину
+// принятого сообщения
+class FileSink : public MessageSink {
+public:
+    using DoneCallback = std::function<void(const std::string& path, uint64_t size)>;
+
+    explicit FileSink(std::string path, DoneCallback on_done = nullptr);
+    ~FileSink() override;
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    bool write(const uint8_t* data, size_t size) override;
+    void finish() override;
+    void abort() override;
+
+private:
+    bool open();
+
+    std::string path_;
+    DoneCallback on_done_;
+    std::FILE* file_ = nullptr;
+    uint64_t written_ = 0;
+    bool done_ = false;
+};
+
+} // namespace websocket
@@ -0,0 +1,267 @@
+#include "numa.h"
+#include "platform.h"
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <cctype>
+#include <dirent.h>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+    // Из <numaif.h>: libnuma не нужна, хватает системных вызовов
+    constexpr int MPOL_PREFERRED = 1;
+    constexpr size_t MOVE_PAGES_BATCH = 256;
+
+    struct Topology {
+        int nodes = 1;
+        std::vector<int> cpu_node;  // Узел по номеру процессора
+    };
+
+    // "0-3,8-11" -> вызывает add для каждого процессора
+    template <typename Add>
+    void parseCpuList(const std::string& list, Add add) {
+        size_t pos = 0;
+        while (pos < list.size()) {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos) end = list.size();
+            const std::string range = list.substr(pos, end - pos);
+            const size_t dash = range.find('-');
+            try {
+                const int first = std::stoi(range);
+                const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu) add(cpu);
+            } catch (const std::exception&) {
+                // Пустая строка или мусор: узел без процессоров
+            }
+            pos = end + 1;
+        }
+    }
+
+    Topology loadTopology() {
+        Topology topology;
+        DIR* dir = opendir("/sys/devices/system/node");
+        if (!dir) return topology;
+        while (dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+                !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+                continue;
+            }
+            const int node = std::stoi(name.substr(4));
+            topology.nodes = std::max(topology.nodes, node + 1);
+
+            std::ifstream file("/sys/devices/system/node/" + name + "/cpulist");
+            std::string list;
+            std::getline(file, list);
+            parseCpuList(list, [&](int cpu) {
+                if (topology.cpu_node.size() <= static_cast<size_t>(cpu)) topology.cpu_node.resize(cpu + 1, 0);
+                topology.cpu_node[cpu] = node;
+            });
+        }
+        closedir(dir);
+        return topology;
+    }
+
+    const Topology& topology() {
+        static const Topology topology = loadTopology();
+        return topology;
+    }
+
+    size_t pageSize() {
+        static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+
+    int openNodeCounter(uint64_t result) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_NODE | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+        attr.inherit = 1;          // И потоки, созданные после открытия
+        attr.exclude_kernel = 1;   // Хватает perf_event_paranoid <= 2
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    uint64_t readCounter(int fd) {
+        uint64_t value = 0;
+        if (fd < 0 || ::read(fd, &value, sizeof(value)) != sizeof(value)) return 0;
+        return value;
+    }
+#else
+    size_t pageSize() {
+        static const size_t size = [] {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return static_cast<size_t>(info.dwPageSize);
+        }();
+        return size;
+    }
+#endif
+
+    size_t roundToPages(size_t size) {
+        const size_t page = pageSize();
+        return (size + page - 1) / page * page;
+    }
+}
+
+Numa::Traffic::~Traffic() {
+#ifndef _WIN32
+    if (local_fd_ >= 0) close(local_fd_);
+    if (remote_fd_ >= 0) close(remote_fd_);
+#endif
+}
+
+bool Numa::Traffic::start() {
+#ifdef _WIN32
+    return false;
+#else
+    local_fd_ = openNodeCounter(PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+    remote_fd_ = openNodeCounter(PERF_COUNT_HW_CACHE_RESULT_MISS);
+    if (local_fd_ < 0 || remote_fd_ < 0) {
+        if (local_fd_ >= 0) close(local_fd_);
+        if (remote_fd_ >= 0) close(remote_fd_);
+        local_fd_ = remote_fd_ = -1;
+        return false;
+    }
+    return true;
+#endif
+}
+
+uint64_t Numa::Traffic::nodeLoads() const {
+#ifdef _WIN32
+    return 0;
+#else
+    return readCounter(local_fd_);
+#endif
+}
+
+uint64_t Numa::Traffic::remoteLoads() const {
+#ifdef _WIN32
+    return 0;
+#else
+    return readCounter(remote_fd_);
+#endif
+}
+
+int Numa::nodeCount() {
+#ifdef _WIN32
+    ULONG highest = 0;
+    return GetNumaHighestNodeNumber(&highest) ? static_cast<int>(highest) + 1 : 1;
+#else
+    return topology().nodes;
+#endif
+}
+
+int Numa::nodeOfCpu(int cpu) {
+    if (cpu < 0) return 0;
+#ifdef _WIN32
+    PROCESSOR_NUMBER processor{};
+    processor.Group = static_cast<WORD>(cpu / 64);
+    processor.Number = static_cast<BYTE>(cpu % 64);
+    USHORT node = 0;
+    return GetNumaProcessorNodeEx(&processor, &node) ? node : 0;
+#else
+    const auto& cpu_node = topology().cpu_node;
+    return static_cast<size_t>(cpu) < cpu_node.size() ? cpu_node[cpu] : 0;
+#endif
+}
+
+int Numa::currentNode() {
+#ifdef _WIN32
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT node = 0;
+    return GetNumaProcessorNodeEx(&processor, &node) ? node : 0;
+#else
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+    return static_cast<int>(node);
+#endif
+}
+
+void* Numa::allocate(size_t size, int node) {
+    size = roundToPages(size);
+#ifdef _WIN32
+    const DWORD type = MEM_RESERVE | MEM_COMMIT;
+    if (node >= 0 && nodeCount() > 1) {
+        return VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, type, PAGE_READWRITE, static_cast<DWORD>(node));
+    }
+    return VirtualAlloc(nullptr, size, type, PAGE_READWRITE);
+#else
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    if (node >= 0 && nodeCount() > 1) {
+        // Политика действует с первого касания страниц, каким бы потоком
+        // оно ни было. Не вышло (ядро без NUMA) — страницы лягут как обычно
+        constexpr size_t BITS = sizeof(unsigned long) * 8;
+        unsigned long mask[16] = {};
+        if (static_cast<size_t>(node) < sizeof(mask) * 8) {
+            mask[node / BITS] = 1UL << (node % BITS);
+            syscall(SYS_mbind, memory, size, MPOL_PREFERRED, mask, sizeof(mask) * 8 + 1, 0);
+        }
+    }
+    return memory;
+#endif
+}
+
+void Numa::release(void* memory, size_t size) {
+    if (!memory) return;
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, roundToPages(size));
+#endif
+}
+
+void Numa::pagePlacement(const void* memory, size_t size, int node, PagePlacement& placement) {
+    const size_t page = pageSize();
+    const uintptr_t first = reinterpret_cast<uintptr_t>(memory) / page * page;
+    const uintptr_t end = reinterpret_cast<uintptr_t>(memory) + size;
+    const size_t pages = size == 0 ? 0 : (end - first + page - 1) / page;
+
+#ifdef _WIN32
+    std::vector<PSAPI_WORKING_SET_EX_INFORMATION> info(pages);
+    for (size_t i = 0; i < pages; ++i) info[i].VirtualAddress = reinterpret_cast<void*>(first + i * page);
+    if (pages == 0 || !QueryWorkingSetEx(GetCurrentProcess(), info.data(),
+                                         static_cast<DWORD>(info.size() * sizeof(info[0])))) {
+        placement.unknown += pages;
+        return;
+    }
+    for (const auto& entry : info) {
+        if (!entry.VirtualAttributes.Valid) ++placement.unknown;
+        else if (static_cast<int>(entry.VirtualAttributes.Node) == node) ++placement.local;
+        else ++placement.remote;
+    }
+#else
+    // move_pages без целевых узлов только сообщает, где страницы сейчас
+    void* addresses[MOVE_PAGES_BATCH];
+    int status[MOVE_PAGES_BATCH];
+    for (size_t done = 0; done < pages;) {
+        const size_t count = std::min(pages - done, MOVE_PAGES_BATCH);
+        for (size_t i = 0; i < count; ++i) addresses[i] = reinterpret_cast<void*>(first + (done + i) * page);
+        if (syscall(SYS_move_pages, 0, count, addresses, nullptr, status, 0) != 0) {
+            placement.unknown += pages - done;
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (status[i] < 0) ++placement.unknown;
+            else if (status[i] == node) ++placement.local;
+            else ++placement.remote;
+        }
+        done += count;
+    }
+#endif
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Узлы NUMA: топология, память на заданном узле и учёт обращений к
+// памяти чужого узла. На машине с одним узлом (или без поддержки NUMA
+// в системе) всё сводится к узлу 0 и обычному выделению страниц.
+class Numa {
+public:
+    // Где лежат страницы диапазона памяти
+    struct PagePlacement {
+        size_t local = 0;     // На ожидаемом узле
+        size_t remote = 0;    // На другом узле
+        size_t unknown = 0;   // Ещё не тронуты или система не сказала
+    };
+
+    // Загрузки из памяти по счётчикам процессора, по всем потокам
+    // процесса, созданным после start()
+    class Traffic {
+    public:
+        Traffic() = default;
+        ~Traffic();
+
+        Traffic(const Traffic&) = delete;
+        Traffic& operator=(const Traffic&) = delete;
+
+        // false — счётчики недоступны (нет прав, виртуалка, Windows)
+        bool start();
+        bool available() const { return local_fd_ >= 0; }
+        // Обращения к памяти своего узла и промахи мимо него — к чужому
+        uint64_t nodeLoads() const;
+        uint64_t remoteLoads() const;
+
+    private:
+        int local_fd_ = -1;
+        int remote_fd_ = -1;
+    };
+
+    static int nodeCount();
+    // Узел логического процессора; 0, если неизвестен
+    static int nodeOfCpu(int cpu);
+    // Узел процессора, на котором сейчас выполняется поток
+    static int currentNode();
+
+    // Страницы под size байт, привязанные к узлу node (node < 0 — без
+    // привязки). Привязка — предпочтение: кончится память узла, возьмётся
+    // чужая. Освобождать release с тем же size
+    static void* allocate(size_t size, int node);
+    static void release(void* memory, size_t size);
+
+    // Добавляет в placement страницы [memory, memory + size)
+    static void pagePlacement(const void* memory, size_t size, int node, PagePlacement& placement);
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+// Общие сетевые типы для Windows (IOCP) и Linux (epoll).
+// На Linux объявляем минимальные аналоги типов Winsock, чтобы
+// IOCPCore, Server и WebSocketConnection собирались без изменений.
+
+#ifdef _WIN32
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+
+#else
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+using SOCKET = int;
+using DWORD = uint32_t;
+using ULONG = uint32_t;
+using ULONG_PTR = uintptr_t;
+using BOOL = int;
+using CHAR = char;
+
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+
+// Раскладка повторяет виндовую: код использует только адрес структуры
+// как идентификатор операции
+struct OVERLAPPED {
+    ULONG_PTR Internal;
+    ULONG_PTR InternalHigh;
+    DWORD Offset;
+    DWORD OffsetHigh;
+    void* hEvent;
+};
+using LPOVERLAPPED = OVERLAPPED*;
+
+struct WSABUF {
+    ULONG len;
+    CHAR* buf;
+};
+
+inline void ZeroMemory(void* dest, size_t size) {
+    std::memset(dest, 0, size);
+}
+
+inline int closesocket(SOCKET socket) {
+    return ::close(socket);
+}
+
+#endif
@@ -0,0 +1,41 @@
+#include "receive_buffer.h"
+#include <cstring>
+
+namespace websocket {
+
+uint8_t* ReceiveBuffer::prepare(size_t min_free) {
+    if (read_ == write_) {
+        read_ = write_ = 0;
+    }
+    if (writable() >= min_free) {
+        return writePtr();
+    }
+
+    // Недополученный фрейм переносим в начало
+    if (read_ > 0) {
+        std::memmove(storage_.data(), storage_.data() + read_, size());
+        write_ -= read_;
+        read_ = 0;
+    }
+    if (writable() < min_free) {
+        // Блок следующего класса; переносим только недополученный фрейм
+        PooledBuffer larger(write_ + min_free);
+        if (write_ > 0) std::memcpy(larger.data(), storage_.data(), write_);
+        storage_ = std::move(larger);
+    }
+    return writePtr();
+}
+
+void ReceiveBuffer::consume(size_t bytes) {
+    read_ += bytes;
+    if (read_ >= write_) {
+        read_ = write_ = 0;
+    }
+}
+
+void ReceiveBuffer::reset() {
+    read_ = write_ = 0;
+    storage_.reset();
+}
+
+} // namespace websocket
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "buffer_pool.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace websocket {
+
+// Приёмный буфер соединения с курсорами чтения и записи.
+// recv пишет прямо в свободный хвост, фреймы разбираются на месте
+// между курсорами. Когда всё прочитанное разобрано, курсоры просто
+// возвращаются в начало; сдвигается только хвост недополученного
+// фрейма и только если за ним не хватает места под следующее чтение.
+// Фрейм в буфере всегда непрерывен — маску можно снимать на месте.
+// Память — блок BufferPool: рост идёт по классам, то есть удвоением,
+// а пустой буфер можно вернуть в пул до следующего чтения.
+class ReceiveBuffer {
+public:
+    // Готовит не меньше min_free свободных байт за курсором записи
+    uint8_t* prepare(size_t min_free);
+    uint8_t* writePtr() { return storage_.data() + write_; }
+    size_t writable() const { return storage_.capacity() - write_; }
+    // Учитывает байты, записанные по writePtr()
+    void commit(size_t bytes) { write_ += bytes; }
+
+    uint8_t* data() { return storage_.data() + read_; }
+    size_t size() const { return write_ - read_; }
+    bool empty() const { return read_ == write_; }
+    // Отмечает разобранные байты
+    void consume(size_t bytes);
+
+    size_t capacity() const { return storage_.capacity(); }
+    // Сбрасывает данные и возвращает блок в пул
+    void reset();
+
+private:
+    PooledBuffer storage_;
+    size_t read_ = 0;
+    size_t write_ = 0;
+};
+
+} // namespace websocket
@@ -1,9 +1,18 @@
 #include "server.h"
+#include <atomic>
 #include <iostream>
 #include <csignal>
+#include <cstdlib>
 
 std::unique_ptr<Server> server;
 
+// Эхо-сессия на корутинах: возвращает сообщения как есть
+websocket::Task echoSession(std::shared_ptr<websocket::WebSocketConnection> connection) {
+    while (auto message = co_await connection->read()) {
+        if (!co_await connection->write(*message)) break;
+    }
+}
+
 void signalHandler(int signal) {
     if (server) {
         server->stop();
@@ -11,11 +20,30 @@ void signalHandler(int signal) {
     exit(signal);
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     signal(SIGINT, signalHandler);  // Обработка Ctrl+C
 
+    // Необязательные аргументы: число шардов (циклов событий по ядрам),
+    // каталог, куда писать сообщения крупнее 1MB вместо сборки в памяти
+    // (пустая строка — не писать), "coro" — эхо через корутины и
+    // "verbose" — печатать каждое сообщение и подключение
+    ServerConfig config;  // Порт 8080
+    config.shards = argc > 1 ? std::atoi(argv[1]) : 0;
+    if (argc > 3 && std::string(argv[3]) == "coro") config.session = echoSession;
+    if (argc > 4 && std::string(argv[4]) == "verbose") config.verbose = true;
+    if (argc > 2 && *argv[2]) {
+        std::string directory = argv[2];
+        config.sink_factory = [directory](websocket::Opcode, uint64_t) {
+            static std::atomic<uint64_t> counter{0};
+            std::string path = directory + "/upload-" + std::to_string(++counter) + ".bin";
+            return std::make_unique<websocket::FileSink>(path, [](const std::string& path, uint64_t size) {
+                std::cout << "Stored " << size << " bytes in " << path << "\n";
+            });
+        };
+    }
+
     try {
-        server = std::make_unique<Server>(8080);  // Порт 8080
+        server = std::make_unique<Server>(config);
         server->start();
 
         // Ожидание завершения
@@ -1,79 +1,472 @@
 #include "server.h"
+#include "thread_affinity.h"
+#include <algorithm>
+#include <future>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
-Server::Server(int port) 
-    : port_(port), 
-      listen_socket_(INVALID_SOCKET),
+namespace {
+    // Выполняет fn в рабочем потоке цикла и ждёт; исключение fn
+    // пробрасывается вызывающему
+    template <typename Fn>
+    void runInLoop(IOCPCore& iocp, Fn fn) {
+        struct Task : CompletionHandler {
+            explicit Task(Fn fn) : fn(std::move(fn)) {}
+            void onCompletion(DWORD, LPOVERLAPPED, DWORD) override {
+                try {
+                    fn();
+                    done.set_value();
+                } catch (...) {
+                    done.set_exception(std::current_exception());
+                }
+            }
+
+            Fn fn;
+            std::promise<void> done;
+            OVERLAPPED overlapped{};
+        } task(std::move(fn));
+
+        auto done = task.done.get_future();
+        iocp.postCompletion(0, &task, &task.overlapped);
+        done.get();
+    }
+}
+
+Server::Server(const ServerConfig& config)
+    : config_(config),
+      deflate_memory_(config.deflate.memory_budget),
+      shared_listener_(false),
+      next_shard_(0),
       is_running_(false) {}
 
+Server::Server(int port, int shards)
+    : Server([&] {
+          ServerConfig config;
+          config.port = port;
+          config.shards = shards;
+          return config;
+      }()) {}
+
 Server::~Server() {
     stop();
 }
 
 void Server::start() {
     // Инициализация Winsock
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+    if (!SocketUtils::initialize()) {
         throw std::runtime_error("WSAStartup failed");
     }
 
-    // Создание сокета
-    listen_socket_ = SocketUtils::createSocket();
-    SocketUtils::setReuseAddr(listen_socket_);
-    SocketUtils::bindSocket(listen_socket_, port_);
-    SocketUtils::startListening(listen_socket_);
-
-    // Настройка IOCP
-    if (!iocp_.setup()) {
-        throw std::runtime_error("IOCP setup failed");
-    }
-    iocp_.associateSocket(listen_socket_, static_cast<ULONG_PTR>(IOCPCore::CompletionKeyType::CONNECTION));
-
-    // Коллбэк для новых подключений
-    iocp_.setConnectionCallback([this](DWORD, ULONG_PTR, LPOVERLAPPED) {
-        SOCKET client_socket = SocketUtils::createSocket();
-        if (SocketUtils::acceptEx(listen_socket_, client_socket, nullptr, 0, 0)) {
-            handleNewConnection(client_socket);
+    const int loops = config_.shards > 0 ? config_.shards : 1;
+#ifdef _WIN32
+    // SO_REUSEPORT в Winsock нет: принимает первый цикл и раздаёт сокеты остальным
+    shared_listener_ = loops > 1;
+#endif
+
+    for (int i = 0; i < loops; ++i) {
+        auto shard = std::make_unique<Shard>();
+        shard->server = this;
+        shard->index = i;
+        shard->handoff.server = this;
+        shard->handoff.shard = shard.get();
+        shard->accept_retry.handler = shard.get();
+        shard->accept_retry.owner = shard->accept_retry_owner;
+        if (config_.shards > 0) {
+            shard->cpu = ThreadAffinity::cpuForSlot(config_.placement, i);
+            if (config_.placement.numa_local && shard->cpu >= 0) shard->node = Numa::nodeOfCpu(shard->cpu);
+        }
+        shard->pool.bindToNode(shard->node);
+
+        // Настройка IOCP
+        shard->iocp.setRecvRing(config_.recv_ring, shard->node);
+        if (!shard->iocp.setup()) {
+            throw std::runtime_error("IOCP setup failed");
         }
-    });
 
-    // Запуск рабочих потоков
-    iocp_.runWorkerThreads(4);
+        if (i == 0 || !shared_listener_) {
+            shard->listen_socket = createListener(loops > 1 && !shared_listener_);
+            shard->iocp.associateSocket(shard->listen_socket, shard.get());
+            for (int a = 0; a < std::max(config_.accept_backlog, 1); ++a) {
+                shard->accept_operations.push_back(std::make_unique<IOCPCore::AcceptOperation>());
+            }
+        }
+
+        shards_.push_back(std::move(shard));
+    }
+
+    // Счётчики наследуют только потоки, созданные после открытия
+    numa_traffic_.start();
     is_running_ = true;
-    std::cout << "Server started on port " << port_ << "\n";
+    for (auto& shard : shards_) {
+        startShard(*shard);
+    }
+
+    std::cout << "Server started on port " << config_.port;
+    if (config_.shards > 0) std::cout << " (" << config_.shards << " shards)";
+    if (Numa::nodeCount() > 1) std::cout << " on " << Numa::nodeCount() << " NUMA nodes";
+    std::cout << "\n";
+}
+
+SOCKET Server::createListener(bool reuse_port) {
+    // Создание сокета
+    SOCKET listen_socket = SocketUtils::createSocket();
+    SocketUtils::setReuseAddr(listen_socket);
+    // Неприменившаяся опция — только предупреждение: сервер работает и без неё
+    SocketUtils::applyListenOptions(listen_socket, config_.socket_options);
+    if (reuse_port && !SocketUtils::setReusePort(listen_socket)) {
+        throw std::runtime_error("SO_REUSEPORT is required for sharded mode");
+    }
+    SocketUtils::bindSocket(listen_socket, config_.port);
+    SocketUtils::startListening(listen_socket);
+    return listen_socket;
+}
+
+void Server::Shard::onCompletion(DWORD, LPOVERLAPPED overlapped, DWORD error) {
+    if (overlapped == &accept_retry.overlapped) {
+        server->resumeAccepts(*this);
+        return;
+    }
+    server->onAcceptCompletion(*this, reinterpret_cast<IOCPCore::AcceptOperation*>(overlapped), error);
+}
+
+void Server::Handoff::onCompletion(DWORD, LPOVERLAPPED overlapped, DWORD) {
+    std::unique_ptr<Record> record(reinterpret_cast<Record*>(overlapped));
+    if (!server->is_running_) {
+        SocketUtils::closeSocket(record->socket);
+        return;
+    }
+    server->handleNewConnection(*shard, record->socket);
+}
+
+void Server::onAcceptCompletion(Shard& shard, IOCPCore::AcceptOperation* op, DWORD error) {
+    if (!is_running_) {
+        SocketUtils::closeSocket(op->socket);
+        return;
+    }
+
+    // Забираем принятый сокет и сразу ставим следующий accept
+    if (error == 0) {
+        handleAccepted(shard, op->socket);
+    } else {
+        SocketUtils::closeSocket(op->socket);
+    }
+
+    // При EMFILE и подобных новый accept тут же упадёт снова: на epoll —
+    // прямо внутри asyncAccept, на io_uring — перевзведением multishot.
+    // Поток крутился бы в этом кругу и не доходил до закрытия соединений,
+    // которые освободят дескрипторы. Такие accept ждут таймера
+    if (error != 0 && !SocketUtils::isTransientAcceptError(error)) {
+        pauseAccept(shard, op, error);
+        return;
+    }
+    postAccept(shard, op);
+}
+
+void Server::postAccept(Shard& shard, IOCPCore::AcceptOperation* op) {
+    // На Windows asyncAccept сам создаёт сокет и упирается в те же пределы
+    if (!shard.iocp.asyncAccept(shard.listen_socket, op)) pauseAccept(shard, op, 0);
+}
+
+void Server::pauseAccept(Shard& shard, IOCPCore::AcceptOperation* op, DWORD error) {
+    std::lock_guard<std::mutex> lock(shard.accept_mutex);
+    if (shard.paused_accepts.empty()) {
+        std::cerr << "Accept failed: "
+                  << (error != 0 ? "error " + std::to_string(error) : SocketUtils::getLastErrorString())
+                  << ", retrying in " << config_.accept_retry_delay.count() << " ms\n";
+        shard.iocp.setTimer(&shard.accept_retry, config_.accept_retry_delay);
+    }
+    shard.paused_accepts.push_back(op);
+}
+
+void Server::resumeAccepts(Shard& shard) {
+    if (!is_running_) return;
+
+    std::vector<IOCPCore::AcceptOperation*> paused;
+    {
+        std::lock_guard<std::mutex> lock(shard.accept_mutex);
+        paused.swap(shard.paused_accepts);
+    }
+    // Дескрипторов всё ещё нет — accept'ы упадут и снова лягут ждать таймера
+    for (auto* op : paused) postAccept(shard, op);
+}
+
+void Server::startShard(Shard& shard) {
+    // Запуск рабочих потоков: в шардированном режиме — один поток на цикл,
+    // закреплённый за своим процессором
+    std::vector<int> cpus;
+    int workers = 1;
+    if (config_.shards > 0) {
+        if (shard.cpu >= 0) cpus.push_back(shard.cpu);
+    } else {
+        workers = config_.placement.workers > 0 ? config_.placement.workers : ThreadAffinity::cpuCount();
+        for (int i = 0; config_.placement.pin && i < workers; ++i) {
+            cpus.push_back(ThreadAffinity::cpuForSlot(config_.placement, i));
+        }
+    }
+    shard.iocp.setBusyPoll(config_.busy_poll);
+    shard.iocp.runWorkerThreads(workers, cpus);
+
+    // Соединения создаются до первого клиента, чтобы шквал переподключений
+    // не упирался в аллокатор. Создаёт их поток цикла: память, которую
+    // соединения выделяют внутри себя, он касается первым — она ложится
+    // на его узел, как и слэбы
+    runInLoop(shard.iocp, [&shard, count = config_.preallocated_connections] { shard.pool.reserve(count); });
+
+    for (auto& op : shard.accept_operations) {
+        if (!shard.iocp.asyncAccept(shard.listen_socket, op.get())) {
+            throw std::runtime_error("AcceptEx failed");
+        }
+    }
+}
+
+void Server::handleAccepted(Shard& shard, SOCKET client_socket) {
+    SocketUtils::applyAcceptedOptions(client_socket, config_.socket_options);
+    if (!shared_listener_) {
+        handleNewConnection(shard, client_socket);
+        return;
+    }
+
+    Shard& target = *shards_[next_shard_++ % shards_.size()];
+    if (&target == &shard) {
+        handleNewConnection(shard, client_socket);
+        return;
+    }
+
+    // Передаём сокет циклу-владельцу, чтобы его таблицу трогал только его поток
+    auto* record = new Handoff::Record;
+    record->socket = client_socket;
+    target.iocp.postCompletion(0, &target.handoff, &record->overlapped);
 }
 
 void Server::stop() {
     if (!is_running_) return;
     
     is_running_ = false;
-    iocp_.stop();
-    SocketUtils::closeSocket(listen_socket_);
-    WSACleanup();
-    std::cout << "Server stopped\n";
+    for (auto& shard : shards_) {
+        std::vector<std::shared_ptr<websocket::WebSocketConnection>> clients;
+        {
+            std::lock_guard<std::mutex> lock(shard->clients_mutex);
+            clients.assign(shard->clients.begin(), shard->clients.end());
+        }
+        for (auto& client : clients) {
+            client->close(1001, "Server shutdown");
+        }
+    }
+
+    // Даём клиентам ответить на Close, но не дольше срока рукопожатия
+    auto remaining = [this] {
+        size_t total = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->clients_mutex);
+            total += shard->clients.size();
+        }
+        return total;
+    };
+    const auto deadline = std::chrono::steady_clock::now() + config_.timeouts.close;
+    while (remaining() > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    for (auto& shard : shards_) {
+        std::vector<std::shared_ptr<websocket::WebSocketConnection>> clients;
+        {
+            std::lock_guard<std::mutex> lock(shard->clients_mutex);
+            clients.assign(shard->clients.begin(), shard->clients.end());
+        }
+        for (auto& client : clients) {
+            client->close(1006, "Server shutdown");
+        }
+    }
+
+    // Корутины, так и не дождавшиеся продолжения (например, спящие),
+    // уничтожаются, пока пулы соединений, на которые они ссылаются, живы
+    CoroutineArena::Stats coroutines;
+    for (auto& shard : shards_) {
+        shard->iocp.cancelTimer(&shard->accept_retry);
+        shard->iocp.stop();
+        SocketUtils::closeSocket(shard->listen_socket);
+        shard->iocp.coroutineArena().destroyAll();
+        const auto stats = shard->iocp.coroutineArena().stats();
+        coroutines.frames += stats.frames;
+        coroutines.heap_frames += stats.heap_frames;
+        coroutines.destroyed += stats.destroyed;
+        coroutines.reserved_bytes += stats.reserved_bytes;
+    }
+    SocketUtils::cleanup();
+
+    auto stats = poolStats();
+    std::cout << "Server stopped. Connection pool: " << stats.objects << " objects in "
+              << stats.slabs << " slabs, " << stats.acquired << " acquired, "
+              << stats.released << " released, " << stats.heap_blocks << " heap blocks\n";
+
+    uint64_t hits = 0, dropped = 0, coalesced = 0, disconnects = 0;
+    for (const auto& shard : shards_) {
+        hits += shard->outbound_stats.high_watermark_hits;
+        dropped += shard->outbound_stats.dropped_frames;
+        coalesced += shard->outbound_stats.coalesced_frames;
+        disconnects += shard->outbound_stats.disconnects;
+    }
+    std::cout << "Slow consumers: " << hits << " watermark hits, " << dropped << " dropped, "
+              << coalesced << " coalesced, " << disconnects << " disconnected\n";
+
+    websocket::KeepaliveStats keepalive;
+    keepaliveStats(keepalive);
+    std::cout << "Keepalive: " << keepalive.pings_sent << " pings, " << keepalive.pongs_matched
+              << " pongs, RTT p50 " << keepalive.percentile(0.5) << " us, p99 " << keepalive.percentile(0.99)
+              << " us, " << keepalive.dead_peers << " dead peers\n";
+
+    const auto buffers = websocket::BufferPool::instance().stats();
+    std::cout << "Buffer pool: " << buffers.acquires << " acquires, " << buffers.hitRate() * 100
+              << "% hits (" << buffers.thread_hits << " thread cache, " << buffers.shared_hits << " shared), "
+              << buffers.allocations << " allocations, " << buffers.oversize << " oversize, "
+              << buffers.resident_bytes / 1024 << " KB resident, " << buffers.in_use_bytes / 1024 << " KB in use\n";
+
+    if (config_.busy_poll.spin_us > 0) {
+        uint64_t spins = 0, hits = 0, spin_ns = 0, parks = 0;
+        for (const auto& shard : shards_) {
+            const auto& busy = shard->iocp.busyPollStats();
+            spins += busy.spins.load(std::memory_order_relaxed);
+            hits += busy.hits.load(std::memory_order_relaxed);
+            spin_ns += busy.spin_ns.load(std::memory_order_relaxed);
+            parks += busy.parks.load(std::memory_order_relaxed);
+        }
+        std::cout << "Busy poll: " << spins << " spins, " << (spins ? 100.0 * hits / spins : 0.0)
+                  << "% found work, " << spin_ns / 1000000 << " ms spinning, " << parks << " parks\n";
+    }
+
+    // Куда легли слэбы циклов и сколько загрузок ушло в память чужого узла
+    Numa::PagePlacement pages;
+    for (const auto& shard : shards_) {
+        if (shard->node >= 0) {
+            const auto placement = shard->pool.placement();
+            pages.local += placement.local;
+            pages.remote += placement.remote;
+            pages.unknown += placement.unknown;
+        }
+    }
+    std::cout << "NUMA: " << Numa::nodeCount() << " nodes, slab pages " << pages.local << " local, "
+              << pages.remote << " remote, " << pages.unknown << " unknown; ";
+    if (numa_traffic_.available()) {
+        const uint64_t loads = numa_traffic_.nodeLoads();
+        const uint64_t remote = numa_traffic_.remoteLoads();
+        std::cout << loads << " node loads, " << remote << " remote ("
+                  << (loads ? 100.0 * remote / loads : 0.0) << "%)\n";
+    } else {
+        std::cout << "node load counters unavailable\n";
+    }
+
+    if (config_.session) {
+        std::cout << "Coroutines: " << coroutines.frames << " arena frames, " << coroutines.heap_frames
+                  << " heap frames, " << coroutines.destroyed << " destroyed at shutdown, "
+                  << coroutines.reserved_bytes / 1024 << " KB reserved\n";
+    }
+
+    if (config_.deflate.enabled) {
+        auto deflate = deflate_memory_.stats();
+        std::cout << "permessage-deflate: " << deflate.negotiated << " negotiated, " << deflate.declined
+                  << " declined, peak " << deflate.peak / 1024 << " KB zlib\n";
+    }
 }
 
-void Server::handleNewConnection(SOCKET client_socket) {
-    auto client = std::make_shared<websocket::WebSocketConnection>(client_socket, iocp_);
-    
-    client->setMessageCallback([this, client](const std::string& message) {
-        handleClientMessage(client, message);
-    });
+size_t Server::broadcast(std::string_view message) {
+    return broadcast(websocket::Frame::createSharedFrame(websocket::Opcode::Text, message));
+}
 
-    client->setCloseCallback([this, client]() {
-        handleClientDisconnect(client);
+size_t Server::broadcast(const websocket::SharedFrame& frame) {
+    size_t recipients = 0;
+    std::vector<std::shared_ptr<websocket::WebSocketConnection>> clients;
+    for (auto& shard : shards_) {
+        // Отправляем вне мьютекса: неудачная отправка закрывает соединение,
+        // а обработчик закрытия сам берёт clients_mutex
+        {
+            std::lock_guard<std::mutex> lock(shard->clients_mutex);
+            clients.assign(shard->clients.begin(), shard->clients.end());
+        }
+        for (auto& client : clients) {
+            client->sendShared(frame);
+        }
+        recipients += clients.size();
+    }
+    return recipients;
+}
+
+websocket::ConnectionPool::Stats Server::poolStats() const {
+    websocket::ConnectionPool::Stats total;
+    for (const auto& shard : shards_) {
+        auto stats = shard->pool.stats();
+        total.slabs += stats.slabs;
+        total.objects += stats.objects;
+        total.in_use += stats.in_use;
+        total.acquired += stats.acquired;
+        total.released += stats.released;
+        total.block_chunks += stats.block_chunks;
+        total.heap_blocks += stats.heap_blocks;
+    }
+    return total;
+}
+
+void Server::keepaliveStats(websocket::KeepaliveStats& total) const {
+    for (const auto& shard : shards_) {
+        total.merge(shard->keepalive_stats);
+    }
+}
+
+void Server::handleNewConnection(Shard& shard, SOCKET client_socket) {
+    auto client = shard.pool.acquire(client_socket);
+    client->setOutboundLimits(config_.outbound, &shard.outbound_stats);
+    client->setTimeouts(config_.timeouts);
+    client->setDeflateConfig(config_.deflate, &deflate_memory_);
+    client->setKeepaliveStats(&shard.keepalive_stats);
+    client->setZeroByteReads(config_.zero_byte_reads);
+    if (config_.sink_factory) client->setSinkFactory(config_.streaming, config_.sink_factory);
+    std::weak_ptr<websocket::WebSocketConnection> weak = client;
+
+    // Коллбэки держат слабую ссылку, иначе соединение держит само себя.
+    // У сессии коллбэка нет: сообщения ждут её read()
+    if (!config_.session) {
+        client->setMessageCallback([this, weak](const websocket::MessageView& message) {
+            if (auto client = weak.lock()) handleClientMessage(client, message);
+        });
+    }
+
+    client->setCloseCallback([this, &shard, weak]() {
+        if (auto client = weak.lock()) handleClientDisconnect(shard, client);
     });
 
-    clients_.insert(client);
-    std::cout << "New client connected. Total clients: " << clients_.size() << "\n";
+    size_t clients;
+    {
+        std::lock_guard<std::mutex> lock(shard.clients_mutex);
+        shard.clients.insert(client);
+        clients = shard.clients.size();
+    }
+    if (config_.verbose) std::cout << "New client connected. Total clients: " << clients << "\n";
+    if (config_.session) config_.session(client);
+    client->start();
 }
 
-void Server::handleClientMessage(std::shared_ptr<websocket::WebSocketConnection> client, const std::string& message) {
-    std::cout << "Received: " << message << "\n";
-    client->sendText("Echo: " + message);  // Ответ эхо-сообщением
+void Server::handleClientMessage(const std::shared_ptr<websocket::WebSocketConnection>& client,
+                                 const websocket::MessageView& message) {
+    if (!message.isText()) {
+        // Бинарное возвращаем как есть, прямо из приёмного буфера
+        if (config_.verbose) std::cout << "Received " << message.size << " bytes\n";
+        client->send(message);
+        return;
+    }
+    if (config_.verbose) std::cout << "Received: " << message.text() << "\n";
+
+    // Ответ эхо-сообщением
+    std::string reply = "Echo: ";
+    reply += message.text();
+    client->sendText(reply);
 }
 
-void Server::handleClientDisconnect(std::shared_ptr<websocket::WebSocketConnection> client) {
-    clients_.erase(client);
-    std::cout << "Client disconnected. Total clients: " << clients_.size() << "\n";
-}
\ No newline at end of file
+void Server::handleClientDisconnect(Shard& shard, std::shared_ptr<websocket::WebSocketConnection> client) {
+    size_t clients;
+    {
+        std::lock_guard<std::mutex> lock(shard.clients_mutex);
+        shard.clients.erase(client);
+        clients = shard.clients.size();
+    }
+    if (config_.verbose) std::cout << "Client disconnected. Total clients: " << clients << "\n";
+}
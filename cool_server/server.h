@@ -1,26 +1,148 @@
 #pragma once
+#include "connection_pool.h"
+#include "coroutine.h"
 #include "iocp_core.h"
+#include "numa.h"
 #include "socket_utils.h"
+#include "thread_affinity.h"
 #include "websocket_connection.h"
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string_view>
 #include <unordered_set>
+#include <vector>
+
+struct ServerConfig {
+    int port = 8080;
+    // 0: один общий цикл событий на placement.workers потоков.
+    // > 0: shared-nothing — по циклу на процессор, у каждого свой
+    // listen-сокет (SO_REUSEPORT), своя таблица соединений и свой поток;
+    // соединение живёт в цикле, который его принял.
+    int shards = 0;
+    // Число потоков, их процессоры и память циклов на узлах NUMA
+    ThreadPlacement placement;
+    // Опрос очереди завершений без сна перед ожиданием в ядре: ниже
+    // задержка, но рабочие потоки жгут процессор. По умолчанию выключен
+    BusyPollConfig busy_poll;
+    // Буферы приёма io_uring каждого цикла; их память — на узле цикла
+    RecvRingConfig recv_ring;
+    // Сколько accept одновременно выставлено на каждый listen-сокет
+    int accept_backlog = 64;
+    // Через сколько повторить accept, упавший на нехватке дескрипторов или
+    // памяти (EMFILE, ENFILE, ENOBUFS): до этого соединения успеют закрыться
+    std::chrono::milliseconds accept_retry_delay{100};
+    // TCP-опции listen-сокетов и принятых соединений
+    SocketOptions socket_options;
+    // Сколько объектов соединений каждый цикл создаёт заранее
+    size_t preallocated_connections = 1024;
+    // Отметки очереди отправки и политика для медленных клиентов
+    websocket::OutboundLimits outbound;
+    // Простой, пинги, сроки рукопожатий
+    websocket::ConnectionTimeouts timeouts;
+    // permessage-deflate; memory_budget — на все соединения сервера
+    websocket::DeflateConfig deflate;
+    // Крупные сообщения: фабрика приёмников, куда они идут потоком вместо
+    // сборки в памяти. Пусто — всё собирается целиком (до 64MB)
+    websocket::StreamingConfig streaming;
+    websocket::SinkFactory sink_factory;
+    // Простаивающие соединения ждут данных чтением нулевой длины и не
+    // держат приёмный буфер; цена — лишнее завершение на каждую пачку
+    // входящих. Выгодно при тысячах молчащих соединений, поэтому выключено.
+    // io_uring настройку не слушает (см. IOCPCore::zeroByteReads)
+    bool zero_byte_reads = false;
+    // Печатать подключения, отключения и каждое сообщение. Только для
+    // отладки: запись в консоль на каждое сообщение упирает цикл в вывод
+    bool verbose = false;
+    // Корутина на каждое соединение вместо эхо-обработчика: сообщения она
+    // читает сама через co_await read(). Стартует в потоке цикла, кадр —
+    // из его арены; при остановке сервера недождавшиеся уничтожаются
+    std::function<websocket::Task(std::shared_ptr<websocket::WebSocketConnection>)> session;
+};
 
 class Server {
 public:
-    Server(int port);
+    explicit Server(const ServerConfig& config);
+    Server(int port, int shards = 0);
     ~Server();
 
     void start();
     void stop();
 
+    // Текст всем подключённым клиентам всех циклов. Фрейм кодируется
+    // один раз, очереди соединений держат ссылки на него.
+    // Возвращает число получателей
+    size_t broadcast(std::string_view message);
+    size_t broadcast(const websocket::SharedFrame& frame);
+
+    // Сводная статистика пулов соединений всех циклов
+    websocket::ConnectionPool::Stats poolStats() const;
+    // Складывает в total пинги и RTT всех циклов
+    void keepaliveStats(websocket::KeepaliveStats& total) const;
+
 private:
-    void handleNewConnection(SOCKET client_socket);
-    void handleClientMessage(std::shared_ptr<websocket::WebSocketConnection> client, const std::string& message);
-    void handleClientDisconnect(std::shared_ptr<websocket::WebSocketConnection> client);
-
-    int port_;
-    SOCKET listen_socket_;
-    IOCPCore iocp_;
-    std::unordered_set<std::shared_ptr<websocket::WebSocketConnection>> clients_;
+    struct Shard;
+
+    // Приёмник сокетов, переданных из цикла с общим listen-сокетом (Windows).
+    // SOCKET на Win64 шире DWORD, поэтому сокет едет в записи передачи, а
+    // не в поле bytes завершения
+    struct Handoff : public CompletionHandler {
+        // overlapped первым полем: по нему коллбэк находит запись
+        struct Record {
+            OVERLAPPED overlapped{};
+            SOCKET socket = INVALID_SOCKET;
+        };
+
+        void onCompletion(DWORD bytes, LPOVERLAPPED overlapped, DWORD error) override;
+
+        Server* server = nullptr;
+        Shard* shard = nullptr;
+    };
+
+    // Шард сам получает завершения accept своего listen-сокета
+    struct Shard : public CompletionHandler {
+        void onCompletion(DWORD bytes, LPOVERLAPPED overlapped, DWORD error) override;
+
+        Server* server = nullptr;
+        int index = 0;
+        int cpu = -1;   // Процессор потока шарда; -1 — не закреплён
+        int node = -1;  // Узел NUMA его памяти; -1 — где придётся
+        IOCPCore iocp;
+        SOCKET listen_socket = INVALID_SOCKET;
+        // Пул выставленных accept: пока один завершается, остальные ждут в ядре
+        std::vector<std::unique_ptr<IOCPCore::AcceptOperation>> accept_operations;
+        // Accept'ы, отложенные до таймера после нехватки ресурсов
+        std::mutex accept_mutex;  // Нужен только в общем режиме
+        std::vector<IOCPCore::AcceptOperation*> paused_accepts;
+        IOCPCore::Timer accept_retry;
+        std::shared_ptr<void> accept_retry_owner = std::make_shared<char>();
+        // Объявлен до clients: соединения возвращаются в пул при разрушении шарда
+        websocket::ConnectionPool pool{iocp};
+        std::mutex clients_mutex;  // Нужен только в общем режиме
+        std::unordered_set<std::shared_ptr<websocket::WebSocketConnection>> clients;
+        websocket::OutboundStats outbound_stats;
+        websocket::KeepaliveStats keepalive_stats;
+        Handoff handoff;
+    };
+
+    SOCKET createListener(bool reuse_port);
+    void startShard(Shard& shard);
+    void onAcceptCompletion(Shard& shard, IOCPCore::AcceptOperation* op, DWORD error);
+    // Ставит accept снова; не вышло — откладывает его до таймера
+    void postAccept(Shard& shard, IOCPCore::AcceptOperation* op);
+    void pauseAccept(Shard& shard, IOCPCore::AcceptOperation* op, DWORD error);
+    void resumeAccepts(Shard& shard);
+    void handleAccepted(Shard& shard, SOCKET client_socket);
+    void handleNewConnection(Shard& shard, SOCKET client_socket);
+    void handleClientMessage(const std::shared_ptr<websocket::WebSocketConnection>& client,
+                             const websocket::MessageView& message);
+    void handleClientDisconnect(Shard& shard, std::shared_ptr<websocket::WebSocketConnection> client);
+
+    ServerConfig config_;
+    websocket::DeflateMemory deflate_memory_;
+    Numa::Traffic numa_traffic_;           // Обращения потоков циклов к памяти чужого узла
+    bool shared_listener_;                 // Windows: один listen-сокет раздаёт сокеты циклам
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<size_t> next_shard_;
     std::atomic<bool> is_running_;
-};
\ No newline at end of file
+};
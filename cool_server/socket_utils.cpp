@@ -1,11 +1,62 @@
 #include "socket_utils.h"
 #include <iostream>
+#include <mutex>
+
+#ifdef _WIN32
 #include <mswsock.h>  // Для AcceptEx
 #pragma comment(lib, "mswsock.lib")  // Линковка библиотеки
 #pragma comment(lib, "ws2_32.lib")   // Линковка Winsock
+#else
+#include <fcntl.h>
+#endif
+
+#ifdef _WIN32
+// Константы новых Windows 10 SDK; старые заголовки их не знают
+#ifndef TCP_FASTOPEN
+#define TCP_FASTOPEN 15
+#endif
+#ifndef TCP_MAXRTMS
+#define TCP_MAXRTMS 16
+#endif
+#endif
+
+namespace {
+    bool setIntOption(SOCKET socket, int level, int name, int value, const char* label) {
+        if (socket == INVALID_SOCKET) return false;
+        if (setsockopt(socket, level, name, reinterpret_cast<const char*>(&value), sizeof(value)) == SOCKET_ERROR) {
+            std::cerr << "Setsockopt " << label << " failed: " << SocketUtils::getLastErrorString() << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    [[maybe_unused]] bool unsupported(const char* label) {
+        std::cerr << label << " is not supported on this platform\n";
+        return false;
+    }
+}
+
+bool SocketUtils::initialize() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#else
+    return true;
+#endif
+}
+
+void SocketUtils::cleanup() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
 
 SOCKET SocketUtils::createSocket() {
+#ifdef _WIN32
     SOCKET sock = WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_OVERLAPPED);
+#else
+    SOCKET sock = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+#endif
     if (sock == INVALID_SOCKET) {
         std::cerr << "Socket creation failed: " << getLastErrorString() << "\n";
     }
@@ -23,6 +74,21 @@ bool SocketUtils::setReuseAddr(SOCKET socket) {
     return true;
 }
 
+bool SocketUtils::setReusePort(SOCKET socket) {
+    if (socket == INVALID_SOCKET) return false;
+
+#ifdef SO_REUSEPORT
+    int yes = 1;
+    if (setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<char*>(&yes), sizeof(yes)) == SOCKET_ERROR) {
+        std::cerr << "Setsockopt SO_REUSEPORT failed: " << getLastErrorString() << "\n";
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
 bool SocketUtils::bindSocket(SOCKET socket, int port) {
     if (socket == INVALID_SOCKET) return false;
     
@@ -51,20 +117,142 @@ bool SocketUtils::startListening(SOCKET socket) {
 bool SocketUtils::setNonBlocking(SOCKET socket) {
     if (socket == INVALID_SOCKET) return false;
     
+#ifdef _WIN32
     u_long mode = 1;
     if (ioctlsocket(socket, FIONBIO, &mode) == SOCKET_ERROR) {
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags < 0 || fcntl(socket, F_SETFL, flags | O_NONBLOCK) < 0) {
+#endif
         std::cerr << "Non-blocking mode failed: " << getLastErrorString() << "\n";
         return false;
     }
     return true;
 }
 
+bool SocketUtils::setNoDelay(SOCKET socket, bool enabled) {
+    return setIntOption(socket, IPPROTO_TCP, TCP_NODELAY, enabled ? 1 : 0, "TCP_NODELAY");
+}
+
+bool SocketUtils::setSendBuffer(SOCKET socket, int bytes) {
+    return setIntOption(socket, SOL_SOCKET, SO_SNDBUF, bytes, "SO_SNDBUF");
+}
+
+bool SocketUtils::setReceiveBuffer(SOCKET socket, int bytes) {
+    return setIntOption(socket, SOL_SOCKET, SO_RCVBUF, bytes, "SO_RCVBUF");
+}
+
+bool SocketUtils::setDeferAccept(SOCKET socket, int seconds) {
+#ifdef TCP_DEFER_ACCEPT
+    return setIntOption(socket, IPPROTO_TCP, TCP_DEFER_ACCEPT, seconds, "TCP_DEFER_ACCEPT");
+#else
+    (void)socket;
+    (void)seconds;
+    return unsupported("TCP_DEFER_ACCEPT");
+#endif
+}
+
+bool SocketUtils::setFastOpen(SOCKET socket, int queue) {
+#ifdef _WIN32
+    return setIntOption(socket, IPPROTO_TCP, TCP_FASTOPEN, queue > 0 ? 1 : 0, "TCP_FASTOPEN");
+#elif defined(TCP_FASTOPEN)
+    return setIntOption(socket, IPPROTO_TCP, TCP_FASTOPEN, queue, "TCP_FASTOPEN");
+#else
+    (void)socket;
+    (void)queue;
+    return unsupported("TCP_FASTOPEN");
+#endif
+}
+
+bool SocketUtils::setUserTimeout(SOCKET socket, int milliseconds) {
+#ifdef _WIN32
+    return setIntOption(socket, IPPROTO_TCP, TCP_MAXRTMS, milliseconds, "TCP_MAXRTMS");
+#elif defined(TCP_USER_TIMEOUT)
+    return setIntOption(socket, IPPROTO_TCP, TCP_USER_TIMEOUT, milliseconds, "TCP_USER_TIMEOUT");
+#else
+    (void)socket;
+    (void)milliseconds;
+    return unsupported("TCP_USER_TIMEOUT");
+#endif
+}
+
+bool SocketUtils::setBusyPoll(SOCKET socket, int microseconds) {
+#ifdef SO_BUSY_POLL
+    return setIntOption(socket, SOL_SOCKET, SO_BUSY_POLL, microseconds, "SO_BUSY_POLL");
+#else
+    (void)socket;
+    (void)microseconds;
+    return unsupported("SO_BUSY_POLL");
+#endif
+}
+
+bool SocketUtils::applyListenOptions(SOCKET socket, const SocketOptions& options) {
+    // Каждая опция пробуется независимо: одна неподдержанная не отменяет остальные
+    bool ok = true;
+    if (options.no_delay) ok &= setNoDelay(socket, true);
+    if (options.send_buffer > 0) ok &= setSendBuffer(socket, options.send_buffer);
+    if (options.receive_buffer > 0) ok &= setReceiveBuffer(socket, options.receive_buffer);
+    if (options.defer_accept_seconds > 0) ok &= setDeferAccept(socket, options.defer_accept_seconds);
+    if (options.fast_open_queue > 0) ok &= setFastOpen(socket, options.fast_open_queue);
+    if (options.user_timeout_ms > 0) ok &= setUserTimeout(socket, options.user_timeout_ms);
+    if (options.busy_poll_us > 0) ok &= setBusyPoll(socket, options.busy_poll_us);
+    return ok;
+}
+
+bool SocketUtils::applyAcceptedOptions(SOCKET socket, const SocketOptions& options) {
+#ifdef _WIN32
+    bool ok = true;
+    if (options.no_delay) ok &= setNoDelay(socket, true);
+    if (options.send_buffer > 0) ok &= setSendBuffer(socket, options.send_buffer);
+    if (options.receive_buffer > 0) ok &= setReceiveBuffer(socket, options.receive_buffer);
+    if (options.user_timeout_ms > 0) ok &= setUserTimeout(socket, options.user_timeout_ms);
+    return ok;
+#else
+    // Принятый сокет — копия listen-сокета вместе с опциями: лишних вызовов на accept нет
+    (void)socket;
+    (void)options;
+    return true;
+#endif
+}
+
 void SocketUtils::closeSocket(SOCKET socket) {
     if (socket != INVALID_SOCKET) {
         closesocket(socket);
     }
 }
 
+bool SocketUtils::isTransientAcceptError(DWORD error) {
+    switch (error) {
+#ifdef _WIN32
+        case ERROR_NETNAME_DELETED:
+        case ERROR_CONNECTION_ABORTED:
+        case WSAECONNRESET:
+        case WSAECONNABORTED:
+        case WSAEWOULDBLOCK:
+#else
+        case ECONNABORTED:
+        case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK:
+#endif
+        case EINTR:
+        // Сетевые ошибки уже принятого соединения: accept(2) советует
+        // считать их тем же EAGAIN
+        case EPROTO:
+        case ENETDOWN:
+        case ENOPROTOOPT:
+        case EHOSTDOWN:
+        case EHOSTUNREACH:
+        case ENETUNREACH:
+        case EOPNOTSUPP:
+#endif
+            return true;
+        default:
+            return false;
+    }
+}
+
+#ifdef _WIN32
 bool SocketUtils::acceptEx(SOCKET listenSocket, SOCKET acceptSocket, 
                          void* outputBuffer, DWORD bytes, 
                          LPOVERLAPPED overlapped) {
@@ -72,15 +260,22 @@ bool SocketUtils::acceptEx(SOCKET listenSocket, SOCKET acceptSocket,
         return false;
     }
 
-    GUID guidAcceptEx = WSAID_ACCEPTEX;
-    DWORD bytesReturned = 0;
-    LPFN_ACCEPTEX lpfnAcceptEx = nullptr;
-    
-    if (WSAIoctl(listenSocket, SIO_GET_EXTENSION_FUNCTION_POINTER,
-                &guidAcceptEx, sizeof(guidAcceptEx),
-                &lpfnAcceptEx, sizeof(lpfnAcceptEx),
-                &bytesReturned, nullptr, nullptr) == SOCKET_ERROR) {
-        std::cerr << "WSAIoctl failed for AcceptEx: " << getLastErrorString() << "\n";
+    // Указатель на AcceptEx один для всех TCP-сокетов: получаем его один раз,
+    // а не WSAIoctl на каждый accept
+    static LPFN_ACCEPTEX lpfnAcceptEx = nullptr;
+    static std::once_flag resolved;
+    std::call_once(resolved, [listenSocket]() {
+        GUID guidAcceptEx = WSAID_ACCEPTEX;
+        DWORD bytesReturned = 0;
+        if (WSAIoctl(listenSocket, SIO_GET_EXTENSION_FUNCTION_POINTER,
+                    &guidAcceptEx, sizeof(guidAcceptEx),
+                    &lpfnAcceptEx, sizeof(lpfnAcceptEx),
+                    &bytesReturned, nullptr, nullptr) == SOCKET_ERROR) {
+            std::cerr << "WSAIoctl failed for AcceptEx: " << getLastErrorString() << "\n";
+            lpfnAcceptEx = nullptr;
+        }
+    });
+    if (lpfnAcceptEx == nullptr) {
         return false;
     }
 
@@ -91,6 +286,7 @@ bool SocketUtils::acceptEx(SOCKET listenSocket, SOCKET acceptSocket,
         return false;
     }
 
+    DWORD bytesReturned = 0;
     BOOL result = lpfnAcceptEx(listenSocket, 
                               acceptSocket,
                               outputBuffer,
@@ -108,7 +304,14 @@ bool SocketUtils::acceptEx(SOCKET listenSocket, SOCKET acceptSocket,
     return true;
 }
 
+#endif
+
 std::string SocketUtils::getLastErrorString() {
+#ifndef _WIN32
+    int error = errno;
+    if (error == 0) return "No error";
+    return std::strerror(error);
+#else
     DWORD error = WSAGetLastError();
     if (error == 0) return "No error";
 
@@ -133,4 +336,5 @@ std::string SocketUtils::getLastErrorString() {
     }
 
     return message;
-}
\ No newline at end of file
+#endif
+}
@@ -1,22 +1,70 @@
 #pragma once
 
-#include <winsock2.h>
-#include <ws2tcpip.h>
+#include "platform.h"
 #include <string>
 #include <memory>
 
+// Профиль TCP-опций listen-сокета и принятых им соединений.
+// Ноль — оставить значение системы
+struct SocketOptions {
+    // TCP_NODELAY: мелкие фреймы не ждут подтверждения предыдущих (Nagle).
+    // Очередь отправки и так собирает фреймы в один send
+    bool no_delay = true;
+    int send_buffer = 0;           // SO_SNDBUF, байт
+    int receive_buffer = 0;        // SO_RCVBUF, байт; задаётся до listen — от него зависит окно
+    // TCP_DEFER_ACCEPT: accept завершается, когда клиент прислал данные
+    // (запрос рукопожатия), а не сразу после SYN-ACK. Только Linux
+    int defer_accept_seconds = 0;
+    // TCP_FASTOPEN: данные в SYN повторного клиента. На Linux — длина
+    // очереди запросов TFO, на Windows — просто включение
+    int fast_open_queue = 0;
+    // Неподтверждённые данные висят дольше — соединение рвётся ядром.
+    // TCP_USER_TIMEOUT на Linux, TCP_MAXRTMS на Windows
+    int user_timeout_ms = 0;
+    // SO_BUSY_POLL: чтение крутится в опросе драйвера до стольких
+    // микросекунд вместо сна. Только Linux, выше sysctl — с CAP_NET_ADMIN
+    int busy_poll_us = 0;
+};
+
 class SocketUtils {
 public:
+    // WSAStartup/WSACleanup на Windows, на Linux ничего не делают
+    static bool initialize();
+    static void cleanup();
+
     static SOCKET createSocket();
     static bool setReuseAddr(SOCKET socket);
+    // SO_REUSEPORT: несколько listen-сокетов на одном порту (только Linux)
+    static bool setReusePort(SOCKET socket);
     static bool bindSocket(SOCKET socket, int port);
     static bool startListening(SOCKET socket);
     static bool setNonBlocking(SOCKET socket);
+
+    static bool setNoDelay(SOCKET socket, bool enabled);
+    static bool setSendBuffer(SOCKET socket, int bytes);
+    static bool setReceiveBuffer(SOCKET socket, int bytes);
+    static bool setDeferAccept(SOCKET socket, int seconds);
+    static bool setFastOpen(SOCKET socket, int queue);
+    static bool setUserTimeout(SOCKET socket, int milliseconds);
+    static bool setBusyPoll(SOCKET socket, int microseconds);
+
+    // Профиль на listen-сокет, до bind/listen. На Linux принятые сокеты
+    // наследуют опции от него; false — хоть одна не применилась
+    static bool applyListenOptions(SOCKET socket, const SocketOptions& options);
+    // Принятому сокету: на Windows AcceptEx-сокет опций listen-сокета не
+    // наследует, на Linux делать нечего
+    static bool applyAcceptedOptions(SOCKET socket, const SocketOptions& options);
     static void closeSocket(SOCKET socket);
-    
+    // Ошибка accept касается только одного клиента (он сбросил соединение
+    // раньше, чем его приняли), и следующий accept можно ставить сразу.
+    // Остальное — нехватка дескрипторов или памяти: сразу повторять бесполезно
+    static bool isTransientAcceptError(DWORD error);
+
+#ifdef _WIN32
     static bool acceptEx(SOCKET listenSocket, SOCKET acceptSocket, 
                        void* outputBuffer, DWORD bytes, 
                        LPOVERLAPPED overlapped);
-    
+#endif
+
     static std::string getLastErrorString();
-};
\ No newline at end of file
+};
@@ -0,0 +1,152 @@
+// Поведение CoroutineArena:
+// - корутина, созданная в потоке цикла, берёт кадр из арены, вне цикла —
+//   из кучи без учёта; кадр крупнее 4KB — из кучи, но учитывается;
+// - кадр, освобождённый чужим потоком, возвращается владельцу и снова
+//   выдаётся: арена не растёт от корутин, которые завершает другой поток;
+// - destroyAll уничтожает недождавшиеся корутины (их локальные объекты
+//   разрушаются), в том числе те, чей кадр ждёт возврата владельцу.
+//
+// Запуск: coroutine_arena_test
+
+#include "../coroutine.h"
+#include "../socket_utils.h"
+#include "test.h"
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using websocket::Task;
+
+std::vector<std::coroutine_handle<>> parked;
+std::atomic<int> guards_alive{0};
+
+struct Park {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { parked.push_back(handle); }
+    void await_resume() const noexcept {}
+};
+
+struct Guard {
+    Guard() { ++guards_alive; }
+    ~Guard() { --guards_alive; }
+};
+
+Task parkOnce() {
+    Guard guard;
+    co_await Park{};
+}
+
+Task parkLarge() {
+    Guard guard;
+    volatile char scratch[8192];
+    scratch[0] = 1;
+    co_await Park{};
+    scratch[1] = scratch[0];
+}
+
+// Запускает fn в рабочем потоке цикла и ждёт завершения
+template <typename Fn>
+void runOnLoop(IOCPCore& core, Fn fn) {
+    struct Runner : CompletionHandler {
+        Fn fn;
+        std::atomic<bool> done{false};
+        explicit Runner(Fn f) : fn(std::move(f)) {}
+        void onCompletion(DWORD, LPOVERLAPPED, DWORD) override {
+            fn();
+            done = true;
+        }
+    } runner(std::move(fn));
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(overlapped));
+    core.postCompletion(0, &runner, &overlapped);
+    while (!runner.done) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void resumeAll() {
+    std::vector<std::coroutine_handle<>> handles;
+    handles.swap(parked);
+    for (auto handle : handles) handle.resume();
+}
+
+void testOffLoop() {
+    IOCPCore core;
+    parkOnce();
+    CHECK(parked.size() == 1);
+    CHECK(core.coroutineArena().stats().frames == 0);
+    resumeAll();
+    CHECK(guards_alive == 0);
+}
+
+void testRemoteFree() {
+    IOCPCore core;
+    CHECK(core.setup());
+    core.runWorkerThreads(1);
+    CoroutineArena& arena = core.coroutineArena();
+
+    // Создаёт поток цикла, завершает основной поток: кадры уходят
+    // владельцу через стек чужих освобождений
+    size_t reserved = 0;
+    for (int round = 0; round < 50; ++round) {
+        runOnLoop(core, [] {
+            for (int i = 0; i < 200; ++i) parkOnce();
+        });
+        CHECK(arena.stats().live == 200);
+        resumeAll();
+        if (round == 0) reserved = arena.stats().reserved_bytes;
+    }
+    CHECK(guards_alive == 0);
+    // Возвращённые кадры выдаются снова, новых кусков не нужно
+    CHECK(arena.stats().reserved_bytes == reserved);
+    CHECK(arena.stats().frames == 50 * 200);
+
+    // Разбор стека — при следующем выделении владельца
+    runOnLoop(core, [] { parkOnce(); });
+    CHECK(arena.stats().live == 1);
+    runOnLoop(core, [] { resumeAll(); });
+    CHECK(arena.stats().live == 0);
+    core.stop();
+}
+
+void testDestroyAll() {
+    IOCPCore core;
+    CHECK(core.setup());
+    core.runWorkerThreads(2);
+    CoroutineArena& arena = core.coroutineArena();
+
+    runOnLoop(core, [] {
+        for (int i = 0; i < 100; ++i) parkOnce();
+        parkLarge();
+    });
+    CHECK(guards_alive == 101);
+    CHECK(arena.stats().heap_frames == 1);
+    CHECK(arena.stats().live == 101);
+
+    // Часть завершает чужой поток: их кадры ждут владельца в стеке
+    std::vector<std::coroutine_handle<>> handles;
+    handles.swap(parked);
+    for (size_t i = 0; i < 10; ++i) handles[i].resume();
+    CHECK(guards_alive == 91);
+
+    core.stop();
+    CHECK(arena.destroyAll() == 91);
+    CHECK(guards_alive == 0);
+    const CoroutineArena::Stats stats = arena.stats();
+    CHECK(stats.live == 0);
+    CHECK(stats.destroyed == 91);
+    CHECK(arena.destroyAll() == 0);
+}
+
+}  // namespace
+
+int main() {
+    SocketUtils::initialize();
+    testOffLoop();
+    testRemoteFree();
+    testDestroyAll();
+    SocketUtils::cleanup();
+    return test::report("coroutine_arena_test");
+}
@@ -0,0 +1,208 @@
+// Поведение рукопожатия RFC 6455:
+// - SHA-1 совпадает с векторами FIPS 180 и с OpenSSL на длинах вокруг
+//   границ блока, Sec-WebSocket-Accept — с примером из RFC 6455, 1.3;
+// - запрос, пришедший по байту или двумя кусками с разрезом в любом месте,
+//   разбирается так же, как целый: Done ровно на последнем байте;
+// - запрос до MAX_REQUEST_SIZE включительно принимается, длиннее — 431,
+//   в том числе когда он приходит по байту;
+// - отказы 400 и 426 и их ответы.
+//
+// Запуск: handshake_test
+
+#include "../handshake.h"
+#include "test.h"
+#include <openssl/sha.h>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using websocket::Handshake;
+using websocket::HandshakeParser;
+using Result = HandshakeParser::Result;
+
+const uint8_t* bytes(const std::string& s) {
+    return reinterpret_cast<const uint8_t*>(s.data());
+}
+
+std::string hex(const uint8_t* data, size_t len) {
+    std::string out;
+    char digit[3];
+    for (size_t i = 0; i < len; ++i) {
+        std::snprintf(digit, sizeof(digit), "%02x", data[i]);
+        out += digit;
+    }
+    return out;
+}
+
+std::string sha1Hex(const std::string& input) {
+    uint8_t hash[20];
+    Handshake::sha1(bytes(input), input.size(), hash);
+    return hex(hash, sizeof(hash));
+}
+
+const std::string REQUEST =
+    "GET /chat HTTP/1.1\r\n"
+    "Host: server.example.com\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: keep-alive, Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Origin: http://example.com\r\n"
+    "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "\r\n";
+
+void testSha1() {
+    CHECK(sha1Hex("") == "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    CHECK(sha1Hex("abc") == "a9993e364706816aba3e25717850c26c9cd0d89d");
+    // 56 байт: длина уже не влезает в первый блок дополнения
+    CHECK(sha1Hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+          "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+    CHECK(sha1Hex(std::string(1000000, 'a')) == "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+
+    std::string input;
+    for (size_t len = 0; len <= 200; ++len) {
+        uint8_t expected[20];
+        SHA1(bytes(input), input.size(), expected);
+        CHECK(sha1Hex(input) == hex(expected, sizeof(expected)));
+        input += static_cast<char>('0' + len % 75);
+    }
+}
+
+void testAcceptKey() {
+    char accept[Handshake::ACCEPT_KEY_SIZE];
+    Handshake::acceptKey("dGhlIHNhbXBsZSBub25jZQ==", accept);
+    CHECK(std::string_view(accept, sizeof(accept)) == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+
+    const std::vector<uint8_t> response = Handshake::response("dGhlIHNhbXBsZSBub25jZQ==", "");
+    const std::string text(response.begin(), response.end());
+    CHECK(text.rfind("HTTP/1.1 101 ", 0) == 0);
+    CHECK(text.find("\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+    CHECK(text.find("Sec-WebSocket-Extensions") == std::string::npos);
+    CHECK(text.size() >= 4 && text.compare(text.size() - 4, 4, "\r\n\r\n") == 0);
+}
+
+void checkParsed(const HandshakeParser& parser, const std::string& buffer) {
+    CHECK(parser.requestSize() == REQUEST.size());
+    CHECK(parser.key(bytes(buffer)) == "dGhlIHNhbXBsZSBub25jZQ==");
+    CHECK(parser.extensionCount() == 1);
+    if (parser.extensionCount() == 1) {
+        CHECK(parser.extension(bytes(buffer), 0) == "permessage-deflate; client_max_window_bits");
+    }
+}
+
+void testWhole() {
+    // Следом за запросом уже пришёл фрейм: он не входит в requestSize
+    const std::string buffer = REQUEST + "\x81\x85";
+    HandshakeParser parser;
+    CHECK(parser.parse(bytes(buffer), buffer.size()) == Result::Done);
+    checkParsed(parser, buffer);
+    // Повторный вызов ничего не меняет
+    CHECK(parser.parse(bytes(buffer), buffer.size()) == Result::Done);
+}
+
+void testByteByByte() {
+    HandshakeParser parser;
+    for (size_t size = 1; size < REQUEST.size(); ++size) {
+        CHECK(parser.parse(bytes(REQUEST), size) == Result::Incomplete);
+    }
+    CHECK(parser.parse(bytes(REQUEST), REQUEST.size()) == Result::Done);
+    checkParsed(parser, REQUEST);
+}
+
+void testEverySplit() {
+    for (size_t split = 1; split < REQUEST.size(); ++split) {
+        HandshakeParser parser;
+        CHECK(parser.parse(bytes(REQUEST), split) == Result::Incomplete);
+        CHECK(parser.parse(bytes(REQUEST), REQUEST.size()) == Result::Done);
+        checkParsed(parser, REQUEST);
+    }
+}
+
+// Запрос ровно size байт: добивается длинным заголовком
+std::string requestOfSize(size_t size) {
+    const std::string head =
+        "GET / HTTP/1.1\r\nHost: a\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n";
+    const std::string filler = "X-Filler: ";
+    const size_t tail = 2 + 2;  // Перевод строки заголовка и пустая строка
+    std::string request = head + filler;
+    request.append(size - request.size() - tail, 'x');
+    request += "\r\n\r\n";
+    return request;
+}
+
+void testSizeLimit() {
+    const std::string fits = requestOfSize(HandshakeParser::MAX_REQUEST_SIZE);
+    HandshakeParser parser;
+    CHECK(parser.parse(bytes(fits), fits.size()) == Result::Done);
+    CHECK(parser.requestSize() == fits.size());
+
+    const std::string oversize = requestOfSize(HandshakeParser::MAX_REQUEST_SIZE + 1);
+    parser.reset();
+    CHECK(parser.parse(bytes(oversize), oversize.size()) == Result::Error);
+    CHECK(parser.status() == 431);
+
+    // По байту: 431 приходит, как только накопился предел, а не позже
+    parser.reset();
+    size_t size = 1;
+    for (; size <= oversize.size(); ++size) {
+        if (parser.parse(bytes(oversize), size) != Result::Incomplete) break;
+    }
+    CHECK(size == HandshakeParser::MAX_REQUEST_SIZE);
+    CHECK(parser.status() == 431);
+    // Ошибка залипает
+    CHECK(parser.parse(bytes(oversize), oversize.size()) == Result::Error);
+
+    // Без единого перевода строки — тоже 431
+    const std::string garbage(HandshakeParser::MAX_REQUEST_SIZE, 'G');
+    parser.reset();
+    CHECK(parser.parse(bytes(garbage), garbage.size()) == Result::Error);
+    CHECK(parser.status() == 431);
+
+    const std::vector<uint8_t> rejection = Handshake::rejection(431);
+    const std::string text(rejection.begin(), rejection.end());
+    CHECK(text.rfind("HTTP/1.1 431 ", 0) == 0);
+    CHECK(text.find("Connection: close\r\n") != std::string::npos);
+}
+
+int statusOf(const std::string& request) {
+    HandshakeParser parser;
+    return parser.parse(bytes(request), request.size()) == Result::Error ? parser.status() : 0;
+}
+
+void testRejections() {
+    const std::string start = "GET / HTTP/1.1\r\nHost: a\r\n";
+    const std::string key = "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n";
+    const std::string upgrade = "Upgrade: WebSocket\r\nconnection: UPGRADE\r\n";
+
+    CHECK(statusOf(start + upgrade + key + "Sec-WebSocket-Version: 13\r\n\r\n") == 0);
+    CHECK(statusOf(start + upgrade + key + "Sec-WebSocket-Version: 8\r\n\r\n") == 426);
+    CHECK(statusOf(start + upgrade + "Sec-WebSocket-Version: 13\r\n\r\n") == 400);
+    CHECK(statusOf(start + key + "Sec-WebSocket-Version: 13\r\n\r\n") == 400);
+    CHECK(statusOf(start + upgrade + "Sec-WebSocket-Key: short\r\nSec-WebSocket-Version: 13\r\n\r\n") == 400);
+    CHECK(statusOf(start + upgrade + key + key + "Sec-WebSocket-Version: 13\r\n\r\n") == 400);
+    CHECK(statusOf("POST / HTTP/1.1\r\n" + upgrade + key + "Sec-WebSocket-Version: 13\r\n\r\n") == 400);
+    CHECK(statusOf("GET / HTTP/1.0\r\nHost: a\r\n" + upgrade + key + "Sec-WebSocket-Version: 13\r\n\r\n") == 400);
+
+    const std::vector<uint8_t> rejection = Handshake::rejection(426);
+    const std::string text(rejection.begin(), rejection.end());
+    CHECK(text.rfind("HTTP/1.1 426 ", 0) == 0);
+    CHECK(text.find("Sec-WebSocket-Version: 13\r\n") != std::string::npos);
+}
+
+}  // namespace
+
+int main() {
+    testSha1();
+    testAcceptKey();
+    testWhole();
+    testByteByByte();
+    testEverySplit();
+    testSizeLimit();
+    testRejections();
+    return test::report("handshake_test");
+}
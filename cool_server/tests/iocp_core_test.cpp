@@ -0,0 +1,179 @@
+// Поведение IOCPCore на loopback, одинаковое для всех бэкендов:
+// - эхо: принятый через asyncAccept сокет, asyncRecv и asyncSend;
+// - чтение нулевой длины ждёт данных и ничего не забирает из сокета;
+// - отправка, которая не влезает в буфер сокета за один sendmsg,
+//   завершается один раз и целиком, байты идут по порядку;
+// - closeSocket завершает висящее чтение с ECANCELED.
+// Собирается с бэкендом по умолчанию (epoll на Linux) или с
+// -DCOOL_SERVER_IO_URING.
+//
+// Запуск: iocp_core_test
+
+#include "../iocp_core.h"
+#include "../socket_utils.h"
+#include "test.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#endif
+
+namespace {
+
+using namespace std::chrono_literals;
+
+struct Completion {
+    DWORD bytes;
+    LPOVERLAPPED overlapped;
+    DWORD error;
+};
+
+// Складывает завершения; тест ждёт их по одному
+class Recorder : public CompletionHandler {
+public:
+    void onCompletion(DWORD bytes, LPOVERLAPPED overlapped, DWORD error) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.push_back({bytes, overlapped, error});
+        }
+        cv_.notify_all();
+    }
+
+    bool wait(Completion& out, std::chrono::milliseconds timeout = 2000ms) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!cv_.wait_for(lock, timeout, [&] { return !done_.empty(); })) return false;
+        out = done_.front();
+        done_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Completion> done_;
+};
+
+bool sendAll(SOCKET s, const char* data, size_t len) {
+    while (len > 0) {
+        int n = send(s, data, static_cast<int>(len), 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recvAll(SOCKET s, char* data, size_t len) {
+    while (len > 0) {
+        int n = recv(s, data, static_cast<int>(len), 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+int main() {
+    SocketUtils::initialize();
+    IOCPCore core;
+    if (!core.setup()) return 1;
+    core.runWorkerThreads(1);
+
+    Recorder listener_events, server_events;
+    SOCKET listener = SocketUtils::createSocket();
+    CHECK(SocketUtils::bindSocket(listener, 0));
+    CHECK(SocketUtils::startListening(listener));
+    sockaddr_in address{};
+    socklen_t length = sizeof(address);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    core.associateSocket(listener, &listener_events);
+
+    // Accept
+    IOCPCore::AcceptOperation accept_op;
+    CHECK(core.asyncAccept(listener, &accept_op));
+    SOCKET client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    CHECK(connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    Completion c{};
+    CHECK(listener_events.wait(c));
+    CHECK(c.overlapped == &accept_op.overlapped && c.error == 0);
+    SOCKET server = accept_op.socket;
+    CHECK(server != INVALID_SOCKET);
+    core.associateSocket(server, &server_events);
+
+    // Эхо
+    OVERLAPPED read_op{}, write_op{};
+    char buffer[256];
+    WSABUF buf{sizeof(buffer), buffer};
+    CHECK(core.asyncRecv(server, &buf, 1, &read_op));
+    CHECK(sendAll(client, "hello", 5));
+    CHECK(server_events.wait(c));
+    CHECK(c.overlapped == &read_op && c.error == 0 && c.bytes == 5);
+    WSABUF echo{c.bytes, buffer};
+    CHECK(core.asyncSend(server, &echo, 1, &write_op));
+    CHECK(server_events.wait(c));
+    CHECK(c.overlapped == &write_op && c.error == 0 && c.bytes == 5);
+    char reply[5];
+    CHECK(recvAll(client, reply, sizeof(reply)) && std::memcmp(reply, "hello", 5) == 0);
+
+    // Чтение нулевой длины: завершения нет, пока нет данных
+    WSABUF empty{0, nullptr};
+    CHECK(core.asyncRecv(server, &empty, 1, &read_op));
+    CHECK(!server_events.wait(c, 100ms));
+    CHECK(sendAll(client, "abc", 3));
+    CHECK(server_events.wait(c));
+    CHECK(c.overlapped == &read_op && c.error == 0 && c.bytes == 0);
+    // ...и данные остались в сокете для следующего чтения
+    CHECK(core.asyncRecv(server, &buf, 1, &read_op));
+    CHECK(server_events.wait(c));
+    CHECK(c.error == 0 && c.bytes == 3 && std::memcmp(buffer, "abc", 3) == 0);
+
+    // Частичная отправка: 4 MB из нескольких буферов при маленьком буфере
+    // сокета и клиенте, который пока не читает
+    SocketUtils::setSendBuffer(server, 16 * 1024);
+    std::vector<std::string> parts;
+    for (int i = 0; i < 4; ++i) {
+        std::string part(1 << 20, '\0');
+        for (size_t j = 0; j < part.size(); ++j) part[j] = static_cast<char>((i * 131 + j * 7) & 0xff);
+        parts.push_back(std::move(part));
+    }
+    std::vector<WSABUF> gather;
+    size_t total = 0;
+    for (auto& part : parts) {
+        gather.push_back({static_cast<ULONG>(part.size()), part.data()});
+        total += part.size();
+    }
+    CHECK(core.asyncSend(server, gather.data(), static_cast<DWORD>(gather.size()), &write_op));
+    CHECK(!server_events.wait(c, 100ms));  // Не может уйти, пока клиент не читает
+    std::string received(total, '\0');
+    CHECK(recvAll(client, received.data(), total));
+    CHECK(server_events.wait(c));
+    CHECK(c.overlapped == &write_op && c.error == 0 && c.bytes == total);
+    CHECK(received == parts[0] + parts[1] + parts[2] + parts[3]);
+    CHECK(!server_events.wait(c, 50ms));  // Завершение ровно одно
+
+    // closeSocket: висящее чтение завершается отменой
+    CHECK(core.asyncRecv(server, &buf, 1, &read_op));
+    core.closeSocket(server);
+    CHECK(server_events.wait(c));
+    CHECK(c.overlapped == &read_op);
+#ifdef _WIN32
+    CHECK(c.error == ERROR_OPERATION_ABORTED);
+#else
+    CHECK(c.error == ECANCELED);
+#endif
+
+    core.stop();
+    SocketUtils::closeSocket(client);
+    SocketUtils::closeSocket(listener);
+    SocketUtils::cleanup();
+    return test::report("iocp_core_test");
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <iostream>
+
+// Проверки без фреймворка: CHECK печатает место провала и считает его,
+// main возвращает test::report() — ненулевой код, если что-то упало
+namespace test {
+    inline int failures = 0;
+
+    inline int report(const char* name) {
+        if (failures == 0) {
+            std::cout << name << ": OK\n";
+            return 0;
+        }
+        std::cout << name << ": " << failures << " checks failed\n";
+        return 1;
+    }
+}
+
+#define CHECK(condition)                                                                     \
+    do {                                                                                     \
+        if (!(condition)) {                                                                  \
+            ++test::failures;                                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n";  \
+        }                                                                                    \
+    } while (0)
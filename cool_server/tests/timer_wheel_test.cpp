@@ -0,0 +1,202 @@
+// Поведение TimerWheel на границах уровней:
+// - таймер срабатывает ровно в свой тик и до него не срабатывает, в том
+//   числе после раскладки со второго, третьего и четвёртого колеса;
+// - прыжок через много тиков одним advance отдаёт таймеры по порядку;
+// - снятие и перевзвод таймеров ячейки, которую вот-вот разложат или
+//   только что разложили, не ломают остальные таймеры этой ячейки;
+// - таймер, взведённый посреди тика, не срабатывает раньше срока.
+// Время колеса задаётся только аргументами: начало тика 0, now в
+// schedule и advance.
+//
+// Запуск: timer_wheel_test
+
+#include "../timer_wheel.h"
+#include "test.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr std::chrono::milliseconds TICK = 1h;
+
+struct Probe {
+    TimerNode node;  // Первым полем: по узлу находим пробу
+    uint64_t due = 0;
+    uint64_t fired = 0;
+};
+
+class Wheel {
+public:
+    Wheel() : base_(TimerWheel::Clock::now()), wheel_(TICK, base_) {}
+
+    // Сроки отсчитываются от начала тика 0
+    void schedule(Probe& probe, uint64_t ticks) {
+        probe.due = ticks;
+        probe.fired = 0;
+        wheel_.schedule(&probe.node, TICK * ticks, base_);
+    }
+
+    // Прокручивает до тика tick и отмечает сработавшие этим тиком
+    size_t advanceTo(uint64_t tick) {
+        expired_.clear();
+        wheel_.advance(base_ + TICK * tick, expired_);
+        for (TimerNode* node : expired_) {
+            reinterpret_cast<Probe*>(node)->fired = tick;
+        }
+        return expired_.size();
+    }
+
+    TimerWheel& wheel() { return wheel_; }
+    const std::vector<TimerNode*>& expired() const { return expired_; }
+
+private:
+    TimerWheel::Clock::time_point base_;
+    TimerWheel wheel_;
+    std::vector<TimerNode*> expired_;
+};
+
+// Сроки по обе стороны границ каждого уровня: 64, 64^2, 64^3
+const uint64_t BOUNDARY_TICKS[] = {
+    1, 62, 63, 64, 65, 127, 128, 129,
+    4095, 4096, 4097, 4160, 8191, 8192,
+    262143, 262144, 262145, 266240, 270000,
+};
+
+void testFiresOnItsTick() {
+    Wheel wheel;
+    std::vector<Probe> probes(std::size(BOUNDARY_TICKS));
+    for (size_t i = 0; i < probes.size(); ++i) wheel.schedule(probes[i], BOUNDARY_TICKS[i]);
+    CHECK(wheel.wheel().size() == probes.size());
+
+    // Тик за тиком: каждая раскладка проходит через advance по отдельности
+    const uint64_t last = BOUNDARY_TICKS[std::size(BOUNDARY_TICKS) - 1];
+    for (uint64_t tick = 1; tick <= last; ++tick) {
+        wheel.advanceTo(tick);
+        for (TimerNode* node : wheel.expired()) {
+            CHECK(reinterpret_cast<Probe*>(node)->due == tick);
+        }
+    }
+    for (const Probe& probe : probes) CHECK(probe.fired == probe.due);
+    CHECK(wheel.wheel().empty());
+    CHECK(wheel.advanceTo(last + 100) == 0);
+}
+
+void testJumpKeepsOrder() {
+    Wheel wheel;
+    std::vector<Probe> probes(std::size(BOUNDARY_TICKS));
+    // Обратный порядок постановки: порядок срабатывания задаёт колесо
+    for (size_t i = probes.size(); i-- > 0;) wheel.schedule(probes[i], BOUNDARY_TICKS[i]);
+
+    // Первый прыжок останавливается ровно перед границей третьего уровня
+    CHECK(wheel.advanceTo(262143) == probes.size() - 4);
+    uint64_t previous = 0;
+    for (TimerNode* node : wheel.expired()) {
+        const uint64_t due = reinterpret_cast<Probe*>(node)->due;
+        CHECK(due >= previous);
+        previous = due;
+    }
+    CHECK(probes[probes.size() - 4].fired == 0);
+    CHECK(wheel.advanceTo(300000) == 4);
+    CHECK(wheel.wheel().empty());
+}
+
+void testCancelAroundCascade() {
+    Wheel wheel;
+    // Все шесть — в одной ячейке второго колеса, раскладка в тик 128
+    Probe cancel_before, cancel_after, reschedule_after, keep[3];
+    wheel.schedule(cancel_before, 130);
+    wheel.schedule(keep[0], 130);
+    wheel.schedule(cancel_after, 131);
+    wheel.schedule(keep[1], 131);
+    wheel.schedule(reschedule_after, 140);
+    wheel.schedule(keep[2], 191);
+
+    CHECK(wheel.advanceTo(127) == 0);
+    // Ячейка ещё не разложена: таймер снимается со второго колеса
+    CHECK(wheel.wheel().cancel(&cancel_before.node));
+    CHECK(!cancel_before.node.armed());
+    CHECK(!wheel.wheel().cancel(&cancel_before.node));
+
+    // Тик 128 раскладывает ячейку; остальные уходят на младшее колесо
+    CHECK(wheel.advanceTo(128) == 0);
+    CHECK(wheel.wheel().cancel(&cancel_after.node));
+    wheel.schedule(reschedule_after, 4096 + 5);
+    CHECK(wheel.wheel().size() == 4);
+
+    CHECK(wheel.advanceTo(130) == 1);
+    CHECK(keep[0].fired == 130);
+    CHECK(wheel.advanceTo(131) == 1);
+    CHECK(keep[1].fired == 131);
+    CHECK(wheel.advanceTo(191) == 1);
+    CHECK(keep[2].fired == 191);
+    CHECK(cancel_before.fired == 0);
+    CHECK(cancel_after.fired == 0);
+    CHECK(reschedule_after.fired == 0);
+
+    // Перевзведённый отсчитан от тика 0, а колесо уже на 192:
+    // срок 4101 всё ещё впереди
+    CHECK(wheel.advanceTo(4100) == 0);
+    CHECK(wheel.advanceTo(4101) == 1);
+    CHECK(reschedule_after.fired == 4101);
+    CHECK(wheel.wheel().empty());
+}
+
+void testCancelInCascadingHigherLevel() {
+    Wheel wheel;
+    // Ячейка третьего колеса, которая в тик 4096 раскладывается на второе,
+    // а оттуда в тик 4160 — на первое
+    Probe first, second, third;
+    wheel.schedule(first, 4160 + 1);
+    wheel.schedule(second, 4160 + 2);
+    wheel.schedule(third, 4160 + 3);
+
+    CHECK(wheel.advanceTo(4096) == 0);
+    // Середина списка между двумя раскладками
+    CHECK(wheel.wheel().cancel(&second.node));
+    CHECK(wheel.advanceTo(4160) == 0);
+    CHECK(wheel.wheel().cancel(&first.node));
+    CHECK(wheel.advanceTo(4163) == 1);
+    CHECK(third.fired == 4163);
+    CHECK(first.fired == 0 && second.fired == 0);
+    CHECK(wheel.wheel().empty());
+}
+
+void testNeverEarly() {
+    // Таймер, взведённый посреди тика, не срабатывает раньше срока
+    using namespace std::chrono_literals;
+    const auto start = TimerWheel::Clock::now();
+    TimerWheel wheel(10ms, start);
+    TimerNode node;
+    std::vector<TimerNode*> expired;
+
+    wheel.schedule(&node, 30ms, start + 9ms);
+    wheel.advance(start + 30ms, expired);
+    wheel.advance(start + 39ms, expired);
+    CHECK(expired.empty());
+    CHECK(wheel.timeoutMs(start + 39ms) == 1);
+    wheel.advance(start + 40ms, expired);
+    CHECK(expired.size() == 1);
+
+    // Срок ровно на границе тика — в этот же тик
+    expired.clear();
+    wheel.schedule(&node, 20ms, start + 50ms);
+    wheel.advance(start + 69ms, expired);
+    CHECK(expired.empty());
+    wheel.advance(start + 70ms, expired);
+    CHECK(expired.size() == 1);
+}
+
+}  // namespace
+
+int main() {
+    testFiresOnItsTick();
+    testJumpKeepsOrder();
+    testCancelAroundCascade();
+    testCancelInCascadingHigherLevel();
+    testNeverEarly();
+    return test::report("timer_wheel_test");
+}
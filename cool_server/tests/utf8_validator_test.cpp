@@ -0,0 +1,236 @@
+// Поведение Utf8Validator (RFC 3629) на всех путях — автомат, ядро
+// SSSE3/AVX2 на длинных кусках и стыки кусков:
+// - overlong-формы, суррогаты и всё выше U+10FFFF отвергаются, соседние
+//   с ними допустимые символы — нет, в любой позиции внутри блока ядра;
+// - каждая 2- и 3-байтная последовательность и 4-байтные с любым вторым
+//   байтом сверяются с простым эталонным декодером;
+// - символ, разрезанный на стыке кусков feed() и на границе 4 КиБ в
+//   Frame::unmaskUtf8, принимается, а испорченный — отвергается;
+// - оборванный на конце текста символ: feed() — да, complete() — нет.
+// Ядро выбирается по процессору: на машине без AVX2 проверяется SSSE3.
+//
+// Запуск: utf8_validator_test
+
+#include "../frame.h"
+#include "../utf8_validator.h"
+#include "test.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+using websocket::Frame;
+using websocket::FrameHeader;
+using websocket::Utf8Validator;
+using Bytes = std::vector<uint8_t>;
+
+// Эталон: побайтовый разбор по таблице 3-7 из стандарта Unicode
+bool referenceValid(const uint8_t* data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        const uint8_t c = data[i];
+        if (c < 0x80) { ++i; continue; }
+        size_t need;
+        uint8_t low = 0x80, high = 0xBF;  // Допустимый второй байт
+        if (c >= 0xC2 && c <= 0xDF) need = 1;
+        else if (c == 0xE0) { need = 2; low = 0xA0; }
+        else if (c >= 0xE1 && c <= 0xEC) need = 2;
+        else if (c == 0xED) { need = 2; high = 0x9F; }
+        else if (c >= 0xEE && c <= 0xEF) need = 2;
+        else if (c == 0xF0) { need = 3; low = 0x90; }
+        else if (c >= 0xF1 && c <= 0xF3) need = 3;
+        else if (c == 0xF4) { need = 3; high = 0x8F; }
+        else return false;
+        if (len - i <= need) return false;
+        if (data[i + 1] < low || data[i + 1] > high) return false;
+        for (size_t k = 2; k <= need; ++k) {
+            if ((data[i + k] & 0xC0) != 0x80) return false;
+        }
+        i += need + 1;
+    }
+    return true;
+}
+
+// Последовательность внутри ASCII длиной с несколько блоков ядра
+Bytes padded(const Bytes& sequence, size_t offset, size_t total = 128) {
+    Bytes text(total, 'a');
+    std::memcpy(text.data() + offset, sequence.data(), sequence.size());
+    return text;
+}
+
+bool feedSplit(const Bytes& text, size_t split) {
+    Utf8Validator validator;
+    return validator.feed(text.data(), split) &&
+           validator.feed(text.data() + split, text.size() - split) &&
+           validator.complete();
+}
+
+struct Case {
+    Bytes bytes;
+    bool valid;
+};
+
+const Case CASES[] = {
+    // Границы длин
+    {{0x7F}, true},
+    {{0xC2, 0x80}, true},
+    {{0xDF, 0xBF}, true},
+    {{0xE0, 0xA0, 0x80}, true},
+    {{0xEF, 0xBF, 0xBF}, true},
+    {{0xF0, 0x90, 0x80, 0x80}, true},
+    {{0xF4, 0x8F, 0xBF, 0xBF}, true},
+    // Overlong
+    {{0xC0, 0x80}, false},
+    {{0xC1, 0xBF}, false},
+    {{0xE0, 0x80, 0x80}, false},
+    {{0xE0, 0x9F, 0xBF}, false},
+    {{0xF0, 0x80, 0x80, 0x80}, false},
+    {{0xF0, 0x8F, 0xBF, 0xBF}, false},
+    // Суррогаты и их соседи
+    {{0xED, 0x9F, 0xBF}, true},
+    {{0xED, 0xA0, 0x80}, false},
+    {{0xED, 0xAD, 0xBF}, false},
+    {{0xED, 0xB0, 0x80}, false},
+    {{0xED, 0xBF, 0xBF}, false},
+    {{0xEE, 0x80, 0x80}, true},
+    // Выше U+10FFFF и байты, которых нет в UTF-8
+    {{0xF4, 0x90, 0x80, 0x80}, false},
+    {{0xF5, 0x80, 0x80, 0x80}, false},
+    {{0xFF}, false},
+    // Обрывы и лишние продолжения
+    {{0x80}, false},
+    {{0xC2, 0x41}, false},
+    {{0xE1, 0x80, 0x41}, false},
+    {{0xF1, 0x80, 0x80, 0x41}, false},
+    {{0xC2, 0x80, 0x80}, false},
+};
+
+void testCasesAtEveryOffset() {
+    for (const Case& c : CASES) {
+        CHECK(Utf8Validator::validate(c.bytes.data(), c.bytes.size()) == c.valid);
+        // Сдвиги покрывают все позиции в блоках по 16 и 32 байта и стык блоков
+        for (size_t offset = 0; offset + c.bytes.size() <= 80; ++offset) {
+            const Bytes text = padded(c.bytes, offset);
+            CHECK(Utf8Validator::validate(text.data(), text.size()) == c.valid);
+        }
+    }
+}
+
+void testAgainstReference() {
+    // 40 байт ASCII впереди: проверяемый символ попадает в ядро, а не в автомат
+    constexpr size_t OFFSET = 40;
+    uint8_t text[64];
+    std::memset(text, 'a', sizeof(text));
+    size_t mismatches = 0;
+
+    for (unsigned a = 0x80; a <= 0xFF; ++a) {
+        for (unsigned b = 0; b <= 0xFF; ++b) {
+            text[OFFSET] = static_cast<uint8_t>(a);
+            text[OFFSET + 1] = static_cast<uint8_t>(b);
+            text[OFFSET + 2] = 'a';
+            text[OFFSET + 3] = 'a';
+            mismatches += Utf8Validator::validate(text, sizeof(text)) != referenceValid(text, sizeof(text));
+
+            if (a < 0xE0) continue;
+            for (unsigned c = 0; c <= 0xFF; ++c) {
+                text[OFFSET + 2] = static_cast<uint8_t>(c);
+                mismatches += Utf8Validator::validate(text, sizeof(text)) != referenceValid(text, sizeof(text));
+            }
+            if (a < 0xF0) continue;
+            // Четвёртый байт — на границах диапазона продолжений
+            for (unsigned c : {0x7Fu, 0x80u, 0xBFu, 0xC0u}) {
+                for (unsigned d : {0x7Fu, 0x80u, 0xBFu, 0xC0u}) {
+                    text[OFFSET + 2] = static_cast<uint8_t>(c);
+                    text[OFFSET + 3] = static_cast<uint8_t>(d);
+                    mismatches += Utf8Validator::validate(text, sizeof(text)) != referenceValid(text, sizeof(text));
+                }
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+void testSplitFeed() {
+    for (const Case& c : CASES) {
+        // Короткий текст идёт через автомат, длинный — через ядро
+        for (size_t total : {size_t(8), size_t(128)}) {
+            const size_t offset = total - c.bytes.size() - 2;
+            const Bytes text = padded(c.bytes, offset, total);
+            for (size_t split = offset; split <= offset + c.bytes.size(); ++split) {
+                CHECK(feedSplit(text, split) == c.valid);
+            }
+        }
+    }
+}
+
+void testTruncatedTail() {
+    const Bytes four = {0xF0, 0x9F, 0x98, 0x80};
+    for (size_t cut = 1; cut < four.size(); ++cut) {
+        Bytes text(100 + cut, 'a');
+        std::memcpy(text.data() + 100, four.data(), cut);
+        Utf8Validator validator;
+        CHECK(validator.feed(text.data(), text.size()));
+        CHECK(!validator.complete());
+        CHECK(!Utf8Validator::validate(text.data(), text.size()));
+        // Дописанный символ завершает текст
+        CHECK(validator.feed(four.data() + cut, four.size() - cut));
+        CHECK(validator.complete());
+    }
+    // Ошибка залипает до reset()
+    Utf8Validator validator;
+    const uint8_t bad = 0xFF, good = 'a';
+    CHECK(!validator.feed(&bad, 1));
+    CHECK(!validator.feed(&good, 1));
+    CHECK(validator.failed());
+    validator.reset();
+    CHECK(validator.feed(&good, 1) && validator.complete());
+}
+
+void testUnmaskChunkBoundary() {
+    // unmaskUtf8 кормит валидатор кусками по 4 КиБ
+    constexpr size_t CHUNK = 4096;
+    FrameHeader header{};
+    header.masked = true;
+    header.masking_key = 0x5A3C9E17;
+
+    for (const Case& c : CASES) {
+        if (c.bytes.size() < 2) continue;
+        for (size_t before = 1; before < c.bytes.size(); ++before) {
+            const Bytes text = padded(c.bytes, CHUNK - before, 2 * CHUNK);
+            Bytes payload = text;
+            Frame::applyMask(header.masking_key, payload.data(), payload.size());
+
+            Utf8Validator validator;
+            const bool ok = Frame::unmaskUtf8(header, payload.data(), payload.size(), validator) &&
+                            validator.complete();
+            CHECK(ok == c.valid);
+            CHECK(!c.valid || payload == text);
+        }
+    }
+
+    // То же при снятии маски частями, как при приёме по кускам: второй
+    // вызов начинается посреди символа и не на границе маски
+    const Bytes snowman = {0xE2, 0x98, 0x83};
+    const Bytes text = padded(snowman, CHUNK + 5, 2 * CHUNK);
+    Bytes payload = text;
+    Frame::applyMask(header.masking_key, payload.data(), payload.size());
+    Utf8Validator validator;
+    const size_t first = CHUNK + 6;
+    CHECK(Frame::unmaskUtf8(header, payload.data(), first, validator));
+    CHECK(!validator.complete());
+    CHECK(Frame::unmaskUtf8(header, payload.data() + first, payload.size() - first, validator, first));
+    CHECK(validator.complete());
+    CHECK(payload == text);
+}
+
+}  // namespace
+
+int main() {
+    testCasesAtEveryOffset();
+    testAgainstReference();
+    testSplitFeed();
+    testTruncatedTail();
+    testUnmaskChunkBoundary();
+    return test::report("utf8_validator_test");
+}
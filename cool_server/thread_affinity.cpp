@@ -0,0 +1,70 @@
+#include "thread_affinity.h"
+#include "platform.h"
+#include <iostream>
+#include <thread>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+bool ThreadAffinity::pinCurrentThread(int cpu) {
+    if (cpu < 0) return false;
+
+#ifdef _WIN32
+    GROUP_AFFINITY affinity{};
+    affinity.Group = static_cast<WORD>(cpu / 64);
+    affinity.Mask = KAFFINITY(1) << (cpu % 64);
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr)) {
+        std::cerr << "SetThreadGroupAffinity failed for CPU " << cpu << ": " << GetLastError() << "\n";
+        return false;
+    }
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) {
+        std::cerr << "pthread_setaffinity_np failed for CPU " << cpu << ": " << rc << "\n";
+        return false;
+    }
+#endif
+    return true;
+}
+
+int ThreadAffinity::cpuCount() {
+    unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? static_cast<int>(count) : 1;
+}
+
+std::vector<int> ThreadAffinity::availableCpus() {
+    std::vector<int> cpus;
+#ifdef _WIN32
+    // Маска процесса покрывает только его группу процессоров
+    DWORD_PTR process_mask = 0, system_mask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+        for (int cpu = 0; cpu < static_cast<int>(sizeof(process_mask) * 8); ++cpu) {
+            if (process_mask & (DWORD_PTR(1) << cpu)) cpus.push_back(cpu);
+        }
+    }
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (int cpu = 0; cpu < cpuCount(); ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+int ThreadAffinity::cpuForSlot(const ThreadPlacement& placement, int slot) {
+    if (!placement.pin || slot < 0) return -1;
+    if (!placement.cpus.empty()) return placement.cpus[slot % placement.cpus.size()];
+    static const std::vector<int> cpus = availableCpus();
+    return cpus[slot % cpus.size()];
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+// Размещение рабочих потоков по процессорам и узлам NUMA
+struct ThreadPlacement {
+    // Потоков общего цикла (shards == 0); 0 — по числу процессоров
+    int workers = 0;
+    // Закреплять каждый поток за процессором: в общем цикле поток i,
+    // в шардированном — шард i берёт i-й процессор списка по кругу
+    bool pin = true;
+    // Процессоры по порядку; пусто — все, доступные процессу
+    std::vector<int> cpus;
+    // Слэбы соединений цикла — из памяти узла его процессора
+    bool numa_local = true;
+};
+
+// Привязка рабочих потоков к процессорам
+class ThreadAffinity {
+public:
+    // Закрепляет текущий поток за логическим процессором cpu
+    static bool pinCurrentThread(int cpu);
+
+    // Число логических процессоров (минимум 1)
+    static int cpuCount();
+
+    // Процессоры, на которых процессу разрешено выполняться, по возрастанию
+    static std::vector<int> availableCpus();
+
+    // Процессор для потока или шарда slot; -1 — не закреплять
+    static int cpuForSlot(const ThreadPlacement& placement, int slot);
+};
@@ -0,0 +1,136 @@
+#include "timer_wheel.h"
+#include <climits>
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, Clock::time_point start)
+    : tick_(tick.count() > 0 ? tick : std::chrono::milliseconds(1)),
+      start_(start) {
+    for (auto& level : slots_) {
+        for (TimerNode& head : level) {
+            head.prev = head.next = &head;
+        }
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    // Оставшиеся таймеры просто отцепляем: владельцы увидят их невзведёнными
+    for (auto& level : slots_) {
+        for (TimerNode& head : level) {
+            while (head.next != &head) unlink(head.next);
+        }
+    }
+}
+
+void TimerWheel::schedule(TimerNode* timer, std::chrono::milliseconds delay, Clock::time_point now) {
+    if (timer->armed()) {
+        unlink(timer);
+        --size_;
+    }
+
+    // Тик t разбирается не раньше start_ + t * tick_, поэтому срок
+    // округляем вверх до начала тика. От номера текущего тика считать
+    // нельзя: посреди тика таймер сработал бы на долю тика раньше срока
+    const auto due = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_ + delay).count();
+    const auto tick = std::chrono::duration_cast<std::chrono::nanoseconds>(tick_).count();
+    timer->expires = due > 0 ? static_cast<uint64_t>((due + tick - 1) / tick) : 0;
+    insert(timer);
+    ++size_;
+}
+
+bool TimerWheel::cancel(TimerNode* timer) {
+    if (!timer->armed()) return false;
+    unlink(timer);
+    --size_;
+    return true;
+}
+
+void TimerWheel::advance(Clock::time_point now, std::vector<TimerNode*>& expired) {
+    const uint64_t target = tickOf(now);
+    while (current_ <= target) {
+        if (size_ == 0) {
+            // Пустое колесо проматываем сразу
+            current_ = target + 1;
+            break;
+        }
+
+        const unsigned index = current_ & SLOT_MASK;
+        if (index == 0) cascade(1);
+
+        TimerNode& head = slots_[0][index];
+        while (head.next != &head) {
+            TimerNode* timer = head.next;
+            unlink(timer);
+            --size_;
+            expired.push_back(timer);
+        }
+        ++current_;
+    }
+}
+
+int TimerWheel::timeoutMs(Clock::time_point now) const {
+    if (size_ == 0) return -1;
+
+    // Ближайшая непустая ячейка младшего колеса; если до конца оборота
+    // пусто — просыпаемся к раскладке старшего
+    uint64_t tick = current_;
+    if ((tick & SLOT_MASK) != 0) {
+        const uint64_t boundary = (tick | SLOT_MASK) + 1;
+        while (tick < boundary) {
+            const TimerNode& head = slots_[0][tick & SLOT_MASK];
+            if (head.next != &head) break;
+            ++tick;
+        }
+    }
+
+    const Clock::time_point due = start_ + tick_ * tick;
+    if (due <= now) return 0;
+    const auto wait = std::chrono::ceil<std::chrono::milliseconds>(due - now).count();
+    return wait > INT_MAX ? INT_MAX : static_cast<int>(wait);
+}
+
+uint64_t TimerWheel::tickOf(Clock::time_point time) const {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(time - start_);
+    return static_cast<uint64_t>(elapsed.count() / tick_.count());
+}
+
+void TimerWheel::insert(TimerNode* timer) {
+    constexpr uint64_t MAX_DELTA = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+
+    if (timer->expires < current_) timer->expires = current_;
+    if (timer->expires - current_ > MAX_DELTA) timer->expires = current_ + MAX_DELTA;
+
+    // Уровень — по расстоянию до срабатывания, ячейка — по самому тику
+    const uint64_t delta = timer->expires - current_;
+    unsigned level = 0;
+    while (level + 1 < LEVELS && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        ++level;
+    }
+    const unsigned index = (timer->expires >> (SLOT_BITS * level)) & SLOT_MASK;
+
+    TimerNode& head = slots_[level][index];
+    timer->next = &head;
+    timer->prev = head.prev;
+    head.prev->next = timer;
+    head.prev = timer;
+}
+
+void TimerWheel::cascade(unsigned level) {
+    const unsigned index = (current_ >> (SLOT_BITS * level)) & SLOT_MASK;
+
+    // Забираем ячейку целиком и раскладываем её таймеры по младшим колёсам
+    TimerNode& head = slots_[level][index];
+    TimerNode* timer = head.next;
+    head.prev = head.next = &head;
+    while (timer != &head) {
+        TimerNode* next = timer->next;
+        insert(timer);
+        timer = next;
+    }
+
+    if (index == 0 && level + 1 < LEVELS) cascade(level + 1);
+}
+
+void TimerWheel::unlink(TimerNode* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer->next = nullptr;
+}
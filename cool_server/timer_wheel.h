@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Узел таймера. Встраивается в объект-владельца, поэтому взвести
+// или снять таймер — это O(1) без выделения памяти
+struct TimerNode {
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+    uint64_t expires = 0;  // Тик срабатывания
+
+    bool armed() const { return next != nullptr; }
+};
+
+// Иерархическое колесо таймеров (Varghese & Lauck): LEVELS колёс по
+// SLOTS ячеек, каждое следующее в SLOTS раз грубее. Таймер кладётся в
+// ячейку по своему тику, а при обороте младшего колеса ячейка старшего
+// раскладывается вниз. Постановка и снятие — O(1) при любом числе
+// таймеров. Потокобезопасность обеспечивает владелец.
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // start — момент начала тика 0
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(10),
+                        Clock::time_point start = Clock::now());
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Взводит таймер (взведённый — перевзводит). Срабатывает не раньше now + delay
+    void schedule(TimerNode* timer, std::chrono::milliseconds delay, Clock::time_point now = Clock::now());
+    // false — таймер не был взведён
+    bool cancel(TimerNode* timer);
+
+    // Прокручивает колесо до now и дописывает сработавшие таймеры в expired
+    void advance(Clock::time_point now, std::vector<TimerNode*>& expired);
+
+    // Сколько миллисекунд можно ждать до ближайшего тика с работой; -1 — таймеров нет
+    int timeoutMs(Clock::time_point now) const;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr unsigned SLOTS = 1u << SLOT_BITS;
+    static constexpr unsigned SLOT_MASK = SLOTS - 1;
+    static constexpr unsigned LEVELS = 4;  // 2^24 тиков: при 10 мс — больше 46 часов
+
+    uint64_t tickOf(Clock::time_point time) const;
+    void insert(TimerNode* timer);
+    void cascade(unsigned level);
+
+    static void unlink(TimerNode* timer);
+
+    std::chrono::milliseconds tick_;
+    Clock::time_point start_;
+    uint64_t current_ = 0;  // Следующий необработанный тик
+    size_t size_ = 0;
+    TimerNode slots_[LEVELS][SLOTS];  // Головы кольцевых списков
+};
@@ -0,0 +1,850 @@
+#include "iocp_core.h"
+
+#if !defined(_WIN32) && defined(COOL_SERVER_IO_URING)
+
+#include "buffer_pool.h"
+#include "numa.h"
+#include "socket_utils.h"
+#include "thread_affinity.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <condition_variable>
+#include <iostream>
+
+// Linux-бэкенд IOCPCore на io_uring (проактор, как и IOCP).
+// - listen-сокет обслуживает один multishot accept: повторный asyncAccept
+//   не делает системного вызова, а забирает уже принятый сокет из очереди;
+// - каждый сокет соединения держит один multishot recv с буферами из
+//   provided buffer ring: данные копируются в буфер операции asyncRecv,
+//   остаток откладывается до следующего вызова, и новый recv не ставится.
+// Кольцом владеет первый рабочий поток: он отправляет SQE пачкой вместе
+// с ожиданием и разбирает CQE; остальные потоки только выполняют коллбэки.
+
+namespace {
+    constexpr unsigned RING_ENTRIES = 4096;
+    constexpr unsigned MAX_BUFFER_COUNT = 32768;     // bid — 16 бит, кольцо — до 2^15
+    constexpr uint16_t BUFFER_GROUP = 0;
+    constexpr uint64_t WAKE_TAG = 1;                 // user_data для NOP-пробуждения
+    constexpr DWORD RING_FULL = EBUSY;               // Ошибка операции, не попавшей в очередь SQ
+    // Сколько непрочитанных данных сокет копит до asyncRecv. Выше — multishot
+    // recv снимается, и отправителя придерживает окно TCP
+    constexpr size_t STASH_LIMIT = 64 * 1024;
+
+    int ioUringSetup(unsigned entries, io_uring_params* params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int ioUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    // Ожидание CQE с таймаутом; timeout_ms < 0 — без таймаута.
+    // IORING_ENTER_EXT_ARG есть с 5.11, multishot recv требует ещё более нового ядра
+    int ioUringWait(int fd, unsigned to_submit, unsigned min_complete, int timeout_ms) {
+        if (timeout_ms < 0 || min_complete == 0) {
+            return ioUringEnter(fd, to_submit, min_complete, IORING_ENTER_GETEVENTS);
+        }
+        __kernel_timespec ts{};
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+        io_uring_getevents_arg arg{};
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                                        IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                                        &arg, sizeof(arg)));
+    }
+
+    int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+        return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+    }
+}
+
+struct IOCPCore::UringState {
+    enum class OpType { Recv, Accept, Send };
+
+    struct Socket;
+
+    // Операция в ядре; адрес служит user_data в SQE
+    struct Op {
+        OpType type;
+        std::shared_ptr<Socket> socket;
+        LPOVERLAPPED overlapped = nullptr;
+        std::vector<iovec> iov;
+        msghdr msg{};
+        size_t transferred = 0;
+        size_t total = 0;
+    };
+
+    // Кусок данных одного CQE, ещё не отданный asyncRecv
+    struct StashChunk {
+        websocket::PooledBuffer data;
+        size_t offset = 0;
+    };
+
+    struct PendingRecv {
+        LPOVERLAPPED overlapped;
+        std::vector<WSABUF> buffers;
+    };
+
+    struct Socket {
+        SOCKET fd;
+        ULONG_PTR key;
+        std::mutex mutex;
+        Op* multishot = nullptr;           // Взведённый recv или accept
+        bool recv_paused = false;          // Multishot recv отменяется из-за полного stash
+        bool closed = false;
+        bool eof = false;
+        int error = 0;
+        // Данные, пришедшие раньше asyncRecv: куски из пула, прочитанный
+        // кусок сразу возвращается в пул — разобранный stash памяти не держит
+        std::deque<StashChunk> stash;
+        size_t stash_bytes = 0;
+        std::deque<PendingRecv> reads;
+        std::deque<SOCKET> accepted;
+        std::deque<AcceptOperation*> accepts;
+
+        size_t stashed() const { return stash_bytes; }
+    };
+
+    IOCPCore& core;
+
+    int ring_fd = -1;
+    void* sq_ptr = MAP_FAILED;
+    size_t sq_size = 0;
+    void* cq_ptr = MAP_FAILED;
+    size_t cq_size = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size = 0;
+
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned cq_mask = 0;
+
+    std::mutex sq_mutex;
+    unsigned sqe_tail = 0;                 // Локальный хвост, ещё не опубликованный
+
+    // Кольцо буферов адресуем как массив io_uring_buf: в C++ flex-массив
+    // из io_uring_buf_ring смещён на 8 байт, а хвост лежит в bufs[0].resv
+    io_uring_buf* buf_ring = static_cast<io_uring_buf*>(MAP_FAILED);
+    size_t buf_ring_size = 0;
+    uint8_t* buffers = nullptr;            // buffer_count * buffer_size на узле цикла
+    unsigned buffer_count = 0;             // Степень двойки
+    unsigned buffer_size = 0;
+    uint16_t buf_tail = 0;
+
+    std::shared_mutex sockets_mutex;
+    std::unordered_map<SOCKET, std::shared_ptr<Socket>> sockets;
+
+    std::mutex completions_mutex;
+    std::vector<Completion> completions;   // Завершения без CQE (postCompletion, данные из stash)
+
+    std::mutex ready_mutex;
+    std::condition_variable ready_cv;
+    std::deque<Completion> ready;          // Для вспомогательных потоков
+
+    std::thread::id ring_thread;
+
+    explicit UringState(IOCPCore& owner) : core(owner) {}
+    ~UringState();
+
+    bool init();
+    bool onRingThread() const { return std::this_thread::get_id() == ring_thread; }
+
+    io_uring_sqe* getSqe();
+    unsigned pendingSqes() const;
+    int submitLocked();
+    void submitNow();
+    void wake();
+
+    // false — очередь SQ полна и после отправки накопленного: операция не поставлена
+    bool armRecv(const std::shared_ptr<Socket>& socket);
+    bool armAccept(const std::shared_ptr<Socket>& socket);
+    bool prepareSend(Op* op, size_t advance);
+    bool cancelMultishot(Socket& socket);
+    void recycleBuffer(uint16_t bid);
+
+    void fillReads(Socket& socket, std::vector<Completion>& out);
+    void failAccepts(Socket& socket, DWORD error, std::vector<Completion>& out);
+    void handleCqe(const io_uring_cqe& cqe, std::vector<Completion>& out);
+    void enqueue(const Completion& completion);
+    std::shared_ptr<Socket> find(SOCKET fd);
+};
+
+IOCPCore::UringState::~UringState() {
+    Numa::release(buffers, static_cast<size_t>(buffer_count) * buffer_size);
+    if (buf_ring != MAP_FAILED) munmap(buf_ring, buf_ring_size);
+    if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+    if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+    if (ring_fd >= 0) ::close(ring_fd);
+}
+
+bool IOCPCore::UringState::init() {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = RING_ENTRIES * 4;  // multishot даёт много CQE на одну SQE
+
+    ring_fd = ioUringSetup(RING_ENTRIES, &params);
+    if (ring_fd < 0) return false;
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_size = cq_size = std::max(sq_size, cq_size);
+    }
+
+    sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) return false;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ptr = sq_ptr;
+    } else {
+        cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) return false;
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) return false;
+
+    auto* sq = static_cast<uint8_t*>(sq_ptr);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqe_tail = *sq_tail;
+
+    auto* cq = static_cast<uint8_t*>(cq_ptr);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Provided buffer ring: ядро само выбирает буфер под каждый recv
+    const RecvRingConfig& config = core.recv_ring_;
+    buffer_count = 1;
+    while (buffer_count < std::min(std::max(config.count, 1u), MAX_BUFFER_COUNT)) buffer_count <<= 1;
+    buffer_size = std::max(config.size, 1u);
+
+    buf_ring_size = buffer_count * sizeof(io_uring_buf);
+    buf_ring = static_cast<io_uring_buf*>(mmap(nullptr, buf_ring_size, PROT_READ | PROT_WRITE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (buf_ring == MAP_FAILED) return false;
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+    reg.ring_entries = buffer_count;
+    reg.bgid = BUFFER_GROUP;
+    if (ioUringRegister(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+
+    // Страницы не трогаем: ядро выдаст их нулевыми при первой записи,
+    // уже на узле цикла, а не на узле потока, вызвавшего setup()
+    buffers = static_cast<uint8_t*>(Numa::allocate(static_cast<size_t>(buffer_count) * buffer_size,
+                                                   core.memory_node_));
+    if (!buffers) return false;
+    for (unsigned i = 0; i < buffer_count; ++i) {
+        recycleBuffer(static_cast<uint16_t>(i));
+    }
+    return true;
+}
+
+io_uring_sqe* IOCPCore::UringState::getSqe() {
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sqe_tail - head >= sq_entries) {
+        // Очередь заполнена — отдаём накопленное ядру
+        submitLocked();
+        head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (sqe_tail - head >= sq_entries) return nullptr;
+    }
+
+    unsigned index = sqe_tail & sq_mask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    ++sqe_tail;
+    return sqe;
+}
+
+unsigned IOCPCore::UringState::pendingSqes() const {
+    // Всё, что ядро ещё не забрало, — и то, что оно не приняло прошлым
+    // вызовом (EBUSY, EAGAIN): такие SQE иначе так и остались бы в очереди
+    return sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+}
+
+int IOCPCore::UringState::submitLocked() {
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+    const unsigned count = pendingSqes();
+    if (count == 0) return 0;
+
+    core.syscalls_.fetch_add(1, std::memory_order_relaxed);
+    return ioUringEnter(ring_fd, count, 0, 0);
+}
+
+void IOCPCore::UringState::submitNow() {
+    // Поток кольца отправит всё вместе с ожиданием; остальные — сразу
+    if (onRingThread()) return;
+    std::lock_guard<std::mutex> lock(sq_mutex);
+    submitLocked();
+}
+
+void IOCPCore::UringState::wake() {
+    std::lock_guard<std::mutex> lock(sq_mutex);
+    if (io_uring_sqe* sqe = getSqe()) {
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = WAKE_TAG;
+    }
+    submitLocked();
+}
+
+bool IOCPCore::UringState::armRecv(const std::shared_ptr<Socket>& socket) {
+    std::lock_guard<std::mutex> lock(sq_mutex);
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return false;
+
+    auto* op = new Op{OpType::Recv, socket, nullptr, {}};
+    socket->multishot = op;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = socket->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = reinterpret_cast<uint64_t>(op);
+    return true;
+}
+
+bool IOCPCore::UringState::armAccept(const std::shared_ptr<Socket>& socket) {
+    std::lock_guard<std::mutex> lock(sq_mutex);
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return false;
+
+    auto* op = new Op{OpType::Accept, socket, nullptr, {}};
+    socket->multishot = op;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = socket->fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = reinterpret_cast<uint64_t>(op);
+    return true;
+}
+
+bool IOCPCore::UringState::prepareSend(Op* op, size_t advance) {
+    // Отбрасываем уже отправленные байты из начала iovec
+    size_t first = 0;
+    while (advance > 0 && first < op->iov.size()) {
+        if (advance >= op->iov[first].iov_len) {
+            advance -= op->iov[first].iov_len;
+            ++first;
+        } else {
+            op->iov[first].iov_base = static_cast<uint8_t*>(op->iov[first].iov_base) + advance;
+            op->iov[first].iov_len -= advance;
+            advance = 0;
+        }
+    }
+    op->iov.erase(op->iov.begin(), op->iov.begin() + first);
+
+    op->msg = msghdr{};
+    op->msg.msg_iov = op->iov.data();
+    op->msg.msg_iovlen = op->iov.size();
+
+    std::lock_guard<std::mutex> lock(sq_mutex);
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = op->socket->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&op->msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = reinterpret_cast<uint64_t>(op);
+    return true;
+}
+
+bool IOCPCore::UringState::cancelMultishot(Socket& socket) {
+    std::lock_guard<std::mutex> lock(sq_mutex);
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = reinterpret_cast<uint64_t>(socket.multishot);
+    sqe->user_data = 0;
+    return true;
+}
+
+void IOCPCore::UringState::recycleBuffer(uint16_t bid) {
+    io_uring_buf* buf = &buf_ring[buf_tail & (buffer_count - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(buffers + static_cast<size_t>(bid) * buffer_size);
+    buf->len = buffer_size;
+    buf->bid = bid;
+    ++buf_tail;
+    __atomic_store_n(&buf_ring[0].resv, buf_tail, __ATOMIC_RELEASE);
+}
+
+void IOCPCore::UringState::fillReads(Socket& socket, std::vector<Completion>& out) {
+    while (!socket.reads.empty()) {
+        const size_t available = socket.stash_bytes;
+        if (available == 0 && !socket.eof && socket.error == 0) break;
+
+        PendingRecv& read = socket.reads.front();
+        if (available == 0) {
+            // Конец потока или ошибка — так же, как у IOCP
+            if (socket.error != 0) {
+                out.push_back({false, 0, socket.key, read.overlapped, static_cast<DWORD>(socket.error)});
+            } else {
+                out.push_back({true, 0, socket.key, read.overlapped, 0});
+            }
+            socket.reads.pop_front();
+            continue;
+        }
+
+        size_t copied = 0;
+        for (const WSABUF& buf : read.buffers) {
+            size_t filled = 0;
+            while (filled < buf.len && !socket.stash.empty()) {
+                StashChunk& chunk = socket.stash.front();
+                const size_t n = std::min<size_t>(buf.len - filled, chunk.data.size() - chunk.offset);
+                std::memcpy(buf.buf + filled, chunk.data.data() + chunk.offset, n);
+                filled += n;
+                chunk.offset += n;
+                if (chunk.offset == chunk.data.size()) socket.stash.pop_front();
+            }
+            copied += filled;
+            if (socket.stash.empty()) break;
+        }
+        socket.stash_bytes -= copied;
+
+        out.push_back({true, static_cast<DWORD>(copied), socket.key, read.overlapped, 0});
+        socket.reads.pop_front();
+    }
+}
+
+void IOCPCore::UringState::failAccepts(Socket& socket, DWORD error, std::vector<Completion>& out) {
+    for (AcceptOperation* accept : socket.accepts) {
+        out.push_back({false, 0, socket.key, &accept->overlapped, error});
+    }
+    socket.accepts.clear();
+}
+
+void IOCPCore::UringState::handleCqe(const io_uring_cqe& cqe, std::vector<Completion>& out) {
+    if (cqe.user_data == 0 || cqe.user_data == WAKE_TAG) return;
+
+    Op* op = reinterpret_cast<Op*>(cqe.user_data);
+    Socket& socket = *op->socket;
+    const bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+
+    switch (op->type) {
+        case OpType::Recv: {
+            std::lock_guard<std::mutex> lock(socket.mutex);
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                if (cqe.res > 0 && !socket.closed) {
+                    StashChunk chunk{websocket::PooledBuffer(static_cast<size_t>(cqe.res))};
+                    std::memcpy(chunk.data.data(), buffers + static_cast<size_t>(bid) * buffer_size, cqe.res);
+                    chunk.data.resize(static_cast<size_t>(cqe.res));
+                    socket.stash.push_back(std::move(chunk));
+                    socket.stash_bytes += static_cast<size_t>(cqe.res);
+                }
+                recycleBuffer(bid);
+            }
+
+            if (cqe.res == 0) {
+                socket.eof = true;
+            } else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+                socket.error = -cqe.res;
+            }
+
+            if (!socket.closed) fillReads(socket, out);
+
+            if (more && !socket.recv_paused && !socket.closed && socket.stashed() >= STASH_LIMIT) {
+                // Читатель не успевает — снимаем recv; снова его взведёт asyncRecv,
+                // разобрав stash. Не вышло — попробуем на следующем CQE
+                socket.recv_paused = cancelMultishot(socket);
+            }
+
+            if (!more) {
+                // Multishot закончился (кончились буферы, EOF или отмена)
+                std::shared_ptr<Socket> self = op->socket;
+                socket.multishot = nullptr;
+                socket.recv_paused = false;
+                delete op;
+                if (!socket.closed && !socket.eof && socket.error == 0 &&
+                    socket.stashed() < STASH_LIMIT && !armRecv(self)) {
+                    // Не взвели — читатель получит ошибку и закроет соединение
+                    socket.error = RING_FULL;
+                    fillReads(socket, out);
+                }
+            }
+            return;
+        }
+
+        case OpType::Accept: {
+            std::lock_guard<std::mutex> lock(socket.mutex);
+            if (cqe.res >= 0) {
+                if (socket.closed) {
+                    ::close(cqe.res);
+                } else if (!socket.accepts.empty()) {
+                    AcceptOperation* accept = socket.accepts.front();
+                    socket.accepts.pop_front();
+                    accept->socket = cqe.res;
+                    out.push_back({true, 0, socket.key, &accept->overlapped, 0});
+                } else {
+                    socket.accepted.push_back(cqe.res);
+                }
+            } else if (!socket.accepts.empty() && cqe.res != -ECANCELED) {
+                AcceptOperation* accept = socket.accepts.front();
+                socket.accepts.pop_front();
+                out.push_back({false, 0, socket.key, &accept->overlapped, static_cast<DWORD>(-cqe.res)});
+            }
+
+            if (!more) {
+                // Multishot accept кончается на ошибке (EMFILE, ENFILE, ENOBUFS).
+                // Перевзводим, только пока его ждут: иначе он падал бы снова
+                // и снова. Следующий asyncAccept взведёт его сам
+                std::shared_ptr<Socket> self = op->socket;
+                socket.multishot = nullptr;
+                delete op;
+                if (!socket.closed && !socket.accepts.empty() && !armAccept(self)) {
+                    failAccepts(socket, RING_FULL, out);
+                }
+            }
+            return;
+        }
+
+        case OpType::Send: {
+            if (cqe.res < 0) {
+                out.push_back({false, 0, socket.key, op->overlapped, static_cast<DWORD>(-cqe.res)});
+                delete op;
+                return;
+            }
+
+            op->transferred += static_cast<size_t>(cqe.res);
+            if (op->transferred < op->total && cqe.res > 0) {
+                // Частичная отправка — досылаем остаток той же операцией
+                if (prepareSend(op, static_cast<size_t>(cqe.res))) return;
+                out.push_back({false, 0, socket.key, op->overlapped, RING_FULL});
+                delete op;
+                return;
+            }
+
+            out.push_back({true, static_cast<DWORD>(op->transferred), socket.key, op->overlapped, 0});
+            delete op;
+            return;
+        }
+    }
+}
+
+void IOCPCore::UringState::enqueue(const Completion& completion) {
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        completions.push_back(completion);
+    }
+    if (!onRingThread()) wake();
+}
+
+std::shared_ptr<IOCPCore::UringState::Socket> IOCPCore::UringState::find(SOCKET fd) {
+    std::shared_lock<std::shared_mutex> lock(sockets_mutex);
+    auto it = sockets.find(fd);
+    return it != sockets.end() ? it->second : nullptr;
+}
+
+IOCPCore::IOCPCore()
+    : uring_(std::make_unique<UringState>(*this)),
+      is_running_(false) {}
+
+IOCPCore::~IOCPCore() {
+    stop();
+}
+
+bool IOCPCore::setup() {
+    if (!uring_->init()) {
+        std::cerr << "Failed to set up io_uring: " << SocketUtils::getLastErrorString() << "\n";
+        return false;
+    }
+    return true;
+}
+
+void IOCPCore::associateSocket(SOCKET socket, CompletionHandler* handler) {
+    ULONG_PTR key = reinterpret_cast<ULONG_PTR>(handler);
+    std::unique_lock<std::shared_mutex> lock(uring_->sockets_mutex);
+    auto& state = uring_->sockets[socket];
+    if (state) {
+        std::lock_guard<std::mutex> state_lock(state->mutex);
+        state->key = key;
+        return;
+    }
+    state = std::make_shared<UringState::Socket>();
+    state->fd = socket;
+    state->key = key;
+}
+
+void IOCPCore::runWorkerThreads(int count, const std::vector<int>& cpus) {
+    is_running_ = true;
+    workers_.reserve(count);
+    auto cpuOf = [&cpus](int i) { return cpus.empty() ? -1 : cpus[i % cpus.size()]; };
+
+    // Поток 0 владеет кольцом
+    workers_.emplace_back([this, count, cpu = cpuOf(0)]() {
+        if (cpu >= 0) ThreadAffinity::pinCurrentThread(cpu);
+        current_ = this;
+        UringState& u = *uring_;
+        u.ring_thread = std::this_thread::get_id();
+        std::vector<Completion> batch;
+        BusyPoller poller(busy_poll_, busy_poll_stats_);
+
+        while (is_running_) {
+            bool have_local;
+            {
+                std::lock_guard<std::mutex> lock(u.completions_mutex);
+                have_local = !u.completions.empty();
+            }
+
+            unsigned count_to_submit;
+            {
+                std::lock_guard<std::mutex> lock(u.sq_mutex);
+                __atomic_store_n(u.sq_tail, u.sqe_tail, __ATOMIC_RELEASE);
+                count_to_submit = u.pendingSqes();
+            }
+
+            // Ждать нечего — сначала смотрим на хвост CQ без системного вызова.
+            // Накопленные SQE уходят ядру до опроса, иначе их некому завершить;
+            // завершения из других потоков приходят NOP-пробуждением в тот же CQ
+            bool spun = false;
+            if (!have_local && poller.enabled()) {
+                if (count_to_submit > 0) {
+                    syscalls_.fetch_add(1, std::memory_order_relaxed);
+                    ioUringEnter(u.ring_fd, count_to_submit, 0, 0);
+                    count_to_submit = 0;
+                }
+                spun = poller.spin([&] {
+                    return __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE) != *u.cq_head ? 1 : 0;
+                }, timerTimeout()) != 0;
+            }
+
+            int ret = 0;
+            if (!spun) {
+                if (!have_local) poller.park();
+                syscalls_.fetch_add(1, std::memory_order_relaxed);
+                ret = ioUringWait(u.ring_fd, count_to_submit, have_local ? 0 : 1, timerTimeout());
+            }
+            if (!is_running_) break;
+            if (ret < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN && errno != ETIME) {
+                std::cerr << "io_uring_enter failed: " << SocketUtils::getLastErrorString() << "\n";
+                break;
+            }
+
+            batch.clear();
+            unsigned head = *u.cq_head;
+            unsigned tail = __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE);
+            while (head != tail) {
+                u.handleCqe(u.cqes[head & u.cq_mask], batch);
+                ++head;
+            }
+            __atomic_store_n(u.cq_head, head, __ATOMIC_RELEASE);
+
+            {
+                std::lock_guard<std::mutex> lock(u.completions_mutex);
+                batch.insert(batch.end(), u.completions.begin(), u.completions.end());
+                u.completions.clear();
+            }
+
+            if (count == 1) {
+                for (const Completion& c : batch) {
+                    dispatch(c.ok, c.bytes, c.key, c.overlapped, c.error);
+                }
+            } else if (!batch.empty()) {
+                {
+                    std::lock_guard<std::mutex> lock(u.ready_mutex);
+                    u.ready.insert(u.ready.end(), batch.begin(), batch.end());
+                }
+                u.ready_cv.notify_all();
+            }
+
+            // Таймеры крутит поток кольца: он и так просыпается к ближайшему
+            runTimers();
+        }
+    });
+
+    for (int i = 1; i < count; ++i) {
+        workers_.emplace_back([this, cpu = cpuOf(i)]() {
+            if (cpu >= 0) ThreadAffinity::pinCurrentThread(cpu);
+            current_ = this;
+            UringState& u = *uring_;
+            while (true) {
+                Completion c;
+                {
+                    std::unique_lock<std::mutex> lock(u.ready_mutex);
+                    u.ready_cv.wait(lock, [&] { return !is_running_ || !u.ready.empty(); });
+                    if (!is_running_) break;
+                    c = u.ready.front();
+                    u.ready.pop_front();
+                }
+                dispatch(c.ok, c.bytes, c.key, c.overlapped, c.error);
+            }
+        });
+    }
+}
+
+void IOCPCore::stop() {
+    if (!is_running_) return;
+
+    is_running_ = false;
+    uring_->wake();
+    uring_->ready_cv.notify_all();
+
+    for (auto& thread : workers_) {
+        if (thread.joinable()) thread.join();
+    }
+    workers_.clear();
+}
+
+void IOCPCore::postCompletion(DWORD bytes, CompletionHandler* handler, LPOVERLAPPED overlapped) {
+    ULONG_PTR key = reinterpret_cast<ULONG_PTR>(handler);
+    uring_->enqueue({true, bytes, key, overlapped, 0});
+}
+
+bool IOCPCore::zeroByteReads() {
+    // Настройку ServerConfig::zero_byte_reads здесь намеренно не слушаем:
+    // multishot recv и так пишет в общее кольцо буферов цикла, а не в буфер
+    // соединения, так что простаивающее соединение буфера не держит. Чтение
+    // нулевой длины дало бы только лишнее завершение на каждую пачку данных
+    return false;
+}
+
+bool IOCPCore::asyncRecv(SOCKET socket, WSABUF* buffers, DWORD count, LPOVERLAPPED overlapped) {
+    auto state = uring_->find(socket);
+    if (!state) return false;
+
+    std::vector<Completion> done;
+    bool arm = false;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->reads.push_back({overlapped, std::vector<WSABUF>(buffers, buffers + count)});
+        uring_->fillReads(*state, done);
+
+        // Первый recv взводит multishot, дальше системных вызовов нет.
+        // Он же взводит recv заново, когда stash разобран ниже предела
+        if (!state->multishot && !state->eof && state->error == 0 && state->stashed() < STASH_LIMIT) {
+            arm = uring_->armRecv(state);
+            if (!arm) {
+                state->error = RING_FULL;
+                uring_->fillReads(*state, done);
+            }
+        }
+    }
+
+    for (const Completion& c : done) uring_->enqueue(c);
+    if (arm) uring_->submitNow();
+    return true;
+}
+
+bool IOCPCore::asyncSend(SOCKET socket, WSABUF* buffers, DWORD count, LPOVERLAPPED overlapped) {
+    auto state = uring_->find(socket);
+    if (!state) return false;
+
+    auto* op = new UringState::Op{UringState::OpType::Send, state, overlapped, {}};
+    op->iov.reserve(count);
+    for (DWORD i = 0; i < count; ++i) {
+        op->iov.push_back({buffers[i].buf, buffers[i].len});
+        op->total += buffers[i].len;
+    }
+
+    if (!uring_->prepareSend(op, 0)) {
+        // Как у epoll: ошибка приходит завершением, владелец закроет соединение
+        uring_->enqueue({false, 0, state->key, overlapped, RING_FULL});
+        delete op;
+        return true;
+    }
+    uring_->submitNow();
+    return true;
+}
+
+bool IOCPCore::asyncAccept(SOCKET listen_socket, AcceptOperation* op) {
+    auto state = uring_->find(listen_socket);
+    if (!state) return false;
+
+    ZeroMemory(&op->overlapped, sizeof(OVERLAPPED));
+    op->socket = INVALID_SOCKET;
+
+    std::vector<Completion> failed;
+    bool arm = false;
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->accepted.empty()) {
+            // Сокет уже принят multishot-accept'ом — системный вызов не нужен
+            op->socket = state->accepted.front();
+            state->accepted.pop_front();
+            ready = true;
+        } else {
+            state->accepts.push_back(op);
+        }
+
+        if (!state->multishot) {
+            arm = uring_->armAccept(state);
+            if (!arm) uring_->failAccepts(*state, RING_FULL, failed);
+        }
+    }
+
+    if (ready) uring_->enqueue({true, 0, state->key, &op->overlapped, 0});
+    for (const Completion& c : failed) uring_->enqueue(c);
+    if (arm) uring_->submitNow();
+    return true;
+}
+
+void IOCPCore::closeSocket(SOCKET socket) {
+    std::shared_ptr<UringState::Socket> state;
+    {
+        std::unique_lock<std::shared_mutex> lock(uring_->sockets_mutex);
+        auto it = uring_->sockets.find(socket);
+        if (it != uring_->sockets.end()) {
+            state = it->second;
+            uring_->sockets.erase(it);
+        }
+    }
+
+    if (state) {
+        std::vector<Completion> cancelled;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->closed = true;
+
+            for (auto& read : state->reads) {
+                cancelled.push_back({false, 0, state->key, read.overlapped, ECANCELED});
+            }
+            for (auto* accept : state->accepts) {
+                cancelled.push_back({false, 0, state->key, &accept->overlapped, ECANCELED});
+            }
+            for (SOCKET fd : state->accepted) ::close(fd);
+            // Состояние может пережить сокет, пока в ядре его операции: данные — в пул сразу
+            state->stash.clear();
+            state->stash_bytes = 0;
+            state->reads.clear();
+            state->accepts.clear();
+            state->accepted.clear();
+
+            // Multishot держит ссылку на файл — отменяем явно
+            if (state->multishot && !state->recv_paused) uring_->cancelMultishot(*state);
+        }
+
+        for (const Completion& c : cancelled) uring_->enqueue(c);
+
+        // Отправляем сразу, даже из потока кольца: SEND, RECV и CANCEL для
+        // этого fd должны попасть в ядро до close() — при отправке ядро берёт
+        // ссылку на файл. Иначе номер успеет достаться новому сокету, и
+        // застрявшие SQE сработают на нём
+        std::lock_guard<std::mutex> lock(uring_->sq_mutex);
+        uring_->submitLocked();
+    }
+
+    SocketUtils::closeSocket(socket);
+}
+
+#endif
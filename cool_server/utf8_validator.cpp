@@ -0,0 +1,275 @@
+#include "utf8_validator.h"
+#include "cpu_features.h"
+#include <cstring>
+
+#ifdef COOL_SERVER_X86
+#include <immintrin.h>
+#endif
+
+namespace websocket {
+
+namespace {
+    // Автомат Хёрманна (http://bjoern.hoehrmann.de/utf-8/decoder/dfa/):
+    // первые 256 байт — класс байта, дальше — переходы по состояниям,
+    // кратным 12. Отвергает overlong, суррогаты и всё выше U+10FFFF
+    const uint8_t UTF8_DFA[] = {
+        // 00..7F
+        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+        // 80..BF
+        1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7, 7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+        // C0..FF
+        8,8,2,2,2,2,2,2,2,2,2,2,2,2,2,2, 2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+        10,3,3,3,3,3,3,3,3,3,3,3,3,4,3,3, 11,6,6,6,5,8,8,8,8,8,8,8,8,8,8,8,
+        // Переходы
+         0,12,24,36,60,96,84,12,12,12,48,72, 12,12,12,12,12,12,12,12,12,12,12,12,
+        12, 0,12,12,12,12,12, 0,12, 0,12,12, 12,24,12,12,12,12,12,24,12,24,12,12,
+        12,12,12,12,12,12,12,24,12,12,12,12, 12,24,12,12,12,12,12,12,12,24,12,12,
+        12,12,12,12,12,12,12,36,12,36,12,12, 12,36,12,12,12,12,12,36,12,36,12,12,
+        12,36,12,12,12,12,12,12,12,12,12,12,
+    };
+
+    // Ядро проверяет данные, начинающиеся на границе символа. Возвращает
+    // длину проверенного префикса, который тоже кончается на границе
+    // символа; остаток (меньше блока плюс оборванный символ) дочитывает
+    // автомат. false в ok — найдена ошибка
+    using Utf8Kernel = size_t (*)(const uint8_t* data, size_t len, bool& ok);
+
+    // Отступ назад к началу символа, оборванного на конце блоков
+    size_t characterBoundary(const uint8_t* data, size_t end) {
+        for (size_t back = 1; back <= 3 && back <= end; ++back) {
+            const uint8_t c = data[end - back];
+            if (c < 0x80) break;
+            if (c >= 0xC0) {
+                const size_t need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+                return back < need ? end - back : end;
+            }
+        }
+        return end;
+    }
+
+    size_t validateScalar(const uint8_t* data, size_t len, bool& ok) {
+        // Без SIMD ускоряем только ASCII: по 8 байт за шаг
+        ok = true;
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            if (word & 0x8080808080808080ULL) break;
+        }
+        return i;
+    }
+
+#ifdef COOL_SERVER_X86
+    // Проверка таблицами (Keiser, Lemire. Validating UTF-8 In Less Than
+    // One Instruction Per Byte, 2021). Пара соседних байт классифицируется
+    // тремя поисками по 16-элементным таблицам: старший и младший полубайт
+    // первого байта и старший полубайт второго. Биты ошибок, общие для
+    // всех трёх, — нарушение; отдельно проверяется, что третьи и четвёртые
+    // байты многобайтных символов — продолжения
+    constexpr uint8_t TOO_SHORT = 1 << 0;
+    constexpr uint8_t TOO_LONG = 1 << 1;
+    constexpr uint8_t OVERLONG_3 = 1 << 2;
+    constexpr uint8_t TOO_LARGE = 1 << 3;
+    constexpr uint8_t SURROGATE = 1 << 4;
+    constexpr uint8_t OVERLONG_2 = 1 << 5;
+    constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+    constexpr uint8_t OVERLONG_4 = 1 << 6;
+    constexpr uint8_t TWO_CONTS = 1 << 7;
+    constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+    const uint8_t BYTE_1_HIGH[16] = {
+        // 0xxx: ASCII
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        // 10xx: продолжение
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        // 1100, 1101: начало двухбайтного
+        TOO_SHORT | OVERLONG_2, TOO_SHORT,
+        // 1110: трёхбайтного, 1111: четырёхбайтного
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+    };
+    const uint8_t BYTE_1_LOW[16] = {
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+    };
+    const uint8_t BYTE_2_HIGH[16] = {
+        // 0xxx: ASCII вторым байтом
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        // 1000, 1001, 101x: продолжение
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        // 11xx: начало символа вторым байтом
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    };
+
+    COOL_SERVER_TARGET("ssse3")
+    size_t validateSsse3(const uint8_t* data, size_t len, bool& ok) {
+        const __m128i byte_1_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_HIGH));
+        const __m128i byte_1_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_LOW));
+        const __m128i byte_2_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_2_HIGH));
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i high_bit = _mm_set1_epi8(static_cast<char>(0x80));
+        const __m128i third_byte = _mm_set1_epi8(static_cast<char>(0xE0 - 0x80));
+        const __m128i fourth_byte = _mm_set1_epi8(static_cast<char>(0xF0 - 0x80));
+
+        // Байты, начинающие символ длиннее оставшегося места в блоке
+        const __m128i incomplete_limit = _mm_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+
+        __m128i prev_input = _mm_setzero_si128();
+        __m128i prev_incomplete = _mm_setzero_si128();
+        __m128i error = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16) {
+            const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            if (_mm_movemask_epi8(input) == 0) {
+                // ASCII не может продолжить символ, оборванный прошлым блоком
+                error = _mm_or_si128(error, prev_incomplete);
+                continue;
+            }
+
+            const __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+            const __m128i special = _mm_and_si128(
+                _mm_and_si128(
+                    _mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                    _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+                _mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+            const __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+            const __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+            const __m128i must_be_continuation = _mm_and_si128(
+                _mm_or_si128(_mm_subs_epu8(prev2, third_byte), _mm_subs_epu8(prev3, fourth_byte)),
+                high_bit);
+            error = _mm_or_si128(error, _mm_xor_si128(must_be_continuation, special));
+            prev_incomplete = _mm_subs_epu8(input, incomplete_limit);
+            prev_input = input;
+        }
+
+        ok = _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+        return characterBoundary(data, i);
+    }
+
+    COOL_SERVER_TARGET("avx2")
+    size_t validateAvx2(const uint8_t* data, size_t len, bool& ok) {
+        // Таблица одна и та же в обеих 128-битных половинах
+        const __m256i byte_1_high = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_HIGH)));
+        const __m256i byte_1_low = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_LOW)));
+        const __m256i byte_2_high = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_2_HIGH)));
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        const __m256i high_bit = _mm256_set1_epi8(static_cast<char>(0x80));
+        const __m256i third_byte = _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80));
+        const __m256i fourth_byte = _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80));
+
+        const __m256i incomplete_limit = _mm256_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+
+        __m256i prev_input = _mm256_setzero_si256();
+        __m256i prev_incomplete = _mm256_setzero_si256();
+        __m256i error = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32) {
+            const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            if (_mm256_movemask_epi8(input) == 0) {
+                // ASCII не может продолжить символ, оборванный прошлым блоком
+                error = _mm256_or_si256(error, prev_incomplete);
+                continue;
+            }
+
+            // Сдвиг на N байт через границу 128-битных половин
+            const __m256i carry = _mm256_permute2x128_si256(prev_input, input, 0x21);
+            const __m256i prev1 = _mm256_alignr_epi8(input, carry, 15);
+            const __m256i prev2 = _mm256_alignr_epi8(input, carry, 14);
+            const __m256i prev3 = _mm256_alignr_epi8(input, carry, 13);
+
+            const __m256i special = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                    _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+                _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+            const __m256i must_be_continuation = _mm256_and_si256(
+                _mm256_or_si256(_mm256_subs_epu8(prev2, third_byte), _mm256_subs_epu8(prev3, fourth_byte)),
+                high_bit);
+            error = _mm256_or_si256(error, _mm256_xor_si256(must_be_continuation, special));
+            prev_incomplete = _mm256_subs_epu8(input, incomplete_limit);
+            prev_input = input;
+        }
+
+        ok = _mm256_testz_si256(error, error) != 0;
+        _mm256_zeroupper();
+        return characterBoundary(data, i);
+    }
+#endif
+
+    Utf8Kernel utf8Kernel() {
+        static const Utf8Kernel kernel = []() -> Utf8Kernel {
+#ifdef COOL_SERVER_X86
+            if (CpuFeatures::hasAvx2()) return validateAvx2;
+            if (CpuFeatures::hasSsse3()) return validateSsse3;
+#endif
+            return validateScalar;
+        }();
+        return kernel;
+    }
+
+    // Короче этого ядро не запускаем: хватит автомата
+    constexpr size_t SMALL_TEXT_SIZE = 32;
+}
+
+bool Utf8Validator::feed(const uint8_t* data, size_t len) {
+    uint32_t state = state_;
+    const Utf8Kernel kernel = utf8Kernel();
+    size_t i = 0;
+    while (i < len && state != REJECT) {
+        if (state == ACCEPT && len - i >= SMALL_TEXT_SIZE) {
+            // На границе символа — векторным ядром
+            bool ok;
+            i += kernel(data + i, len - i, ok);
+            if (!ok) {
+                state = REJECT;
+                break;
+            }
+        }
+
+        // Хвост, оборванный символ и то, что ядро не взяло, — автоматом;
+        // через 16 байт на границе символа снова пробуем ядро
+        const size_t end = len - i > 16 ? i + 16 : len;
+        for (; i < end; ++i) {
+            state = UTF8_DFA[256 + state + UTF8_DFA[data[i]]];
+        }
+    }
+    state_ = state;
+    return state != REJECT;
+}
+
+bool Utf8Validator::validate(const uint8_t* data, size_t len) {
+    Utf8Validator validator;
+    return validator.feed(data, len) && validator.complete();
+}
+
+} // namespace websocket
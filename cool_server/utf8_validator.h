@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace websocket {
+
+// Потоковая проверка UTF-8 (RFC 3629): данные подаются кусками любой
+// длины, недописанный символ переносится в следующий кусок. Длинные куски
+// проверяются векторно (AVX2/SSSE3, табличный метод Кайзера–Лемира),
+// стыки кусков и короткие хвосты — автоматом Хёрманна
+class Utf8Validator {
+public:
+    // false — встретилась некорректная последовательность; дальше
+    // валидатор остаётся в ошибке до reset()
+    bool feed(const uint8_t* data, size_t len);
+    // Текст закончен на границе символа
+    bool complete() const { return state_ == ACCEPT; }
+    bool failed() const { return state_ == REJECT; }
+    void reset() { state_ = ACCEPT; }
+
+    // Проверка целого буфера
+    static bool validate(const uint8_t* data, size_t len);
+
+private:
+    static constexpr uint32_t ACCEPT = 0;
+    static constexpr uint32_t REJECT = 12;
+
+    uint32_t state_ = ACCEPT;
+};
+
+} // namespace websocket
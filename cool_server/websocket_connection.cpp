@@ -1,55 +1,324 @@
 #include "websocket_connection.h"
 #include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
 #include <iostream>
+#include <utility>
 
 namespace websocket {
 
+namespace {
+    int64_t steadyMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    int64_t steadyUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Корзина гистограммы RTT: до 4 мкс — по одной на значение, дальше
+    // 4 на каждую степень двойки по двум битам после старшего
+    size_t rttBucket(uint32_t us) {
+        if (us < 4) return us;
+        int log = 2;
+        while (log < 31 && (us >> (log + 1)) != 0) ++log;
+        return 4 * (log - 1) + ((us >> (log - 2)) & 3);
+    }
+
+    uint32_t rttBucketUpper(size_t bucket) {
+        if (bucket < 4) return static_cast<uint32_t>(bucket);
+        const int log = static_cast<int>(bucket / 4) + 1;
+        const uint64_t lower = static_cast<uint64_t>(4 + bucket % 4) << (log - 2);
+        return static_cast<uint32_t>(std::min<uint64_t>(lower + (uint64_t(1) << (log - 2)) - 1, UINT32_MAX));
+    }
+
+    // Payload пинга сервера — номер, 8 байт big-endian
+    constexpr size_t PING_PAYLOAD_SIZE = 8;
+
+    // Сжатое сообщение в приёмник распаковывается ломтями: выход одного
+    // ломтя ограничен степенью сжатия deflate (~1000:1), а не длиной фрейма
+    constexpr size_t STREAM_INFLATE_SLICE = 4 * 1024;
+}
+
+void KeepaliveStats::record(uint32_t rtt_us) {
+    buckets[rttBucket(rtt_us)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void KeepaliveStats::merge(const KeepaliveStats& other) {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        buckets[i].fetch_add(other.buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    pings_sent += other.pings_sent.load();
+    pongs_matched += other.pongs_matched.load();
+    dead_peers += other.dead_peers.load();
+}
+
+uint64_t KeepaliveStats::samples() const {
+    uint64_t total = 0;
+    for (const auto& bucket : buckets) total += bucket.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint32_t KeepaliveStats::percentile(double q) const {
+    const uint64_t total = samples();
+    if (total == 0) return 0;
+    const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(total) + 0.999999));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) return rttBucketUpper(i);
+    }
+    return UINT32_MAX;
+}
+
 WebSocketConnection::WebSocketConnection(SOCKET socket, IOCPCore& iocp)
     : socket_(socket), iocp_(iocp), is_closed_(false) {
     ZeroMemory(&read_operation_.overlapped, sizeof(OVERLAPPED));
-    iocp_.associateSocket(socket_, reinterpret_cast<ULONG_PTR>(this));
-    asyncRead();
+    ZeroMemory(&write_operation_.overlapped, sizeof(OVERLAPPED));
+    // Пакеты отправки заранее не резервируем: ёмкость дорастает до
+    // настоящего размера пачки и сохраняется, а простаивающее соединение
+    // не держит под них килобайты
+    activity_timer_.handler = this;
+    close_timer_.handler = this;
 }
 
 WebSocketConnection::~WebSocketConnection() {
-    close(1006, "Connection destroyed");
+    // Сюда попадаем, только когда операций в полёте нет: каждая держит
+    // ссылку на соединение. Фрейм закрытия отправить уже некому
+    if (!is_closed_.exchange(true)) {
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        if (socket_ != INVALID_SOCKET) {
+            iocp_.closeSocket(socket_);
+            socket_ = INVALID_SOCKET;
+        }
+    }
+    iocp_.cancelTimer(&activity_timer_);
+    iocp_.cancelTimer(&close_timer_);
+    if (sink_) sink_->abort();
 }
 
-void WebSocketConnection::asyncRead() {
-    if (is_closed_) return;
-
+void WebSocketConnection::attach(SOCKET socket) {
     std::lock_guard<std::mutex> lock(socket_mutex_);
-    if (socket_ == INVALID_SOCKET) return;
+    socket_ = socket;
+}
+
+void WebSocketConnection::recycle() {
+    if (!is_closed_.exchange(true) && socket_ != INVALID_SOCKET) {
+        iocp_.closeSocket(socket_);
+    }
+    socket_ = INVALID_SOCKET;
 
-    // Выделяем буфер с запасом (мин. 8KB, макс. 16MB)
-    const size_t buffer_size = std::min(
-        std::max(8192ULL, expected_payload_size_ + Frame::MAX_HEADER_SIZE),
-        Frame::MAX_FRAME_SIZE
-    );
-    
-    read_operation_.buffer.resize(buffer_size);
-    WSABUF buf = { 
-        .len = static_cast<ULONG>(read_operation_.buffer.size()),
-        .buf = reinterpret_cast<CHAR*>(read_operation_.buffer.data())
+    // Буферы очищаем с сохранением ёмкости, раздутые — отдаём
+    auto reset = [](auto& buffer) {
+        if (buffer.capacity() > RETAINED_BUFFER_SIZE) {
+            std::decay_t<decltype(buffer)>().swap(buffer);
+        } else {
+            buffer.clear();
+        }
     };
+    receive_buffer_.reset();
+    zero_byte_reads_ = false;
+    awaiting_data_ = false;
+    data_ready_ = false;
+    reset(fragmented_buffer_);
+    write_queue_.clear();
+    write_batch_.clear();
+    write_buffers_.clear();
+    write_in_flight_ = false;
+    queued_bytes_ = 0;
+    batch_bytes_ = 0;
+    backpressured_ = false;
+    close_after_flush_ = false;
+    current_opcode_ = Opcode::Continuation;
+    compressed_message_ = false;
+    utf8_.reset();
+    deflate_.reset();
+    deflate_config_ = DeflateConfig{};
+    deflate_memory_ = nullptr;
+    reset(inflate_buffer_);
+    // Недопринятое сообщение приёмник должен выбросить
+    if (sink_) sink_->abort();
+    sink_.reset();
+    sink_factory_ = nullptr;
+    // Корутины соединения к этому времени завершились: они держат на него ссылку
+    inbox_.clear();
+    inbox_bytes_ = 0;
+    inbox_current_.reset();
+    reader_ = nullptr;
+    writer_ = nullptr;
+    streaming_ = StreamingConfig{};
+    streaming_message_ = false;
+    streamed_bytes_ = 0;
+    stream_offset_ = 0;
+    stream_remaining_ = 0;
+    handshake_.reset();
+    open_ = false;
+    ping_pending_ = 0;
+    rtt_last_us_ = 0;
+    rtt_smoothed_us_ = 0;
+    rtt_variance_us_ = 0;
+    rtt_samples_ = 0;
+    keepalive_stats_ = nullptr;
+    expected_frame_size_ = 0;
+
+    iocp_.cancelTimer(&activity_timer_);
+    iocp_.cancelTimer(&close_timer_);
+    activity_timer_.owner.reset();
+    close_timer_.owner.reset();
+
+    on_message_ = nullptr;
+    on_fragment_ = nullptr;
+    on_close_ = nullptr;
+    is_closed_ = false;
+}
+
+void WebSocketConnection::setTimeouts(const ConnectionTimeouts& timeouts) {
+    timeouts_ = timeouts;
+}
+
+void WebSocketConnection::setDeflateConfig(const DeflateConfig& config, DeflateMemory* memory) {
+    deflate_config_ = config;
+    deflate_memory_ = memory;
+}
 
-    DWORD flags = 0;
-    if (WSARecv(socket_, &buf, 1, nullptr, &flags, &read_operation_.overlapped, nullptr) == SOCKET_ERROR) {
-        if (WSAGetLastError() != WSA_IO_PENDING) {
-            close(1006, "Read error");
+void WebSocketConnection::enableDeflate(const DeflateParams& params, DeflateMemory* memory) {
+    deflate_ = std::make_unique<PerMessageDeflate>(params, memory);
+}
+
+void WebSocketConnection::setSinkFactory(const StreamingConfig& config, SinkFactory factory) {
+    streaming_ = config;
+    streaming_.chunk_size = std::max<size_t>(streaming_.chunk_size, 1);
+    sink_factory_ = std::move(factory);
+}
+
+void WebSocketConnection::setZeroByteReads(bool enabled) {
+    zero_byte_reads_ = enabled && IOCPCore::zeroByteReads();
+}
+
+void WebSocketConnection::start() {
+    iocp_.associateSocket(socket_, this);
+
+    // Таймеры срабатывают, только пока соединение живо
+    activity_timer_.owner = weak_from_this();
+    close_timer_.owner = weak_from_this();
+    last_activity_ms_.store(steadyMs(), std::memory_order_relaxed);
+    last_ping_ms_.store(steadyMs(), std::memory_order_relaxed);
+
+    const auto& t = timeouts_;
+    if (t.idle.count() > 0 || t.ping_interval.count() > 0) {
+        auto first = t.idle.count() > 0 ? t.idle : t.ping_interval;
+        if (t.ping_interval.count() > 0) first = std::min(first, t.ping_interval);
+        iocp_.setTimer(&activity_timer_, first);
+    }
+    // До ответа 101 таймер закрытия сторожит рукопожатие
+    if (t.handshake.count() > 0) iocp_.setTimer(&close_timer_, t.handshake);
+
+    asyncRead();
+}
+
+void WebSocketConnection::asyncRead() {
+    // Читаем и во время закрытия: ждём ответный Close
+    std::unique_lock<std::mutex> lock(socket_mutex_);
+    if (socket_ == INVALID_SOCKET) return;
+
+    // Всё разобрано: блок — обратно в пул, ждём данных без буфера.
+    // Нулевое чтение завершается, когда данные (или FIN) уже в сокете
+    WSABUF buf = {.len = 0, .buf = nullptr};
+    awaiting_data_ = zero_byte_reads_ && !data_ready_ && receive_buffer_.empty() && stream_remaining_ == 0;
+    data_ready_ = false;
+    if (awaiting_data_) {
+        receive_buffer_.reset();
+    } else {
+        // Места не меньше 8KB, а под недополученный фрейм — сколько ему не хватает
+        size_t wanted = READ_CHUNK_SIZE;
+        if (expected_frame_size_ > receive_buffer_.size()) {
+            wanted = std::max(wanted, expected_frame_size_ - receive_buffer_.size());
+        }
+        // Фрейм, принимаемый по частям, буфер не раздувает: читаем по куску
+        if (stream_remaining_ > 0) {
+            wanted = std::max<size_t>(wanted, std::min<uint64_t>(stream_remaining_, streaming_.chunk_size));
         }
+        receive_buffer_.prepare(wanted);
+        buf.len = static_cast<ULONG>(receive_buffer_.writable());
+        buf.buf = reinterpret_cast<CHAR*>(receive_buffer_.writePtr());
+    }
+
+    // Пока чтение в полёте, соединение не может быть уничтожено
+    read_operation_.keepalive = shared_from_this();
+    if (!iocp_.asyncRecv(socket_, &buf, 1, &read_operation_.overlapped)) {
+        read_operation_.keepalive.reset();
+        lock.unlock();
+        close(1006, "Read error");
     }
 }
 
-void WebSocketConnection::handleIOCompletion(DWORD bytes, LPOVERLAPPED overlapped) {
-    if (is_closed_) return;
+void WebSocketConnection::onCompletion(DWORD bytes, LPOVERLAPPED overlapped, DWORD error) {
+    if (overlapped == &activity_timer_.overlapped) {
+        onActivityTimer();
+        return;
+    }
+
+    if (overlapped == &close_timer_.overlapped) {
+        // Ответного Close или запроса на апгрейд не дождались
+        teardown();
+        return;
+    }
+
+    if (overlapped == &write_operation_.overlapped) {
+        std::shared_ptr<WebSocketConnection> self = std::move(write_operation_.keepalive);
 
-    // Умный указатель для автоматического удаления AsyncOperation
-    std::unique_ptr<AsyncOperation> op;
+        bool failed = error != 0;
+        bool drained = false;
+        WriteAwaiter* writer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(socket_mutex_);
+            write_in_flight_ = false;
+            write_batch_.clear();
+            queued_bytes_ -= batch_bytes_;
+            batch_bytes_ = 0;
+            if (queued_bytes_ <= outbound_limits_.low_watermark) backpressured_ = false;
 
-    // Если это не операция чтения, это операция записи (нужно освободить память)
-    if (overlapped != &read_operation_.overlapped) {
-        op.reset(reinterpret_cast<AsyncOperation*>(overlapped));
+            if (socket_ == INVALID_SOCKET) {
+                // Соединение закрыто: недоотправленное уже никуда не уйдёт
+                write_queue_.clear();
+                queued_bytes_ = 0;
+                return;
+            }
+            if (!failed) failed = !flushLocked();
+            drained = !write_in_flight_ && close_after_flush_;
+            // Очередь опустилась до нижней отметки — пишущая корутина продолжает
+            if (!failed && writer_ && queued_bytes_ <= outbound_limits_.low_watermark) {
+                writer = std::exchange(writer_, nullptr);
+            }
+        }
+        if (writer) {
+            writer->sent_ = true;
+            writer->handle_.resume();
+        }
+        if (failed) {
+            close(1006, "Write error");
+        } else if (drained) {
+            teardown();
+        }
+        return;
+    }
+
+    std::shared_ptr<WebSocketConnection> self = std::move(read_operation_.keepalive);
+
+    if (error != 0) {
+        close(1006, "Read error");
+        return;
+    }
+
+    if (awaiting_data_) {
+        // Данные пришли: теперь берём буфер и читаем по-настоящему
+        awaiting_data_ = false;
+        data_ready_ = true;
+        asyncRead();
+        return;
     }
 
     if (bytes == 0) {
@@ -57,148 +326,985 @@ void WebSocketConnection::handleIOCompletion(DWORD bytes, LPOVERLAPPED overlappe
         return;
     }
 
+    last_activity_ms_.store(steadyMs(), std::memory_order_relaxed);
+
     try {
-        if (overlapped == &read_operation_.overlapped) {
-            read_operation_.buffer.resize(bytes);
-            processData(read_operation_.buffer);
-            asyncRead();
-        }
-        // Операция записи завершена - память освободится через unique_ptr
+        receive_buffer_.commit(bytes);
+        processData();
+        asyncRead();
     } catch (const std::exception& e) {
         std::cerr << "WebSocket error: " << e.what() << "\n";
         close(1002, "Protocol error");
     }
 }
 
-void WebSocketConnection::processData(const std::vector<uint8_t>& data) {
-    // Добавляем новые данные в буфер
-    read_buffer_.insert(read_buffer_.end(), data.begin(), data.end());
+void WebSocketConnection::processData() {
+    if (!open_ && !processHandshake()) return;
+
+    // Фреймы разбираются прямо в приёмном буфере: ни копий payload,
+    // ни сдвига данных после каждого фрейма
+    const uint64_t max_payload = sink_factory_ ? streaming_.max_message_size : Frame::MAX_FRAME_SIZE;
+    while (!receive_buffer_.empty()) {
+        if (stream_remaining_ > 0) {
+            if (!streamPayload()) return;
+            continue;
+        }
 
-    while (true) {
-        // 1. Парсим заголовок
         FrameHeader header;
-        if (!Frame::parseHeader(read_buffer_, header)) {
+        if (!Frame::parseHeader(receive_buffer_.data(), receive_buffer_.size(), header, max_payload)) {
+            expected_frame_size_ = 0;
             return; // Ждём больше данных
         }
 
-        // 2. Проверяем, что весь фрейм получен
-        const size_t frame_size = Frame::headerSize(header) + header.payload_length;
-        if (read_buffer_.size() < frame_size) {
-            expected_payload_size_ = header.payload_length;
+        // Длинный фрейм целиком не ждём: payload уходит в приёмник
+        // по мере прихода, маска снимается с учётом смещения
+        if (sink_factory_ && header.payload_length > streaming_.threshold) {
+            expected_frame_size_ = 0;
+            receive_buffer_.consume(header.header_size);
+            beginFrameStream(header);
+            continue;
+        }
+
+        const size_t frame_size = header.header_size + header.payload_length;
+        if (receive_buffer_.size() < frame_size) {
+            expected_frame_size_ = frame_size;
             return; // Не хватает данных
         }
+        expected_frame_size_ = 0;
+
+        handleFrame(header, receive_buffer_.data() + header.header_size, header.payload_length);
+        receive_buffer_.consume(frame_size);
+    }
+}
+
+bool WebSocketConnection::processHandshake() {
+    if (is_closed_) return false;
 
-        // 3. Извлекаем payload
-        auto payload_begin = read_buffer_.begin() + Frame::headerSize(header);
-        auto payload_end = payload_begin + header.payload_length;
-        std::vector<uint8_t> payload(payload_begin, payload_end);
+    const HandshakeParser::Result result = handshake_.parse(receive_buffer_.data(), receive_buffer_.size());
+    if (result == HandshakeParser::Result::Incomplete) return false;
 
-        // 4. Удаляем обработанные данные из буфера
-        read_buffer_.erase(read_buffer_.begin(), read_buffer_.begin() + frame_size);
+    if (result == HandshakeParser::Result::Error) {
+        // Отвечаем HTTP-ошибкой и закрываем, как только ответ уйдёт;
+        // фреймы, накопленные для открытого соединения, не нужны
+        is_closed_ = true;
+        std::vector<uint8_t> rejection = Handshake::rejection(handshake_.status());
+        bool failed;
+        {
+            std::lock_guard<std::mutex> lock(socket_mutex_);
+            if (socket_ == INVALID_SOCKET) return false;
+            write_queue_.clear();
+            queued_bytes_ = rejection.size();
+            write_queue_.push_back({std::move(rejection), true});
+            close_after_flush_ = true;
+            failed = !flushLocked();
+        }
+        if (failed) teardown();
+        return false;
+    }
+
+    const uint8_t* request = receive_buffer_.data();
+    std::string accepted;
+    if (deflate_config_.enabled && handshake_.extensionCount() > 0) {
+        // Заголовков может быть несколько — это один список
+        std::string offers;
+        for (size_t i = 0; i < handshake_.extensionCount(); ++i) {
+            if (i > 0) offers += ", ";
+            offers += handshake_.extension(request, i);
+        }
+        DeflateParams params;
+        if (PerMessageDeflate::negotiate(offers, deflate_config_, deflate_memory_, params, accepted)) {
+            enableDeflate(params, deflate_memory_);
+        }
+    }
+    std::vector<uint8_t> response = Handshake::response(handshake_.key(request), accepted);
+    receive_buffer_.consume(handshake_.requestSize());
+    iocp_.cancelTimer(&close_timer_);
 
-        // 5. Обрабатываем фрейм
-        handleFrame(header, std::move(payload));
+    bool failed;
+    {
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        if (socket_ == INVALID_SOCKET) return false;
+        // Ответ обгоняет всё, что успели поставить до открытия
+        queued_bytes_ += response.size();
+        write_queue_.push_front({std::move(response), true});
+        open_ = true;
+        failed = !flushLocked();
+    }
+    if (failed) {
+        close(1006, "Write error");
+        return false;
     }
+    return true;
 }
 
-void WebSocketConnection::handleFrame(const FrameHeader& header, std::vector<uint8_t>&& payload) {
+void WebSocketConnection::handleFrame(const FrameHeader& header, uint8_t* payload, size_t length) {
     try {
-        std::string message = Frame::decodePayload(header, payload);
+        // Маску снимаем на месте, в приёмном буфере. Несжатый текст тем же
+        // проходом проверяем на UTF-8, сжатый — после распаковки
+        const bool continuation = header.opcode == Opcode::Continuation;
+        const bool text = header.opcode == Opcode::Text ||
+                          (continuation && current_opcode_ == Opcode::Text);
+        const bool compressed = continuation ? compressed_message_ : (header.rsv & Frame::RSV1) != 0;
+        if (text && !compressed) {
+            if (!continuation) utf8_.reset();
+            if (!Frame::unmaskUtf8(header, payload, length, utf8_) ||
+                (header.fin && !utf8_.complete())) {
+                close(1007, "Invalid UTF-8");
+                return;
+            }
+        } else {
+            Frame::unmask(header, payload, length);
+        }
+
+        // RSV1 допустим только с permessage-deflate, RSV2/RSV3 — никогда
+        if (header.rsv & ~(deflate_ ? Frame::RSV1 : 0)) {
+            throw std::runtime_error("Unexpected RSV bits");
+        }
 
+        // Управляющие фреймы могут приходить между фрагментами,
+        // но сами не фрагментируются и не длиннее 125 байт
+        if (static_cast<uint8_t>(header.opcode) & 0x08) {
+            if (!header.fin || length > 125 || header.rsv) {
+                throw std::runtime_error("Invalid control frame");
+            }
+            const std::string_view message(reinterpret_cast<const char*>(payload), length);
+            switch (header.opcode) {
+                case Opcode::Ping:
+                    sendPong(message);
+                    break;
+                case Opcode::Close:
+                    // Тело — код из 2 байт и причина в UTF-8
+                    if (length == 1) throw std::runtime_error("Invalid close payload");
+                    if (length > 2 && !Utf8Validator::validate(payload + 2, length - 2)) {
+                        close(1007, "Invalid UTF-8");
+                        break;
+                    }
+                    onPeerClose(message);
+                    break;
+                case Opcode::Pong:
+                    onPong(message);
+                    break;
+                default:
+                    throw std::runtime_error("Unknown opcode");
+            }
+            return;
+        }
+
+        handleDataFrame(header, payload, length);
+    } catch (const std::exception& e) {
+        close(1002, "Protocol error");
+    }
+}
+
+Opcode WebSocketConnection::beginDataFrame(const FrameHeader& header) {
+    // Новое сообщение не может начаться, пока не закончено предыдущее,
+    // а Continuation — прийти вне сообщения
+    Opcode opcode = header.opcode;
+    if (opcode == Opcode::Continuation) {
+        // RSV1 ставится только на первый фрейм сообщения
+        if (current_opcode_ == Opcode::Continuation || header.rsv) {
+            throw std::runtime_error("Unexpected continuation frame");
+        }
+        opcode = current_opcode_;
+    } else if (opcode == Opcode::Text || opcode == Opcode::Binary) {
+        if (current_opcode_ != Opcode::Continuation) {
+            throw std::runtime_error("Expected continuation frame");
+        }
+        compressed_message_ = (header.rsv & Frame::RSV1) != 0;
+    } else {
+        throw std::runtime_error("Unknown opcode");
+    }
+    current_opcode_ = header.fin ? Opcode::Continuation : opcode;
+    return opcode;
+}
+
+void WebSocketConnection::handleDataFrame(const FrameHeader& header, const uint8_t* payload, size_t length) {
+    const Opcode opcode = beginDataFrame(header);
+    if (streaming_message_) {
+        streamData(opcode, payload, length, header.fin);
+        return;
+    }
+
+    // Коллбэки копируем под мьютексом, а вызываем без него:
+    // обработчик может сам вызвать close() или send*()
+    MessageCallback on_message;
+    FragmentCallback on_fragment;
+    {
         std::lock_guard<std::mutex> lock(callbacks_mutex_);
-        switch (header.opcode) {
-            case Opcode::Text:
-                if (on_message_) on_message_(message);
-                break;
-            case Opcode::Binary:
-                if (on_message_) on_message_(message); // Или отдельный binary_cb_
-                break;
-            case Opcode::Ping:
-                sendPong(message);
-                break;
-            case Opcode::Close:
-                close(1000, "Normal closure");
+        on_message = on_message_;
+        on_fragment = on_fragment_;
+    }
+
+    if (compressed_message_) {
+        // Распаковываем по мере прихода: сжатое сообщение целиком не копится
+        std::string& target = on_fragment ? inflate_buffer_ : fragmented_buffer_;
+        if (on_fragment) inflate_buffer_.clear();
+        if (header.opcode != Opcode::Continuation) utf8_.reset();
+
+        // С приёмником распаковываем ломтями: короткий фрейм может
+        // развернуться в сотни мегабайт, порог надо заметить раньше
+        const bool spill = !on_fragment && sink_factory_;
+        const size_t slice = spill ? STREAM_INFLATE_SLICE : length;
+        size_t done = 0;
+        do {
+            const size_t size = std::min(slice, length - done);
+            const bool last = header.fin && done + size == length;
+            const size_t inflated_from = target.size();
+            auto result = deflate_->decompress(payload + done, size, last, target, MAX_MESSAGE_SIZE);
+            if (result != PerMessageDeflate::InflateResult::Ok) {
+                fragmented_buffer_.clear();
+                current_opcode_ = Opcode::Continuation;
+                if (result == PerMessageDeflate::InflateResult::TooBig) {
+                    close(1009, "Message too big");
+                } else if (result == PerMessageDeflate::InflateResult::NoMemory) {
+                    close(1011, "Compression memory exhausted");
+                } else {
+                    close(1007, "Invalid compressed data");
+                }
+                return;
+            }
+
+            if (opcode == Opcode::Text &&
+                (!utf8_.feed(reinterpret_cast<const uint8_t*>(target.data()) + inflated_from,
+                             target.size() - inflated_from) ||
+                 (last && !utf8_.complete()))) {
+                fragmented_buffer_.clear();
+                current_opcode_ = Opcode::Continuation;
+                close(1007, "Invalid UTF-8");
+                return;
+            }
+            done += size;
+
+            if (spill && fragmented_buffer_.size() > streaming_.threshold) {
+                // Распакованное переросло порог: дальше сообщение идёт в приёмник
+                if (openSink(opcode, 0)) {
+                    if (done < length) {
+                        streamData(opcode, payload + done, length - done, header.fin);
+                    } else if (header.fin) {
+                        finishStream();
+                    }
+                }
+                return;
+            }
+        } while (done < length);
+
+        if (on_fragment) {
+            on_fragment(opcode, reinterpret_cast<const uint8_t*>(inflate_buffer_.data()),
+                        inflate_buffer_.size(), header.fin);
+        } else if (header.fin) {
+            deliver(on_message, opcode);
+        }
+        return;
+    }
+
+    if (on_fragment) {
+        on_fragment(opcode, payload, length, header.fin);
+        return;
+    }
+
+    if (header.fin && fragmented_buffer_.empty()) {
+        // Нефрагментированное сообщение — обычный случай: отдаём прямо
+        // из приёмного буфера, где уже снята маска
+        emit(on_message, MessageView{opcode, payload, length});
+        return;
+    }
+
+    if (sink_factory_ && fragmented_buffer_.size() + length > streaming_.threshold) {
+        // Сборка переросла порог: собранное и всё дальнейшее — в приёмник
+        if (openSink(opcode, 0)) streamData(opcode, payload, length, header.fin);
+        return;
+    }
+    if (fragmented_buffer_.size() + length > MAX_MESSAGE_SIZE) {
+        fragmented_buffer_.clear();
+        current_opcode_ = Opcode::Continuation;
+        close(1009, "Message too big");
+        return;
+    }
+    fragmented_buffer_.append(reinterpret_cast<const char*>(payload), length);
+
+    if (header.fin) deliver(on_message, opcode);
+}
+
+void WebSocketConnection::beginFrameStream(const FrameHeader& header) {
+    if (header.rsv & ~(deflate_ ? Frame::RSV1 : 0)) {
+        throw std::runtime_error("Unexpected RSV bits");
+    }
+    if (static_cast<uint8_t>(header.opcode) & 0x08) {
+        throw std::runtime_error("Invalid control frame");
+    }
+    const Opcode opcode = beginDataFrame(header);
+    if (header.opcode != Opcode::Continuation) utf8_.reset();
+
+    stream_header_ = header;
+    stream_opcode_ = opcode;
+    stream_offset_ = 0;
+    stream_remaining_ = header.payload_length;
+    if (!streaming_message_) openSink(opcode, header.fin ? header.payload_length : 0);
+}
+
+bool WebSocketConnection::streamPayload() {
+    // Приёмнику — куски по chunk_size; меньше только хвост фрейма
+    const size_t chunk = static_cast<size_t>(std::min<uint64_t>(stream_remaining_, streaming_.chunk_size));
+    if (receive_buffer_.size() < chunk) return false;
+
+    uint8_t* data = receive_buffer_.data();
+    const bool final = chunk == stream_remaining_ && stream_header_.fin;
+    if (sink_) {
+        if (stream_opcode_ == Opcode::Text && !compressed_message_) {
+            if (!Frame::unmaskUtf8(stream_header_, data, chunk, utf8_, stream_offset_) ||
+                (final && !utf8_.complete())) {
+                failStream(1007, "Invalid UTF-8");
+            }
+        } else {
+            Frame::unmask(stream_header_, data, chunk, stream_offset_);
+        }
+    }
+    streamData(stream_opcode_, data, chunk, final);
+
+    receive_buffer_.consume(chunk);
+    stream_offset_ += chunk;
+    stream_remaining_ -= chunk;
+    return true;
+}
+
+bool WebSocketConnection::openSink(Opcode opcode, uint64_t size) {
+    streaming_message_ = true;
+    streamed_bytes_ = 0;
+    // Закрывающееся соединение дочитывает сообщение вхолостую
+    if (is_closed_) return true;
+
+    sink_ = sink_factory_(opcode, size);
+    if (!sink_) {
+        failStream(1009, "Message too big");
+        return false;
+    }
+    if (!fragmented_buffer_.empty()) {
+        const bool ok = writeSink(reinterpret_cast<const uint8_t*>(fragmented_buffer_.data()),
+                                  fragmented_buffer_.size());
+        fragmented_buffer_.clear();
+        return ok;
+    }
+    return true;
+}
+
+void WebSocketConnection::streamData(Opcode opcode, const uint8_t* data, size_t size, bool final) {
+    if (sink_ && compressed_message_) {
+        size_t done = 0;
+        do {
+            const size_t slice = std::min(STREAM_INFLATE_SLICE, size - done);
+            const bool last = final && done + slice == size;
+            inflate_buffer_.clear();
+            auto result = deflate_->decompress(data + done, slice, last, inflate_buffer_, MAX_MESSAGE_SIZE);
+            if (result != PerMessageDeflate::InflateResult::Ok) {
+                if (result == PerMessageDeflate::InflateResult::TooBig) {
+                    failStream(1009, "Message too big");
+                } else if (result == PerMessageDeflate::InflateResult::NoMemory) {
+                    failStream(1011, "Compression memory exhausted");
+                } else {
+                    failStream(1007, "Invalid compressed data");
+                }
                 break;
-            default:
+            }
+            const auto* inflated = reinterpret_cast<const uint8_t*>(inflate_buffer_.data());
+            if (opcode == Opcode::Text &&
+                (!utf8_.feed(inflated, inflate_buffer_.size()) || (last && !utf8_.complete()))) {
+                failStream(1007, "Invalid UTF-8");
                 break;
+            }
+            if (!writeSink(inflated, inflate_buffer_.size())) break;
+            done += slice;
+        } while (done < size);
+    } else if (sink_) {
+        writeSink(data, size);
+    }
+
+    if (final) finishStream();
+}
+
+bool WebSocketConnection::writeSink(const uint8_t* data, size_t size) {
+    if (streamed_bytes_ + size > streaming_.max_message_size) {
+        failStream(1009, "Message too big");
+        return false;
+    }
+    streamed_bytes_ += size;
+    if (!sink_->write(data, size)) {
+        failStream(1011, "Sink write failed");
+        return false;
+    }
+    return true;
+}
+
+void WebSocketConnection::finishStream() {
+    if (sink_) sink_->finish();
+    sink_.reset();
+    streaming_message_ = false;
+    streamed_bytes_ = 0;
+}
+
+void WebSocketConnection::failStream(uint16_t code, const char* reason) {
+    // Остаток сообщения дочитывается без приёмника, чтобы не сбиться с фреймов
+    if (sink_) {
+        sink_->abort();
+        sink_.reset();
+    }
+    close(code, reason);
+}
+
+void WebSocketConnection::deliver(const MessageCallback& on_message, Opcode opcode) {
+    // Собранное сообщение отдаём из буфера сборки; ёмкость остаётся
+    // следующему сообщению
+    emit(on_message, MessageView{opcode, reinterpret_cast<const uint8_t*>(fragmented_buffer_.data()),
+                                 fragmented_buffer_.size()});
+    fragmented_buffer_.clear();
+}
+
+void WebSocketConnection::emit(const MessageCallback& on_message, const MessageView& message) {
+    if (on_message) {
+        on_message(message);
+    } else {
+        offerMessage(message);
+    }
+}
+
+void WebSocketConnection::offerMessage(const MessageView& message) {
+    if (is_closed_) return;
+
+    ReadAwaiter* reader;
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        reader = std::exchange(reader_, nullptr);
+        if (!reader && inbox_bytes_ + message.size <= MAX_INBOX_BYTES) {
+            // Корутина занята: копия подождёт её следующего read()
+            PooledBuffer copy(message.size);
+            if (message.size > 0) std::memcpy(copy.data(), message.data, message.size);
+            copy.resize(message.size);
+            inbox_bytes_ += message.size;
+            inbox_.push_back({message.opcode, std::move(copy)});
+            return;
         }
-    } catch (const std::exception& e) {
-        close(1002, "Protocol error");
     }
+    if (!reader) {
+        close(1008, "Inbox overflow");
+        return;
+    }
+
+    // Корутина ждёт: продолжаем её прямо здесь, сообщение — из приёмного
+    // буфера без копии. До её следующего co_await буфер не трогается
+    reader->message_ = message;
+    reader->handle_.resume();
+}
+
+void WebSocketConnection::wakeSession() {
+    ReadAwaiter* reader;
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        reader = std::exchange(reader_, nullptr);
+    }
+    if (reader) {
+        reader->message_.reset();
+        reader->handle_.resume();
+    }
+
+    WriteAwaiter* writer;
+    {
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        writer = std::exchange(writer_, nullptr);
+    }
+    if (writer) {
+        writer->sent_ = false;
+        writer->handle_.resume();
+    }
+}
+
+WebSocketConnection::ReadAwaiter WebSocketConnection::read() {
+    return ReadAwaiter(*this);
+}
+
+WebSocketConnection::WriteAwaiter WebSocketConnection::write(const MessageView& message) {
+    return WriteAwaiter(*this, sendMessage(message.opcode, message.data, message.size));
 }
 
-void WebSocketConnection::sendText(const std::string& message) {
-    std::vector<uint8_t> frame = Frame::createFrame(Opcode::Text, message);
-    asyncWrite(std::move(frame));
+WebSocketConnection::WriteAwaiter WebSocketConnection::write(std::string_view text) {
+    return WriteAwaiter(*this, sendMessage(Opcode::Text, reinterpret_cast<const uint8_t*>(text.data()), text.size()));
 }
 
-void WebSocketConnection::sendBinary(const std::vector<uint8_t>& data) {
-    // Преобразуем vector<uint8_t> в string
-    std::string payload(data.begin(), data.end());
-    auto frame = Frame::createFrame(Opcode::Binary, payload);
-    asyncWrite(std::move(frame));
+bool WebSocketConnection::ReadAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    WebSocketConnection& c = connection_;
+    std::lock_guard<std::mutex> lock(c.inbox_mutex_);
+    // Прошлое сообщение из очереди прочитано — блок возвращается в пул
+    c.inbox_current_.reset();
+    if (!c.inbox_.empty()) {
+        InboxMessage& next = c.inbox_.front();
+        c.inbox_bytes_ -= next.data.size();
+        c.inbox_current_ = std::move(next.data);
+        message_ = MessageView{next.opcode, c.inbox_current_.data(), c.inbox_current_.size()};
+        c.inbox_.pop_front();
+        return false;
+    }
+    if (c.is_closed_ || c.reader_) {
+        message_.reset();
+        return false;
+    }
+    handle_ = handle;
+    c.reader_ = this;
+    return true;
 }
 
-void WebSocketConnection::sendPong(const std::string& message) {
-    std::vector<uint8_t> frame = Frame::createFrame(Opcode::Pong, message);
-    asyncWrite(std::move(frame));
+WebSocketConnection::ReadAwaiter::~ReadAwaiter() {
+    // Кадр уничтожили, не дождавшись сообщения: соединение не должно его будить
+    std::lock_guard<std::mutex> lock(connection_.inbox_mutex_);
+    if (connection_.reader_ == this) connection_.reader_ = nullptr;
+}
+
+bool WebSocketConnection::WriteAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    WebSocketConnection& c = connection_;
+    std::lock_guard<std::mutex> lock(c.socket_mutex_);
+    if (c.is_closed_ || c.socket_ == INVALID_SOCKET || c.writer_) {
+        sent_ = false;
+        return false;
+    }
+    // Выброшенный политикой фрейм тоже ждёт разбора очереди: корутина,
+    // которая не смотрит на результат, всё равно притормаживает
+    if (c.queued_bytes_ <= c.outbound_limits_.low_watermark) {
+        sent_ = true;
+        return false;
+    }
+    handle_ = handle;
+    c.writer_ = this;
+    return true;
+}
+
+WebSocketConnection::WriteAwaiter::~WriteAwaiter() {
+    std::lock_guard<std::mutex> lock(connection_.socket_mutex_);
+    if (connection_.writer_ == this) connection_.writer_ = nullptr;
+}
+
+void WebSocketConnection::sendText(std::string_view message) {
+    sendMessage(Opcode::Text, reinterpret_cast<const uint8_t*>(message.data()), message.size());
+}
+
+void WebSocketConnection::sendBinary(const uint8_t* data, size_t size) {
+    sendMessage(Opcode::Binary, data, size);
+}
+
+void WebSocketConnection::send(const MessageView& message) {
+    sendMessage(message.opcode, message.data, message.size);
+}
+
+bool WebSocketConnection::sendMessage(Opcode opcode, const uint8_t* payload, size_t size) {
+    if (deflate_ && size >= deflate_->minSize()) {
+        std::lock_guard<std::mutex> lock(deflate_mutex_);
+        std::string compressed;
+        if (deflate_->compress(payload, size, compressed)) {
+            return encodeFrame(opcode, reinterpret_cast<const uint8_t*>(compressed.data()), compressed.size(), true,
+                               deflate_->contextTakeover());
+        }
+        // Бюджет памяти zlib исчерпан — уходим несжатыми
+    }
+    return encodeFrame(opcode, payload, size, false, false);
+}
+
+bool WebSocketConnection::encodeFrame(Opcode opcode, const uint8_t* payload, size_t size, bool compressed,
+                                      bool pinned) {
+    if (is_closed_) return false;
+    Frame::validateOpcode(opcode);
+
+    const size_t frame_size = ServerFrameEncoder::frameSize(size);
+    size_t capacity = frame_size;
+    {
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        if (socket_ == INVALID_SOCKET) return false;
+
+        // Сразу фрейм не уйдёт: дописываем его к хвосту очереди, пока не
+        // упёрлись в верхнюю отметку — там решает политика медленного клиента
+        const bool waiting = write_in_flight_ || !open_;
+        if (waiting && !write_queue_.empty() && !backpressured_ &&
+            queued_bytes_ + frame_size <= outbound_limits_.high_watermark) {
+            OutboundFrame& tail = write_queue_.back();
+            if (tail.pooled && !tail.critical && tail.pinned == pinned) {
+                PooledBuffer& block = tail.pooled;
+                if (block.capacity() - block.size() >= frame_size) {
+                    const size_t used = block.size();
+                    block.resize(used + ServerFrameEncoder::encode(block.data() + used, opcode, payload, size,
+                                                                   compressed));
+                    queued_bytes_ += frame_size;
+                    return true;
+                }
+                // Места нет: следующий блок вдвое больше, до OUTPUT_BLOCK_SIZE
+                capacity = std::max(frame_size, std::min(block.capacity() * 2, OUTPUT_BLOCK_SIZE));
+            }
+        }
+    }
+
+    // Кодируем вне блокировки: крупный payload копируется долго
+    PooledBuffer block(capacity);
+    block.resize(ServerFrameEncoder::encode(block.data(), opcode, payload, size, compressed));
+    return asyncWrite(OutboundFrame{{}, false, pinned, nullptr, std::move(block)});
+}
+
+void WebSocketConnection::sendShared(const SharedFrame& frame) {
+    asyncWrite(OutboundFrame{{}, false, false, frame});
+}
+
+void WebSocketConnection::sendPing(std::string_view message) {
+    asyncWrite(OutboundFrame{{}, true, false, nullptr, Frame::createPooledFrame(Opcode::Ping, message)});
+}
+
+void WebSocketConnection::sendPong(std::string_view message) {
+    asyncWrite(OutboundFrame{{}, true, false, nullptr, Frame::createPooledFrame(Opcode::Pong, message)});
 }
 
 void WebSocketConnection::close(uint16_t code, const std::string& reason) {
-    if (is_closed_.exchange(true)) return;
+    // 1005 и 1006 по сети не передаются: связь уже потеряна, рвём сразу
+    const bool abnormal = code == 1005 || code == 1006;
+    if (is_closed_.exchange(true)) {
+        if (abnormal) teardown();
+        return;
+    }
 
-    std::lock_guard<std::mutex> lock(socket_mutex_);
-    if (socket_ == INVALID_SOCKET) return;
+    {
+        std::lock_guard<std::mutex> cb_lock(callbacks_mutex_);
+        on_message_ = nullptr;
+        on_fragment_ = nullptr;
+    }
+    wakeSession();
+    // До рукопожатия Close отправлять некому: это ещё HTTP
+    if (abnormal || !open_) {
+        teardown();
+        return;
+    }
 
-    // Отправка фрейма закрытия (если нужно)
-    std::vector<uint8_t> frame;
-    if (code != 1000 || !reason.empty()) {
-        std::string payload;
-        payload.push_back(static_cast<char>(code >> 8));
-        payload.push_back(static_cast<char>(code & 0xFF));
-        payload += reason;
-        frame = Frame::createFrame(Opcode::Close, payload);
-    } else {
-        frame = Frame::createFrame(Opcode::Close, "");
+    std::string payload;
+    payload.push_back(static_cast<char>(code >> 8));
+    payload.push_back(static_cast<char>(code & 0xFF));
+    payload += reason;
+    std::vector<uint8_t> frame = Frame::createFrame(Opcode::Close, payload);
+
+    bool failed;
+    {
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        if (socket_ == INVALID_SOCKET) return;
+
+        // Close встаёт за уже поставленными фреймами
+        queued_bytes_ += frame.size();
+        write_queue_.push_back({std::move(frame), true});
+        if (timeouts_.close.count() <= 0) close_after_flush_ = true;
+        failed = !write_in_flight_ && !flushLocked();
+    }
+
+    if (failed) {
+        teardown();
+    } else if (timeouts_.close.count() > 0) {
+        // Ждём ответный Close; не дождались — закрываем сами
+        iocp_.setTimer(&close_timer_, timeouts_.close);
     }
+}
 
-    // Отправка фрейма закрытия (неблокирующая)
-    asyncWrite(std::move(frame));
+void WebSocketConnection::onPeerClose(std::string_view payload) {
+    if (is_closed_.exchange(true)) {
+        // Ответ на наш Close: рукопожатие завершено
+        teardown();
+        return;
+    }
 
-    // Закрытие сокета
-    ::closesocket(socket_);
-    socket_ = INVALID_SOCKET;
+    {
+        std::lock_guard<std::mutex> cb_lock(callbacks_mutex_);
+        on_message_ = nullptr;
+        on_fragment_ = nullptr;
+    }
+    wakeSession();
+
+    // Отвечаем тем же кодом и закрываем TCP, как только ответ уйдёт
+    std::vector<uint8_t> frame = Frame::createFrame(Opcode::Close, payload.substr(0, 2));
+
+    bool failed;
+    {
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        if (socket_ == INVALID_SOCKET) return;
+
+        queued_bytes_ += frame.size();
+        write_queue_.push_back({std::move(frame), true});
+        close_after_flush_ = true;
+        failed = !write_in_flight_ && !flushLocked();
+    }
+
+    if (failed) {
+        teardown();
+    } else if (timeouts_.close.count() > 0) {
+        // Клиент может не забирать данные — ответ не должен висеть вечно
+        iocp_.setTimer(&close_timer_, timeouts_.close);
+    }
+}
+
+void WebSocketConnection::teardown() {
+    is_closed_ = true;
+    {
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        if (socket_ == INVALID_SOCKET) return;
+
+        // Незавершённые операции придут с ошибкой и отпустят соединение
+        iocp_.closeSocket(socket_);
+        socket_ = INVALID_SOCKET;
+        close_after_flush_ = false;
+    }
+    iocp_.cancelTimer(&activity_timer_);
+    iocp_.cancelTimer(&close_timer_);
 
     // Вызов коллбэка
-    std::lock_guard<std::mutex> cb_lock(callbacks_mutex_);
-    if (on_close_) on_close_();
+    CloseCallback on_close;
+    {
+        std::lock_guard<std::mutex> cb_lock(callbacks_mutex_);
+        on_close = std::move(on_close_);
+        on_message_ = nullptr;
+    }
+    wakeSession();
+    if (on_close) on_close();
 }
 
-void WebSocketConnection::asyncWrite(std::vector<uint8_t>&& data) {
+void WebSocketConnection::onActivityTimer() {
     if (is_closed_) return;
 
-    std::lock_guard<std::mutex> lock(socket_mutex_);
-    if (socket_ == INVALID_SOCKET) return;
+    const auto& t = timeouts_;
+    const int64_t now = steadyMs();
+    const std::chrono::milliseconds idle(now - last_activity_ms_.load(std::memory_order_relaxed));
+    if (t.idle.count() > 0 && idle >= t.idle) {
+        close(1001, "Idle timeout");
+        return;
+    }
 
-    auto* op = new AsyncOperation();
-    ZeroMemory(&op->overlapped, sizeof(OVERLAPPED));
-    op->buffer = std::move(data);
+    // Следующая проверка — к ближайшему сроку: простоя, ответа на пинг или следующего пинга
+    std::chrono::milliseconds next = t.idle.count() > 0 ? t.idle - idle : std::chrono::milliseconds::max();
+    if (ping_pending_.load(std::memory_order_acquire) != 0 && t.pong.count() > 0) {
+        const std::chrono::milliseconds waiting((steadyUs() - ping_sent_us_.load(std::memory_order_relaxed)) / 1000);
+        if (waiting >= t.pong) {
+            // Полуоткрытое соединение: ответный Close никто не пришлёт, рвём сразу
+            if (keepalive_stats_) keepalive_stats_->dead_peers++;
+            close(1006, "Pong timeout");
+            return;
+        }
+        next = std::min(next, t.pong - waiting);
+    }
+
+    if (t.ping_interval.count() > 0) {
+        const std::chrono::milliseconds since(now - last_ping_ms_.load(std::memory_order_relaxed));
+        if (since >= t.ping_interval) {
+            // Пока прошлый пинг без ответа, новый не шлём: его ждёт срок pong
+            if (open_ && ping_pending_.load(std::memory_order_acquire) == 0) {
+                sendKeepalivePing(steadyUs());
+                if (t.pong.count() > 0) next = std::min(next, t.pong);
+            }
+            last_ping_ms_.store(now, std::memory_order_relaxed);
+            next = std::min(next, t.ping_interval);
+        } else {
+            next = std::min(next, t.ping_interval - since);
+        }
+    }
+    if (next != std::chrono::milliseconds::max()) iocp_.setTimer(&activity_timer_, next);
+}
 
-    // Указываем ключ WRITE для IOCP
-    ULONG_PTR write_key = static_cast<ULONG_PTR>(IOCPCore::CompletionKeyType::WRITE);
-    iocp_.associateSocket(socket_, write_key);  // Привязываем сокет к ключу
+void WebSocketConnection::sendKeepalivePing(int64_t now_us) {
+    uint64_t sequence = ++ping_sequence_;
+    if (sequence == 0) sequence = ++ping_sequence_;
+    char payload[PING_PAYLOAD_SIZE];
+    for (size_t i = 0; i < PING_PAYLOAD_SIZE; ++i) {
+        payload[i] = static_cast<char>(sequence >> (8 * (PING_PAYLOAD_SIZE - 1 - i)));
+    }
+    ping_sent_us_.store(now_us, std::memory_order_relaxed);
+    ping_pending_.store(sequence, std::memory_order_release);
+    if (keepalive_stats_) keepalive_stats_->pings_sent++;
 
-    WSABUF buf = {
-        .len = static_cast<ULONG>(op->buffer.size()),
-        .buf = reinterpret_cast<CHAR*>(op->buffer.data())
-    };
+    // Каждый пинг — свой фрейм из пула, как у sendPing: общий буфер
+    // переписывался бы, пока его читает отправка.
+    // Критичный: политика медленного клиента пинг не выбрасывает
+    asyncWrite(OutboundFrame{{}, true, false, nullptr,
+                             Frame::createPooledFrame(Opcode::Ping, std::string_view(payload, PING_PAYLOAD_SIZE))});
+}
 
-    if (WSASend(socket_, &buf, 1, nullptr, 0, &op->overlapped, nullptr) == SOCKET_ERROR) {
-        if (WSAGetLastError() != WSA_IO_PENDING) {
-            delete op;
-            close(1006, "Write error");
+void WebSocketConnection::onPong(std::string_view payload) {
+    // Непрошеные Pong (RFC 6455, 5.5.3) и ответы на чужие пинги пропускаем
+    if (payload.size() != PING_PAYLOAD_SIZE) return;
+    uint64_t sequence = 0;
+    for (char c : payload) sequence = (sequence << 8) | static_cast<uint8_t>(c);
+    uint64_t expected = sequence;
+    if (sequence == 0 || !ping_pending_.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) return;
+
+    const int64_t elapsed = steadyUs() - ping_sent_us_.load(std::memory_order_relaxed);
+    const uint32_t rtt = static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(elapsed, 0), UINT32_MAX));
+
+    // Ответы обрабатывает только поток чтения — гонок записи нет
+    uint32_t smoothed = rtt;
+    uint32_t variance = rtt / 2;
+    if (rtt_samples_.load(std::memory_order_relaxed) > 0) {
+        const uint32_t old = rtt_smoothed_us_.load(std::memory_order_relaxed);
+        const uint32_t deviation = old > rtt ? old - rtt : rtt - old;
+        variance = static_cast<uint32_t>((3ull * rtt_variance_us_.load(std::memory_order_relaxed) + deviation) / 4);
+        smoothed = static_cast<uint32_t>((7ull * old + rtt) / 8);
+    }
+    rtt_last_us_.store(rtt, std::memory_order_relaxed);
+    rtt_smoothed_us_.store(smoothed, std::memory_order_relaxed);
+    rtt_variance_us_.store(variance, std::memory_order_relaxed);
+    rtt_samples_.fetch_add(1, std::memory_order_relaxed);
+
+    if (keepalive_stats_) {
+        keepalive_stats_->pongs_matched++;
+        keepalive_stats_->record(rtt);
+    }
+}
+
+RttEstimate WebSocketConnection::rtt() const {
+    RttEstimate estimate;
+    estimate.last_us = rtt_last_us_.load(std::memory_order_relaxed);
+    estimate.smoothed_us = rtt_smoothed_us_.load(std::memory_order_relaxed);
+    estimate.variance_us = rtt_variance_us_.load(std::memory_order_relaxed);
+    estimate.samples = rtt_samples_.load(std::memory_order_relaxed);
+    return estimate;
+}
+
+void WebSocketConnection::setKeepaliveStats(KeepaliveStats* stats) {
+    keepalive_stats_ = stats;
+}
+
+void WebSocketConnection::asyncWrite(std::vector<uint8_t>&& data, bool critical, bool pinned) {
+    asyncWrite(OutboundFrame{std::move(data), critical, pinned, nullptr});
+}
+
+bool WebSocketConnection::asyncWrite(OutboundFrame&& frame) {
+    if (is_closed_) return false;
+
+    Admission admission;
+    {
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        if (socket_ == INVALID_SOCKET) return false;
+
+        admission = frame.critical ? Admission::Queue : admitLocked(frame);
+        // Replaced: новый фрейм встал в очередь на место старого
+        if (admission == Admission::Replaced) return true;
+        if (admission == Admission::Dropped) return false;
+
+        if (admission == Admission::Queue) {
+            queued_bytes_ += frame.size();
+            write_queue_.push_back(std::move(frame));
+            // Если отправка уже в полёте, фрейм уйдёт вместе с остальными по её завершении;
+            // до рукопожатия — вслед за ответом 101
+            if (write_in_flight_ || !open_ || flushLocked()) return true;
         }
     }
+
+    if (admission == Admission::Disconnect) {
+        close(1008, "Slow consumer");
+    } else {
+        close(1006, "Write error");
+    }
+    return false;
+}
+
+WebSocketConnection::Admission WebSocketConnection::admitLocked(OutboundFrame& frame) {
+    const OutboundLimits& limits = outbound_limits_;
+    const size_t incoming = frame.size();
+    const bool pinned = frame.pinned;
+    const bool overflow = queued_bytes_ + incoming > limits.high_watermark;
+    if (!overflow && !backpressured_) return Admission::Queue;
+
+    if (overflow && !backpressured_) {
+        backpressured_ = true;
+        if (outbound_stats_) outbound_stats_->high_watermark_hits++;
+    }
+
+    auto dropped = [this](size_t bytes) {
+        if (!outbound_stats_) return;
+        outbound_stats_->dropped_frames++;
+        outbound_stats_->dropped_bytes += bytes;
+    };
+
+    switch (limits.policy) {
+        case SlowConsumerPolicy::Disconnect:
+            if (!overflow) return Admission::Queue;
+            if (outbound_stats_) outbound_stats_->disconnects++;
+            return Admission::Disconnect;
+
+        case SlowConsumerPolicy::DropOldest:
+            // Освобождаем место до нижней отметки за счёт самых старых фреймов
+            for (auto it = write_queue_.begin();
+                 it != write_queue_.end() && queued_bytes_ + incoming > limits.low_watermark;) {
+                if (it->critical || it->pinned) {
+                    ++it;
+                    continue;
+                }
+                queued_bytes_ -= it->size();
+                dropped(it->size());
+                it = write_queue_.erase(it);
+            }
+            break;
+
+        case SlowConsumerPolicy::Coalesce:
+            // Клиенту важно последнее состояние: новый фрейм встаёт на место
+            // последнего некритичного, и очередь не растёт
+            // Закреплённый фрейм вставать на чужое место не может: он
+            // обогнал бы сжатые раньше
+            for (auto it = write_queue_.rbegin(); !pinned && it != write_queue_.rend(); ++it) {
+                if (it->critical || it->pinned) continue;
+                queued_bytes_ = queued_bytes_ - it->size() + incoming;
+                *it = std::move(frame);
+                if (outbound_stats_) outbound_stats_->coalesced_frames++;
+                return Admission::Replaced;
+            }
+            break;
+    }
+
+    // Места так и не нашлось — отбрасываем сам новый фрейм.
+    // Закреплённый выбросить нельзя: остаётся только отключение
+    if (queued_bytes_ + incoming > limits.high_watermark && pinned) {
+        if (outbound_stats_) outbound_stats_->disconnects++;
+        return Admission::Disconnect;
+    }
+    if (queued_bytes_ + incoming > limits.high_watermark) {
+        dropped(incoming);
+        return Admission::Dropped;
+    }
+    return Admission::Queue;
+}
+
+bool WebSocketConnection::flushLocked() {
+    write_batch_.clear();
+    write_buffers_.clear();
+    batch_bytes_ = 0;
+    while (!write_queue_.empty() && write_batch_.size() < MAX_GATHER) {
+        batch_bytes_ += write_queue_.front().size();
+        write_batch_.push_back(std::move(write_queue_.front()));
+        write_queue_.pop_front();
+    }
+    if (write_batch_.empty()) return true;
+
+    for (const auto& frame : write_batch_) {
+        // Ядро только читает буфер, общий фрейм не меняется
+        write_buffers_.push_back({
+            .len = static_cast<ULONG>(frame.size()),
+            .buf = reinterpret_cast<CHAR*>(const_cast<uint8_t*>(frame.bytes()))
+        });
+    }
+
+    ZeroMemory(&write_operation_.overlapped, sizeof(OVERLAPPED));
+    write_operation_.keepalive = shared_from_this();
+    write_in_flight_ = true;
+
+    if (!iocp_.asyncSend(socket_, write_buffers_.data(), static_cast<DWORD>(write_buffers_.size()),
+                         &write_operation_.overlapped)) {
+        write_in_flight_ = false;
+        write_operation_.keepalive.reset();
+        return false;
+    }
+    return true;
+}
+
+void WebSocketConnection::setOutboundLimits(const OutboundLimits& limits, OutboundStats* stats) {
+    std::lock_guard<std::mutex> lock(socket_mutex_);
+    outbound_limits_ = limits;
+    outbound_stats_ = stats;
+}
+
+size_t WebSocketConnection::bufferedAmount() const {
+    std::lock_guard<std::mutex> lock(socket_mutex_);
+    return queued_bytes_;
 }
 
 void WebSocketConnection::setMessageCallback(MessageCallback cb) {
@@ -206,6 +1312,11 @@ void WebSocketConnection::setMessageCallback(MessageCallback cb) {
     on_message_ = cb;
 }
 
+void WebSocketConnection::setFragmentCallback(FragmentCallback cb) {
+    std::lock_guard<std::mutex> lock(callbacks_mutex_);
+    on_fragment_ = std::move(cb);
+}
+
 void WebSocketConnection::setCloseCallback(CloseCallback cb) {
     std::lock_guard<std::mutex> lock(callbacks_mutex_);
     on_close_ = cb;
@@ -2,58 +2,405 @@
 
 #include "iocp_core.h"
 #include "frame.h"
-#include <winsock2.h>
+#include "platform.h"
+#include "receive_buffer.h"
+#include "deflate.h"
+#include "handshake.h"
+#include "message.h"
+#include "message_sink.h"
+#include <deque>
 #include <vector>
 #include <functional>
 #include <atomic>
+#include <chrono>
+#include <coroutine>
 #include <mutex>
 #include <memory>
+#include <optional>
 
 namespace websocket {
 
-class WebSocketConnection : public std::enable_shared_from_this<WebSocketConnection> {
+class ConnectionPool;
+
+// Что делать с медленным клиентом, чья очередь отправки дошла до верхней отметки
+enum class SlowConsumerPolicy {
+    DropOldest,  // Выбрасывать самые старые некритичные фреймы из очереди
+    Coalesce,    // Новый некритичный фрейм заменяет последний такой же в очереди
+    Disconnect   // Закрывать соединение с кодом 1008
+};
+
+struct OutboundLimits {
+    size_t high_watermark = 4 * 1024 * 1024;  // Байт в очереди, после которых включается политика
+    size_t low_watermark = 1024 * 1024;       // Политика действует, пока очередь не опустится сюда
+    SlowConsumerPolicy policy = SlowConsumerPolicy::Disconnect;
+};
+
+// Счётчики срабатываний политики; один экземпляр на цикл событий
+struct OutboundStats {
+    std::atomic<uint64_t> high_watermark_hits{0};
+    std::atomic<uint64_t> dropped_frames{0};
+    std::atomic<uint64_t> dropped_bytes{0};
+    std::atomic<uint64_t> coalesced_frames{0};
+    std::atomic<uint64_t> disconnects{0};
+};
+
+// Пинги и RTT всех соединений цикла. Гистограмма логарифмическая:
+// 4 корзины на каждую степень двойки микросекунд, точность ~25%
+struct KeepaliveStats {
+    static constexpr size_t BUCKETS = 124;  // Покрывает весь uint32_t
+
+    std::atomic<uint64_t> buckets[BUCKETS]{};
+    std::atomic<uint64_t> pings_sent{0};
+    std::atomic<uint64_t> pongs_matched{0};
+    std::atomic<uint64_t> dead_peers{0};    // Закрыты без ответа на Ping
+
+    void record(uint32_t rtt_us);
+    // Добавляет счётчики другого цикла (для сводки по серверу)
+    void merge(const KeepaliveStats& other);
+    uint64_t samples() const;
+    // Верхняя граница корзины, где лежит квантиль q (0..1), мкс
+    uint32_t percentile(double q) const;
+};
+
+// RTT соединения по ответам на пинги сервера, сглаживание как в TCP (RFC 6298)
+struct RttEstimate {
+    uint32_t last_us = 0;
+    uint32_t smoothed_us = 0;
+    uint32_t variance_us = 0;
+    uint32_t samples = 0;
+};
+
+// Таймауты соединения; 0 — выключено
+struct ConnectionTimeouts {
+    std::chrono::milliseconds idle{std::chrono::minutes(2)};           // Без входящих данных — закрыть (1001)
+    std::chrono::milliseconds ping_interval{std::chrono::seconds(30)}; // Период пингов сервера
+    std::chrono::milliseconds pong{std::chrono::seconds(10)};          // Нет ответа на Ping — пир мёртв (1006)
+    std::chrono::milliseconds close{std::chrono::seconds(5)};          // Ожидание ответного Close
+    std::chrono::milliseconds handshake{std::chrono::seconds(5)};      // Запрос на апгрейд целиком
+};
+
+class WebSocketConnection : public CompletionHandler,
+                            public std::enable_shared_from_this<WebSocketConnection> {
 public:
-    using MessageCallback = std::function<void(const std::string&)>;
+    // Сообщение целиком, без копии: view валиден только на время вызова
+    using MessageCallback = std::function<void(const MessageView&)>;
+    // Фрагмент сообщения по мере прихода: opcode — тип всего сообщения
+    // (Text/Binary), final — последний фрагмент. Данные валидны только
+    // на время вызова
+    using FragmentCallback = std::function<void(Opcode opcode, const uint8_t* data, size_t length, bool final)>;
     using CloseCallback = std::function<void()>;
 
     WebSocketConnection(SOCKET socket, IOCPCore& iocp);
     ~WebSocketConnection();
 
-    void sendText(const std::string& message);
-    void sendBinary(const std::vector<uint8_t>& data);
-    void sendPong(const std::string& message);
+    // Выдаёт сокет соединению, созданному заранее с INVALID_SOCKET.
+    // Вызывается до start()
+    void attach(SOCKET socket);
+
+    // Привязывает сокет к ядру и ставит первое чтение.
+    // Вызывается после make_shared: операции держат shared_from_this().
+    // Первым соединение ждёт HTTP-запрос на апгрейд; отправленное до
+    // ответа 101 копится в очереди и уходит сразу за ним
+    void start();
+    // Рукопожатие завершено, идут фреймы
+    bool isOpen() const { return open_; }
+
+    // Данные копируются сразу в кадр, после возврата буфер свободен
+    void sendText(std::string_view message);
+    void sendBinary(const uint8_t* data, size_t size);
+    void sendBinary(const std::vector<uint8_t>& data) { sendBinary(data.data(), data.size()); }
+    // Отправка с типом исходного сообщения, например эхо из MessageCallback
+    void send(const MessageView& message);
+    // Ставит в очередь готовый фрейм без копирования: один и тот же
+    // фрейм можно отдать сколь угодно многим соединениям
+    void sendShared(const SharedFrame& frame);
+    void sendPing(std::string_view message = {});
+    void sendPong(std::string_view message);
+    // Начинает закрытие: отправляет Close и ждёт ответный не дольше
+    // ConnectionTimeouts::close. 1005 и 1006 рвут соединение сразу
     void close(uint16_t code = 1000, const std::string& reason = "");
 
+    // Задаётся до start()
+    void setTimeouts(const ConnectionTimeouts& timeouts);
+    // Что предлагать клиенту при рукопожатии: permessage-deflate
+    // согласуется, если config.enabled. Вызывается до start()
+    void setDeflateConfig(const DeflateConfig& config, DeflateMemory* memory = nullptr);
+    // Включает permessage-deflate с уже согласованными параметрами.
+    // memory — общий учёт памяти zlib. Вызывается до start()
+    void enableDeflate(const DeflateParams& params, DeflateMemory* memory = nullptr);
+
+    // Ограничения очереди отправки; stats может быть общим для многих соединений
+    void setOutboundLimits(const OutboundLimits& limits, OutboundStats* stats = nullptr);
+    // Байт, поставленных в очередь и ещё не подтверждённых ядром
+    size_t bufferedAmount() const;
+
+    // Сообщения крупнее config.threshold не собираются в памяти: кадры
+    // длиннее порога читаются из сокета кусками по config.chunk_size и
+    // вместе с остатком сообщения уходят в приёмник от factory.
+    // С FragmentCallback не сочетается. Вызывается до start()
+    void setSinkFactory(const StreamingConfig& config, SinkFactory factory);
+
+    // Простаивающее соединение не держит приёмный буфер: когда всё
+    // прочитанное разобрано, блок возвращается в BufferPool, а в ядро
+    // уходит чтение нулевой длины. Буфер берётся, только когда данные
+    // уже пришли. По умолчанию выключено; бэкенд, которому это не нужно
+    // (IOCPCore::zeroByteReads), включить не даст. Вызывается до start()
+    void setZeroByteReads(bool enabled);
+
+    // Куда складывать RTT; один экземпляр на цикл. Вызывается до start()
+    void setKeepaliveStats(KeepaliveStats* stats);
+    RttEstimate rtt() const;
+
+    // Корутинный интерфейс (Task из coroutine.h). Пока MessageCallback
+    // не задан, принятые сообщения ждут во входящей очереди (до
+    // MAX_INBOX_BYTES, дальше — закрытие с 1008).
+    // co_await read() — следующее сообщение; nullopt — соединение
+    // закрывается. Сообщение указывает в приёмный буфер и валидно до
+    // следующего co_await. Ждать read() может одна корутина
+    class ReadAwaiter {
+    public:
+        explicit ReadAwaiter(WebSocketConnection& connection) : connection_(connection) {}
+        ~ReadAwaiter();
+
+        ReadAwaiter(const ReadAwaiter&) = delete;
+        ReadAwaiter& operator=(const ReadAwaiter&) = delete;
+
+        bool await_ready() const noexcept { return false; }
+        // false — сообщение уже в очереди или соединение закрыто
+        bool await_suspend(std::coroutine_handle<> handle);
+        std::optional<MessageView> await_resume() const noexcept { return message_; }
+
+    private:
+        friend class WebSocketConnection;
+        WebSocketConnection& connection_;
+        std::coroutine_handle<> handle_;
+        std::optional<MessageView> message_;
+    };
+
+    // co_await write(...) ставит сообщение в очередь отправки и, если она
+    // выше нижней отметки OutboundLimits, ждёт, пока ядро её разберёт.
+    // false — сообщение в очередь не попало (соединение закрыто, политика
+    // медленного клиента его выбросила или отключила клиента) или
+    // соединение закрылось, пока очередь разбиралась
+    class WriteAwaiter {
+    public:
+        WriteAwaiter(WebSocketConnection& connection, bool admitted)
+            : connection_(connection), admitted_(admitted) {}
+        ~WriteAwaiter();
+
+        WriteAwaiter(const WriteAwaiter&) = delete;
+        WriteAwaiter& operator=(const WriteAwaiter&) = delete;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        bool await_resume() const noexcept { return admitted_ && sent_; }
+
+    private:
+        friend class WebSocketConnection;
+        WebSocketConnection& connection_;
+        std::coroutine_handle<> handle_;
+        bool admitted_;      // Что ответила очередь отправки на этот фрейм
+        bool sent_ = false;  // Очередь разобрана до нижней отметки, соединение живо
+    };
+
+    ReadAwaiter read();
+    WriteAwaiter write(const MessageView& message);
+    WriteAwaiter write(std::string_view text);
+
     void setMessageCallback(MessageCallback cb);
+    // Если задан, сообщения не собираются целиком: каждый фрейм данных
+    // уходит сюда сразу, а MessageCallback для них не вызывается
+    void setFragmentCallback(FragmentCallback cb);
     void setCloseCallback(CloseCallback cb);
 
-    void handleIOCompletion(DWORD bytes_transferred, LPOVERLAPPED overlapped);
+    void onCompletion(DWORD bytes_transferred, LPOVERLAPPED overlapped, DWORD error) override;
 
 private:
+    friend class ConnectionPool;
+
+    // Буферы крупнее этого при возврате в пул не сохраняются
+    static constexpr size_t RETAINED_BUFFER_SIZE = 64 * 1024;
+    // Минимум свободного места под очередное чтение
+    static constexpr size_t READ_CHUNK_SIZE = 8 * 1024;
+    // Предел собираемого из фрагментов сообщения; больше — закрытие с 1009
+    static constexpr size_t MAX_MESSAGE_SIZE = 64 * 1024 * 1024;
+    // Предел входящей очереди корутины, пока та не ждёт read()
+    static constexpr size_t MAX_INBOX_BYTES = 4 * 1024 * 1024;
+    // Сколько фреймов собирается в одну отправку
+    static constexpr size_t MAX_GATHER = 64;
+    // Предел выходного блока, в который дописываются фреймы, пока отправка в полёте
+    static constexpr size_t OUTPUT_BLOCK_SIZE = 16 * 1024;
+
+    // Фрейм в очереди отправки. Управляющие фреймы критичны:
+    // политика медленного клиента их не трогает. Закреплённые (сжатые
+    // с общим словарём) нельзя выбросить или заменить — клиент не
+    // распакует следующие; при переполнении соединение закрывается.
+    // Фрейм рассылки лежит в shared, фрейм данных — в блоке пула pooled;
+    // data тогда пуст. Пока отправка в полёте, в хвостовой блок pooled
+    // дописываются следующие фреймы с теми же флагами: политика
+    // медленного клиента выбрасывает и заменяет их вместе
+    struct OutboundFrame {
+        std::vector<uint8_t> data;
+        bool critical;
+        bool pinned = false;
+        SharedFrame shared = nullptr;
+        PooledBuffer pooled = {};
+
+        const uint8_t* bytes() const {
+            return shared ? shared->data() : pooled ? pooled.data() : data.data();
+        }
+        size_t size() const {
+            return shared ? shared->size() : pooled ? pooled.size() : data.size();
+        }
+    };
+
+    enum class Admission { Queue, Replaced, Dropped, Disconnect };
+
     struct AsyncOperation {
         OVERLAPPED overlapped;
-        std::vector<uint8_t> buffer;
+        std::shared_ptr<WebSocketConnection> keepalive;  // Держит соединение, пока операция в ядре
     };
 
+    // Сбрасывает соединение для повторной выдачи из пула.
+    // Зовётся, когда ссылок (а значит и операций в полёте) не осталось
+    void recycle();
+    // Закрывает сокет и сообщает владельцу; повторные вызовы ничего не делают
+    void teardown();
+    void onActivityTimer();
+    // Пинг сервера с номером в payload
+    void sendKeepalivePing(int64_t now_us);
+    void onPong(std::string_view payload);
+    void onPeerClose(std::string_view payload);
     void asyncRead();
-    void asyncWrite(std::vector<uint8_t>&& data);
-    void processData(const std::vector<uint8_t>& data);
-    void handleFrame(const FrameHeader& header, std::vector<uint8_t>&& payload);
+    // false — фрейм не попал в очередь: соединение закрыто, политика
+    // медленного клиента его выбросила или отключила клиента
+    bool sendMessage(Opcode opcode, const uint8_t* payload, size_t size);
+    // Кодирует фрейм данных в выходной блок соединения: в хвост очереди,
+    // если есть место, иначе в новый блок. Результат — как у sendMessage
+    bool encodeFrame(Opcode opcode, const uint8_t* payload, size_t size, bool compressed, bool pinned);
+    void asyncWrite(std::vector<uint8_t>&& data, bool critical = false, bool pinned = false);
+    bool asyncWrite(OutboundFrame&& frame);
+    Admission admitLocked(OutboundFrame& frame);
+    bool flushLocked();
+    void processData();
+    // false — рукопожатие не закончено или отклонено
+    bool processHandshake();
+    void handleFrame(const FrameHeader& header, uint8_t* payload, size_t length);
+    void handleDataFrame(const FrameHeader& header, const uint8_t* payload, size_t length);
+    // Проверяет очерёдность фреймов сообщения, возвращает тип всего сообщения
+    Opcode beginDataFrame(const FrameHeader& header);
+    // Фрейм длиннее порога: заголовок уже снят, payload пойдёт по частям
+    void beginFrameStream(const FrameHeader& header);
+    // Очередной кусок payload такого фрейма; false — ждём данных
+    bool streamPayload();
+    // Сообщение отныне идёт в приёмник, собранное до сих пор — туда же
+    bool openSink(Opcode opcode, uint64_t size);
+    // Кусок сообщения в приёмник (сжатое — распаковывается);
+    // без приёмника данные пропускаются до конца сообщения
+    void streamData(Opcode opcode, const uint8_t* data, size_t size, bool final);
+    bool writeSink(const uint8_t* data, size_t size);
+    void finishStream();
+    // Обрывает приём в приёмник и закрывает соединение
+    void failStream(uint16_t code, const char* reason);
+    // Отдаёт собранное в fragmented_buffer_ сообщение и очищает буфер
+    void deliver(const MessageCallback& on_message, Opcode opcode);
+    // Сообщение — в коллбэк, без него — корутине
+    void emit(const MessageCallback& on_message, const MessageView& message);
+    // Ждущей read() корутине или во входящую очередь
+    void offerMessage(const MessageView& message);
+    // Соединение закрывается: будим ждущие read() и write()
+    void wakeSession();
 
     SOCKET socket_;
     IOCPCore& iocp_;
     std::atomic<bool> is_closed_;
-    std::mutex socket_mutex_;
+    mutable std::mutex socket_mutex_;
     AsyncOperation read_operation_;
-    std::vector<uint8_t> fragmented_buffer_;
+
+    // Очередь исходящих фреймов: в ядре не больше одной отправки,
+    // всё накопленное за время её полёта уходит следующей одним вызовом
+    AsyncOperation write_operation_;
+    std::deque<OutboundFrame> write_queue_;
+    std::vector<OutboundFrame> write_batch_;         // Фреймы отправки в полёте
+    std::vector<WSABUF> write_buffers_;
+    bool write_in_flight_ = false;
+    size_t queued_bytes_ = 0;                        // Очередь вместе с отправкой в полёте
+    size_t batch_bytes_ = 0;
+    bool backpressured_ = false;                     // Между верхней и нижней отметками
+    OutboundLimits outbound_limits_;
+    OutboundStats* outbound_stats_ = nullptr;
+    bool close_after_flush_ = false;                 // Закрыть сокет, когда очередь уйдёт
+
+    // Один таймер следит и за простоем, и за пингами; второй — срок закрытия
+    ConnectionTimeouts timeouts_;
+    IOCPCore::Timer activity_timer_;
+    IOCPCore::Timer close_timer_;
+    std::atomic<int64_t> last_activity_ms_{0};
+
+    // Пинг сервера: в payload — номер пинга. Следующий уходит только
+    // после ответа на прошлый, так что в очереди их не больше одного
+    uint64_t ping_sequence_ = 0;
+    std::atomic<uint64_t> ping_pending_{0};   // Номер пинга без ответа, 0 — нет
+    std::atomic<int64_t> ping_sent_us_{0};
+    std::atomic<int64_t> last_ping_ms_{0};
+    std::atomic<uint32_t> rtt_last_us_{0};
+    std::atomic<uint32_t> rtt_smoothed_us_{0};
+    std::atomic<uint32_t> rtt_variance_us_{0};
+    std::atomic<uint32_t> rtt_samples_{0};
+    KeepaliveStats* keepalive_stats_ = nullptr;
+    // Сборка фрагментированного сообщения; Continuation — сборки нет
+    std::string fragmented_buffer_;
     Opcode current_opcode_ = Opcode::Continuation;
+    bool compressed_message_ = false;  // Текущее входящее сообщение сжато (RSV1)
+    Utf8Validator utf8_;               // Состояние проверки текущего текстового сообщения
+
+    // permessage-deflate; сжатие и постановка в очередь идут под одним
+    // мьютексом, чтобы фреймы уходили в порядке сжатия
+    std::unique_ptr<PerMessageDeflate> deflate_;
+    std::mutex deflate_mutex_;
+    std::string inflate_buffer_;  // Распакованный фрагмент для FragmentCallback или приёмника
+
+    // Потоковый приём крупных сообщений; без фабрики выключен
+    StreamingConfig streaming_;
+    SinkFactory sink_factory_;
+    std::unique_ptr<MessageSink> sink_;
+    bool streaming_message_ = false;  // Текущее сообщение идёт в приёмник (или пропускается)
+    uint64_t streamed_bytes_ = 0;
+    FrameHeader stream_header_{};     // Фрейм, принимаемый по частям
+    Opcode stream_opcode_ = Opcode::Continuation;
+    uint64_t stream_offset_ = 0;      // Сколько его payload уже отдано
+    uint64_t stream_remaining_ = 0;   // 0 — такого фрейма нет
     
+    // Корутины: входящая очередь, пока читатель занят, и ждущие.
+    // writer_ — под socket_mutex_: его будит разбор очереди отправки
+    struct InboxMessage {
+        Opcode opcode;
+        PooledBuffer data;
+    };
+    std::mutex inbox_mutex_;
+    std::deque<InboxMessage> inbox_;
+    size_t inbox_bytes_ = 0;
+    PooledBuffer inbox_current_;      // Сообщение, отданное последним read()
+    ReadAwaiter* reader_ = nullptr;
+    WriteAwaiter* writer_ = nullptr;
+
     std::mutex callbacks_mutex_;
     MessageCallback on_message_;
+    FragmentCallback on_fragment_;
     CloseCallback on_close_;
 
-    std::vector<uint8_t> read_buffer_;  // Заменяет фиксированный буфер
-    size_t expected_payload_size_ = 0;
+    // Рукопожатие разбирается в приёмном буфере, до open_ фреймов нет
+    HandshakeParser handshake_;
+    std::atomic<bool> open_{false};
+    DeflateConfig deflate_config_;
+    DeflateMemory* deflate_memory_ = nullptr;
+
+    // recv пишет сюда напрямую, фреймы разбираются на месте
+    ReceiveBuffer receive_buffer_;
+    bool zero_byte_reads_ = false;
+    bool awaiting_data_ = false;      // В ядре чтение нулевой длины
+    bool data_ready_ = false;         // Оно завершилось: читаем в буфер
+    size_t expected_frame_size_ = 0;  // Полный размер недополученного фрейма
 };
 
 } // namespace websocket
\ No newline at end of file